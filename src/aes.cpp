@@ -36,13 +36,7 @@ static std::uint8_t gmul(std::uint8_t a, std::uint8_t b) {
     return p;
 }
 
-static void build_tables() {
-    static bool built_tables = false;
-    if (built_tables)
-        return;
-
-    built_tables = true;
-
+static bool compute_tables() {
     // Build the S-box
     std::uint8_t p = 1, q = 1;
 
@@ -78,6 +72,15 @@ static void build_tables() {
         for (int j = i; j != 1; j--)
             rcon[i] = gmul(rcon[i], 2);
     }
+
+    return true;
+}
+
+// The tables are filled once; a function-local static makes that safe when
+// several threads construct their first AES object at the same time
+static void build_tables() {
+    static const bool built = compute_tables();
+    (void)built;
 }
 
 AES::AES(const std::uint8_t *key, const std::uint8_t *iv) {
@@ -87,15 +90,16 @@ AES::AES(const std::uint8_t *key, const std::uint8_t *iv) {
     std::copy_n(iv, block_len, this->iv);
 }
 
-void AES::cbc_encrypt(void *data, std::size_t size, void *result) {
+void AES::cbc_encrypt(const void *data, std::size_t size, void *result) {
     assert(size % block_len == 0);
-    auto in  = static_cast<std::uint8_t*>(data);
+    auto in  = static_cast<const std::uint8_t*>(data);
     auto out = static_cast<std::uint8_t*>(result);
     std::uint8_t *iv = this->iv;
 
     for (std::size_t i = 0; i < size; i += block_len) {
-        xor_with_iv(in, iv);
-        encrypt_block(in, out);
+        std::copy_n(in, block_len, out);
+        xor_with_iv(out, iv);
+        encrypt_block(out, out);
 
         iv = out;
         in  += block_len;
@@ -105,11 +109,11 @@ void AES::cbc_encrypt(void *data, std::size_t size, void *result) {
     std::copy_n(iv, block_len, this->iv);
 }
 
-void AES::cbc_decrypt(void *data, std::size_t size, void *result) {
+void AES::cbc_decrypt(const void *data, std::size_t size, void *result) {
     assert(size % block_len == 0);
-    auto in  = static_cast<std::uint8_t*>(data);
+    auto in  = static_cast<const std::uint8_t*>(data);
     auto out = static_cast<std::uint8_t*>(result);
-    std::uint8_t *iv = this->iv;
+    const std::uint8_t *iv = this->iv;
 
     for (std::size_t i = 0; i < size; i += block_len) {
         decrypt_block(in, out);
@@ -9,8 +9,9 @@ public:
     AES(const std::uint8_t *key, const std::uint8_t *iv);
 
     // All data must be padded to be a multiple of 16-bytes. Try #PKCS7
-    void cbc_encrypt(void *data, std::size_t size, void *result);
-    void cbc_decrypt(void *data, std::size_t size, void *result);
+    // The input is left untouched, so it may be a read-only mapping
+    void cbc_encrypt(const void *data, std::size_t size, void *result);
+    void cbc_decrypt(const void *data, std::size_t size, void *result);
 
 private:
     using State = std::uint8_t[16];
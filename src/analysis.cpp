@@ -0,0 +1,284 @@
+#include "analysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "image.hpp"
+#include "thread_pool.hpp"
+
+// Samples per block, and blocks handed to the threads at once
+static const std::size_t block_samples = 64 * 1024;
+static const std::size_t band_blocks   = 64;
+
+// Everything the estimators need, summed over a block and channel. The counts
+// add up, so blocks and channels are merged by adding them
+struct Counts {
+    std::uint64_t histogram[256];
+    // Regular and singular groups for the masks M and -M, then the same with all LSBs flipped
+    std::uint64_t rs[8];
+    // Sample pairs: odd difference with the even sample the larger one or the odd sample
+    // the smaller one (P), other odd differences (Q), differing only in the LSB (W), equal (Z)
+    std::uint64_t spa[4];
+
+    void add(const Counts &other) {
+        for (int i = 0; i < 256; i++)
+            histogram[i] += other.histogram[i];
+        for (int i = 0; i < 8; i++)
+            rs[i] += other.rs[i];
+        for (int i = 0; i < 4; i++)
+            spa[i] += other.spa[i];
+    }
+};
+
+static int smoothness(int a, int b, int c, int d) {
+    return std::abs(b - a) + std::abs(c - b) + std::abs(d - c);
+}
+
+// F1 swaps 2k and 2k + 1, F-1 swaps 2k - 1 and 2k
+static int flip(int x) { return x ^ 1; }
+static int shift(int x) { return x & 1 ? x + 1 : x - 1; }
+
+// Groups of four neighbours with the mask M = [0 1 1 0]
+static void rs_group(int a, int b, int c, int d, std::uint64_t *rs) {
+    int f  = smoothness(a, b, c, d);
+    int fm = smoothness(a, flip(b), flip(c), d);
+    int fn = smoothness(a, shift(b), shift(c), d);
+
+    rs[0] += fm > f;
+    rs[1] += fm < f;
+    rs[2] += fn > f;
+    rs[3] += fn < f;
+}
+
+// Four partial histograms per channel, so that runs of equal values do not wait on
+// each other's increments. Added to the counts at the end of a block
+struct Partial {
+    std::uint32_t histogram[4][256];
+};
+
+template <typename T> static void count_row(const T *row, std::size_t width, std::size_t channels, Counts *counts, Partial *partial) {
+    for (std::size_t c = 0; c < channels; c++) {
+        const T *p = row + c;
+        Counts &k = counts[c];
+        auto &h = partial[c].histogram;
+
+        std::size_t i = 0;
+        for (; i + 4 <= width; i += 4) {
+            h[0][p[(i + 0) * channels] & 255]++;
+            h[1][p[(i + 1) * channels] & 255]++;
+            h[2][p[(i + 2) * channels] & 255]++;
+            h[3][p[(i + 3) * channels] & 255]++;
+        }
+        for (; i < width; i++)
+            h[0][p[i * channels] & 255]++;
+
+        for (i = 0; i + 1 < width; i++) {
+            int u = p[i * channels], v = p[(i + 1) * channels];
+
+            if (u == v) {
+                k.spa[3]++;
+            } else if ((u ^ v) & 1) {
+                bool larger_even = (v & 1) ? u > v : u < v;
+                k.spa[larger_even ? 0 : 1]++;
+                k.spa[2] += (u >> 1) == (v >> 1);
+            }
+        }
+
+        for (i = 0; i + 4 <= width; i += 4) {
+            int a = p[i * channels], b = p[(i + 1) * channels];
+            int c = p[(i + 2) * channels], d = p[(i + 3) * channels];
+
+            rs_group(a, b, c, d, k.rs);
+            rs_group(a ^ 1, b ^ 1, c ^ 1, d ^ 1, k.rs + 4);
+        }
+    }
+}
+
+static double log_gamma_half(double a) {
+    // a is a multiple of 1/2, built up from Gamma(1) = 1 or Gamma(1/2) = sqrt(pi)
+    double x = a - std::floor(a) > 0 ? 0.5 : 1;
+    double result = x == 0.5 ? 0.5 * std::log(std::acos(-1.0)) : 0;
+
+    for (; x < a; x++)
+        result += std::log(x);
+
+    return result;
+}
+
+// Regularized upper incomplete gamma function Q(a, x) for half-integer a
+static double gamma_q(double a, double x) {
+    if (x <= 0)
+        return 1;
+
+    double front = std::exp(-x + a * std::log(x) - log_gamma_half(a));
+
+    if (x < a + 1) {
+        double term = 1 / a, sum = term;
+        for (int n = 1; n < 1000 && term > sum * 1e-14; n++) {
+            term *= x / (a + n);
+            sum  += term;
+        }
+        return std::max(0.0, 1 - front * sum);
+    }
+
+    // Continued fraction, modified Lentz
+    const double tiny = 1e-300;
+    double b = x + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+
+    for (int i = 1; i < 1000; i++) {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        c = b + an / c;
+        if (std::fabs(d) < tiny)
+            d = tiny;
+        if (std::fabs(c) < tiny)
+            c = tiny;
+        d = 1 / d;
+
+        double delta = c * d;
+        h *= delta;
+        if (std::fabs(delta - 1) < 1e-14)
+            break;
+    }
+
+    return front * h;
+}
+
+// Westfeld and Pfitzmann: LSB embedding evens out the counts of 2k and 2k + 1
+static double chi_square(const std::uint64_t *histogram) {
+    double chi = 0;
+    int categories = 0;
+
+    for (int k = 0; k < 128; k++) {
+        double expected = (histogram[2 * k] + histogram[2 * k + 1]) / 2.0;
+        if (expected < 5)
+            continue;
+
+        double diff = histogram[2 * k] - expected;
+        chi += diff * diff / expected;
+        categories++;
+    }
+
+    return categories > 1 ? gamma_q((categories - 1) / 2.0, chi / 2) : 0;
+}
+
+// Fridrich, Goljan and Du. Solves 2(d1 + d0)z^2 + (d-0 - d-1 - d1 - 3d0)z + d0 - d-0 = 0
+// for the root of smallest magnitude, the rate is z / (z - 1/2)
+static double rs_rate(const std::uint64_t *rs) {
+    double d0  = double(rs[0]) - double(rs[1]), dn0 = double(rs[2]) - double(rs[3]);
+    double d1  = double(rs[4]) - double(rs[5]), dn1 = double(rs[6]) - double(rs[7]);
+
+    double a = 2 * (d1 + d0);
+    double b = dn0 - dn1 - d1 - 3 * d0;
+    double c = d0 - dn0;
+    double z;
+
+    if (std::fabs(a) < 1e-9) {
+        if (std::fabs(b) < 1e-9)
+            return 0;
+        z = -c / b;
+    } else {
+        double root = std::sqrt(std::max(0.0, b * b - 4 * a * c));
+        double z1 = (-b + root) / (2 * a), z2 = (-b - root) / (2 * a);
+        z = std::fabs(z1) < std::fabs(z2) ? z1 : z2;
+    }
+
+    return z / (z - 0.5);
+}
+
+// Dumitrescu, Wu and Wang. Flipping LSBs with probability q mixes the pair classes
+// of every trace set; with r = 1 - 2q and P = Q on the cover this gives
+// (N/2)r^2 - (P - Q + W)r + W - N/2 = 0, where N = W + Z. The rate is 1 - r
+static double spa_rate(const std::uint64_t *spa) {
+    double p = double(spa[0]), q = double(spa[1]), w = double(spa[2]), n = w + double(spa[3]);
+    if (n <= 0)
+        return 0;
+
+    double d = p - q + w;
+    double r = (d + std::sqrt(std::max(0.0, d * d - 2 * n * (w - n / 2)))) / n;
+
+    return 1 - r;
+}
+
+static double combined_rate(double rs, double spa) {
+    return std::clamp((rs + spa) / 2, 0.0, 1.0);
+}
+
+bool analyze(Image &image, Analysis &result) {
+    std::size_t channels = image.c(), width = image.w();
+    std::size_t row_samples = width * channels;
+    std::size_t row_bytes   = row_samples * (image.depth() / 8);
+    std::size_t block_rows  = std::max<std::size_t>(1, block_samples / std::max<std::size_t>(row_samples, 1));
+
+    std::vector<Counts> counts; // Per block and channel
+    result.blocks.clear();
+
+    bool read = image.read_rows(block_rows * band_blocks, [&](std::size_t y, std::size_t rows, const std::uint8_t *data) {
+        std::size_t count = (rows + block_rows - 1) / block_rows;
+        std::size_t first = result.blocks.size();
+
+        counts.resize((first + count) * channels, Counts{});
+        for (std::size_t i = 0; i < count; i++)
+            result.blocks.push_back({ y + i * block_rows, std::min(block_rows, rows - i * block_rows), 0, 0, 0, 0 });
+
+        parallel_for(count, [&](std::size_t i) {
+            Counts *block = counts.data() + (first + i) * channels;
+            std::size_t end = std::min(rows, (i + 1) * block_rows);
+            std::vector<Partial> partial(channels);
+
+            if (image.depth() == 8) {
+                for (std::size_t r = i * block_rows; r < end; r++)
+                    count_row(data + r * row_bytes, width, channels, block, partial.data());
+            } else {
+                std::vector<std::uint16_t> row(row_samples);
+                for (std::size_t r = i * block_rows; r < end; r++) {
+                    std::memcpy(row.data(), data + r * row_bytes, row_bytes);
+                    count_row(row.data(), width, channels, block, partial.data());
+                }
+            }
+
+            for (std::size_t c = 0; c < channels; c++)
+                for (int v = 0; v < 256; v++)
+                    block[c].histogram[v] += partial[c].histogram[0][v] + partial[c].histogram[1][v] +
+                                             partial[c].histogram[2][v] + partial[c].histogram[3][v];
+        });
+    });
+
+    if (!read)
+        return false;
+
+    std::vector<Counts> channel(channels, Counts{});
+    Counts total{};
+
+    result.peak = 0;
+    for (std::size_t b = 0; b < result.blocks.size(); b++) {
+        Counts block{};
+        for (std::size_t c = 0; c < channels; c++) {
+            block.add(counts[b * channels + c]);
+            channel[c].add(counts[b * channels + c]);
+        }
+        total.add(block);
+
+        auto &out = result.blocks[b];
+        out.chi_square = chi_square(block.histogram);
+        out.rs         = rs_rate(block.rs);
+        out.spa        = spa_rate(block.spa);
+        out.rate       = combined_rate(out.rs, out.spa);
+
+        result.peak = std::max(result.peak, out.rate);
+    }
+
+    result.channels.clear();
+    for (auto &k : channel)
+        result.channels.push_back({ chi_square(k.histogram), rs_rate(k.rs), spa_rate(k.spa) });
+
+    result.chi_square = chi_square(total.histogram);
+    result.rs         = rs_rate(total.rs);
+    result.spa        = spa_rate(total.spa);
+    result.rate       = combined_rate(result.rs, result.spa);
+
+    return true;
+}
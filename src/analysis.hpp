@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class Image;
+
+// LSB steganalysis of an image: the chi-square attack, RS analysis and sample pair
+// analysis, per channel and per block of rows. Rates are the estimated fraction of
+// samples whose lowest bit was replaced, 0 for a clean cover and 1 when every sample
+// carries embedded data. For 16-bit samples the chi-square attack pools the values
+// by their low byte
+struct ChannelAnalysis {
+    double chi_square; // p-value of the chi-square attack, close to 1 when pairs of values are equalised
+    double rs;         // Rate estimated by RS analysis
+    double spa;        // Rate estimated by sample pair analysis
+};
+
+// Blocks are bands of whole rows, which is also the order in which data is embedded
+struct BlockAnalysis {
+    std::size_t y, rows;
+    double chi_square, rs, spa; // All channels together
+    double rate;
+};
+
+struct Analysis {
+    std::vector<ChannelAnalysis> channels;
+    std::vector<BlockAnalysis> blocks;
+
+    double chi_square, rs, spa; // All channels together
+    double rate;                // Mean of the RS and SPA rates, clamped to [0, 1]
+    double peak;                // Highest block rate, shows payloads filling only part of the image
+
+    // Rates below the threshold are within the error of the estimators on clean covers
+    bool detected(double threshold = 0.05) const { return rate > threshold || peak > 2 * threshold; }
+};
+
+// Blocks are analysed in parallel, inside a pool worker on the workers of that pool.
+// False when a streamed image can not be read back
+bool analyze(Image &image, Analysis &result);
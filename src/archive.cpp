@@ -0,0 +1,185 @@
+#include "archive.hpp"
+
+#include <algorithm>
+#include <utility>
+
+// Per entry: name length (2), name, flags (1), offset, stored size and size (8 each), CRC32 (4),
+// then the segment (4) when flag_segment is set
+static const std::size_t entry_fixed = 2 + 1 + 8 + 8 + 8 + 4;
+// Size prefix (8) and entry count (4)
+static const std::size_t head_size = 8 + 4;
+// Per segment: offset and size (8 each), IV (16), after the segment count (4)
+static const std::size_t segment_size = 8 + 8 + 16;
+
+static const std::uint8_t flag_deflate = 0x01;
+static const std::uint8_t flag_segment = 0x02;
+
+static void put(std::vector<std::uint8_t> &out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        out.push_back(std::uint8_t(value >> (i * 8)));
+}
+
+static std::uint64_t get(const std::uint8_t *data, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= std::uint64_t(data[i]) << (i * 8);
+    return value;
+}
+
+bool write_directory(std::vector<ArchiveEntry> &entries, const std::vector<ArchiveSegment> &segments,
+                     std::vector<std::uint8_t> &out) {
+    if (entries.size() > UINT32_MAX || segments.size() >= UINT32_MAX)
+        return false;
+
+    std::uint64_t end = head_size;
+    for (auto &entry : entries) {
+        if (entry.name.empty() || entry.name.size() > UINT16_MAX || entry.segment > segments.size())
+            return false;
+        end += entry_fixed + entry.name.size() + (entry.segment ? 4 : 0);
+    }
+    if (!segments.empty())
+        end += 4 + segments.size() * segment_size;
+
+    out.clear();
+    out.reserve(end);
+    put(out, end - 8, 8);
+    put(out, entries.size(), 4);
+
+    std::uint64_t offset = end;
+    for (auto &entry : entries) {
+        if (!entry.segment) {
+            entry.offset = offset;
+            offset += entry.stored_size;
+        }
+
+        put(out, entry.name.size(), 2);
+        out.insert(out.end(), entry.name.begin(), entry.name.end());
+        put(out, (entry.compressed ? flag_deflate : 0) | (entry.segment ? flag_segment : 0), 1);
+        put(out, entry.offset, 8);
+        put(out, entry.stored_size, 8);
+        put(out, entry.size, 8);
+        put(out, entry.crc, 4);
+        if (entry.segment)
+            put(out, entry.segment, 4);
+    }
+
+    if (!segments.empty()) {
+        put(out, segments.size(), 4);
+        for (auto &segment : segments) {
+            put(out, segment.offset, 8);
+            put(out, segment.size, 8);
+            out.insert(out.end(), segment.iv, segment.iv + 16);
+        }
+    }
+
+    return true;
+}
+
+std::uint64_t directory_end(const std::uint8_t *prefix) {
+    std::uint64_t size = get(prefix, 8);
+    return size > UINT64_MAX - 8 ? UINT64_MAX : size + 8;
+}
+
+bool read_directory(const std::uint8_t *data, std::size_t size, std::vector<ArchiveEntry> &entries,
+                    std::vector<ArchiveSegment> &segments) {
+    entries.clear();
+    segments.clear();
+    if (size < head_size || directory_end(data) != size)
+        return false;
+
+    std::uint64_t count = get(data + 8, 4);
+    if (count > (size - head_size) / entry_fixed)
+        return false;
+
+    std::size_t at = head_size;
+    std::uint64_t next = size;
+    std::uint32_t highest = 0;
+
+    for (std::uint64_t i = 0; i < count; i++) {
+        if (size - at < entry_fixed)
+            return false;
+
+        std::size_t length = get(data + at, 2);
+        if (size - at - entry_fixed < length)
+            return false;
+        at += 2;
+
+        ArchiveEntry entry;
+        entry.name.assign(reinterpret_cast<const char *>(data + at), length);
+        at += length;
+
+        std::uint8_t flags = data[at];
+        entry.compressed   = flags & flag_deflate;
+        entry.offset       = get(data + at + 1, 8);
+        entry.stored_size  = get(data + at + 9, 8);
+        entry.size         = get(data + at + 17, 8);
+        entry.crc          = std::uint32_t(get(data + at + 25, 4));
+        at += entry_fixed - 2;
+
+        if (flags & flag_segment) {
+            if (size - at < 4)
+                return false;
+            entry.segment = std::uint32_t(get(data + at, 4));
+            at += 4;
+        }
+
+        // Deflate can not shrink data by more than ~1032:1, and stored entries keep their size
+        if ((flags & ~(flag_deflate | flag_segment)) || ((flags & flag_segment) && !entry.segment) ||
+            entry.stored_size > UINT64_MAX - entry.offset ||
+            (entry.compressed ? entry.size / 1032 > entry.stored_size : entry.size != entry.stored_size))
+            return false;
+
+        // Entries of this payload are packed in order after the directory
+        if (!entry.segment) {
+            if (entry.offset != next)
+                return false;
+            next += entry.stored_size;
+        }
+
+        highest = std::max(highest, entry.segment);
+        entries.push_back(std::move(entry));
+    }
+
+    if (at < size) {
+        if (size - at < 4)
+            return false;
+
+        std::uint64_t table = get(data + at, 4);
+        at += 4;
+        if (table > (size - at) / segment_size)
+            return false;
+
+        for (std::uint64_t i = 0; i < table; i++) {
+            ArchiveSegment segment;
+            segment.offset = get(data + at, 8);
+            segment.size   = get(data + at + 8, 8);
+            std::copy_n(data + at + 16, 16, segment.iv);
+            at += segment_size;
+
+            segments.push_back(segment);
+        }
+    }
+
+    return at == size && highest <= segments.size();
+}
+
+bool safe_entry_name(const std::string &name) {
+    if (name.empty() || name[0] == '/' || name.find('\\') != std::string::npos ||
+        name.find(':') != std::string::npos || name.find('\0') != std::string::npos)
+        return false;
+
+    std::size_t start = 0;
+    while (start <= name.size()) {
+        std::size_t end = name.find('/', start);
+        if (end == std::string::npos)
+            end = name.size();
+
+        std::string part = name.substr(start, end - start);
+        if (part.empty() || part == "." || part == "..")
+            return false;
+
+        start = end + 1;
+    }
+
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Directory of a multi-file payload. The payload starts with the size of the directory
+// (8 bytes, little endian) and the directory itself, followed by the stored data of
+// every entry in order. Each entry is deflated on its own, so any entry can be read
+// from its offset without touching the others.
+//
+// An update embeds a new payload with the new entries and a new directory elsewhere in
+// the image. Entries that stay in earlier payloads refer to them through the segment
+// table at the end of the directory
+struct ArchiveEntry {
+    std::string name;               // Relative path with '/' separators, up to 65535 bytes
+    std::uint64_t offset      = 0;  // Start of the stored data in the payload
+    std::uint64_t stored_size = 0;  // Size in the payload, after deflate
+    std::uint64_t size        = 0;  // Size of the file
+    std::uint32_t crc         = 0;  // CRC32 of the file
+    bool compressed = false;        // Stored as a raw deflate stream
+    std::uint32_t segment     = 0;  // 0 for the payload holding the directory, else 1 + index into the segments
+};
+
+// An earlier payload still holding entries, embedded at the same level: first sample,
+// encrypted size with the chunk tags, and the IV its chunks were derived from
+struct ArchiveSegment {
+    std::uint64_t offset = 0;
+    std::uint64_t size   = 0;
+    std::uint8_t iv[16]  = {};
+};
+
+// Size prefix and directory for the entries. The offsets of the entries in segment 0
+// are assigned here, with their data packed right after the directory
+bool write_directory(std::vector<ArchiveEntry> &entries, const std::vector<ArchiveSegment> &segments,
+                     std::vector<std::uint8_t> &out);
+
+// End of the directory in the payload, from its first 8 bytes
+std::uint64_t directory_end(const std::uint8_t *prefix);
+
+// Parses a directory written by write_directory, including the size prefix. False when
+// it is truncated, an entry of segment 0 overlaps the directory or the entry before it,
+// or an entry refers to a segment that is not in the table
+bool read_directory(const std::uint8_t *data, std::size_t size, std::vector<ArchiveEntry> &entries,
+                    std::vector<ArchiveSegment> &segments);
+
+// True for relative names without empty, "." or ".." components, which can not
+// leave the directory they are extracted to
+bool safe_entry_name(const std::string &name);
@@ -0,0 +1,261 @@
+#include "carrier.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+static const std::uint8_t bgr_order[4] = { 2, 1, 0, 3 };
+
+static std::uint32_t get16(const std::uint8_t *p, bool be) {
+    return be ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+static std::uint32_t get32(const std::uint8_t *p, bool be) {
+    return be ? (std::uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]
+              : p[0] | (p[1] << 8) | (p[2] << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+// The pixel array has to lie completely inside the file
+static bool fits(const CarrierLayout &layout, std::size_t size) {
+    if (!layout.width || !layout.height)
+        return false;
+
+    std::size_t row  = std::size_t(layout.width) * layout.channels * (layout.depth / 8);
+    std::size_t step = layout.stride < 0 ? -layout.stride : layout.stride;
+    std::size_t rows = std::size_t(layout.height - 1) * step;
+
+    if (step < row)
+        return false;
+
+    std::size_t first = layout.stride < 0 ? layout.offset - rows : layout.offset;
+    if (layout.stride < 0 && layout.offset < rows)
+        return false;
+
+    return first + rows + row <= size && first + rows + row >= first;
+}
+
+static bool parse_bmp(const std::uint8_t *data, std::size_t size, CarrierLayout &layout) {
+    if (size < 54)
+        return false;
+
+    std::uint32_t pixels = get32(data + 10, false);
+    std::int32_t  width  = get32(data + 18, false);
+    std::int32_t  height = get32(data + 22, false);
+    std::uint32_t bpp    = get16(data + 28, false);
+    std::uint32_t compression = get32(data + 30, false);
+
+    // Only plain 24 and 32 bits per pixel, palettes store indices instead of colours
+    if (compression != 0 || (bpp != 24 && bpp != 32) || width <= 0 || height == 0)
+        return false;
+
+    std::size_t row = (std::size_t(width) * bpp + 31) / 32 * 4;
+    std::size_t rows = height < 0 ? -std::int64_t(height) : height;
+
+    layout.format   = CarrierLayout::Format::BMP;
+    layout.width    = width;
+    layout.height   = rows;
+    layout.channels = bpp / 8;
+    layout.depth    = 8;
+    layout.swizzle  = bgr_order;
+    layout.big_endian = false;
+
+    // Positive heights are stored bottom-up
+    if (height > 0) {
+        layout.offset = pixels + (rows - 1) * row;
+        layout.stride = -std::ptrdiff_t(row);
+    } else {
+        layout.offset = pixels;
+        layout.stride = row;
+    }
+
+    return fits(layout, size);
+}
+
+static bool parse_pnm(const std::uint8_t *data, std::size_t size, CarrierLayout &layout) {
+    std::size_t i = 2;
+    std::uint32_t fields[3];
+
+    for (auto &field : fields) {
+        // Skip whitespace and comments
+        while (i < size && (std::isspace(data[i]) || data[i] == '#')) {
+            if (data[i] == '#')
+                while (i < size && data[i] != '\n')
+                    i++;
+            else
+                i++;
+        }
+
+        if (i >= size || !std::isdigit(data[i]))
+            return false;
+
+        field = 0;
+        while (i < size && std::isdigit(data[i]) && field < 0x1000000)
+            field = field * 10 + (data[i++] - '0');
+    }
+
+    // A single whitespace character separates the header from the pixels
+    if (i >= size || !std::isspace(data[i]) || !fields[2] || fields[2] > 0xffff)
+        return false;
+
+    layout.format   = CarrierLayout::Format::PNM;
+    layout.width    = fields[0];
+    layout.height   = fields[1];
+    layout.channels = data[1] == '6' ? 3 : 1;
+    layout.depth    = fields[2] > 0xff ? 16 : 8;
+    layout.offset   = i + 1;
+    layout.stride   = std::size_t(layout.width) * layout.channels * (layout.depth / 8);
+    layout.swizzle  = nullptr;
+    layout.big_endian = true;
+
+    return fits(layout, size);
+}
+
+static bool parse_tga(const std::uint8_t *data, std::size_t size, CarrierLayout &layout) {
+    if (size < 18)
+        return false;
+
+    std::uint32_t type = data[2], bpp = data[16], descriptor = data[17];
+
+    // Uncompressed true-colour or greyscale without a colour map, stored left-to-right
+    if (data[1] != 0 || (descriptor & 0x10))
+        return false;
+    if (!((type == 2 && (bpp == 24 || bpp == 32)) || (type == 3 && bpp == 8)))
+        return false;
+
+    std::size_t row = std::size_t(get16(data + 12, false)) * (bpp / 8);
+
+    layout.format   = CarrierLayout::Format::TGA;
+    layout.width    = get16(data + 12, false);
+    layout.height   = get16(data + 14, false);
+    layout.channels = bpp / 8;
+    layout.depth    = 8;
+    layout.swizzle  = type == 2 ? bgr_order : nullptr;
+    layout.big_endian = false;
+
+    std::size_t pixels = 18 + data[0];
+
+    // Bit 5 of the descriptor marks a top-left origin
+    if (descriptor & 0x20 || !layout.height) {
+        layout.offset = pixels;
+        layout.stride = row;
+    } else {
+        layout.offset = pixels + (layout.height - 1) * row;
+        layout.stride = -std::ptrdiff_t(row);
+    }
+
+    return fits(layout, size);
+}
+
+static bool parse_tiff(const std::uint8_t *data, std::size_t size, CarrierLayout &layout) {
+    if (size < 8)
+        return false;
+
+    bool be = data[0] == 'M';
+    std::size_t ifd = get32(data + 4, be);
+    if (ifd + 2 > size)
+        return false;
+
+    std::size_t count = get16(data + ifd, be);
+    if (ifd + 2 + count * 12 > size)
+        return false;
+
+    // Reads value i of an IFD entry, which is stored inline when it fits in 4 bytes
+    auto value = [&](const std::uint8_t *entry, std::size_t i, std::uint32_t &result) {
+        std::uint32_t type = get16(entry + 2, be), n = get32(entry + 4, be);
+        std::size_t width = type == 3 ? 2 : type == 4 ? 4 : 0;
+        if (!width || i >= n)
+            return false;
+
+        std::size_t at = n * width <= 4 ? (entry + 8 - data) : get32(entry + 8, be);
+        at += i * width;
+        if (at + width > size)
+            return false;
+
+        result = width == 2 ? get16(data + at, be) : get32(data + at, be);
+        return true;
+    };
+
+    std::uint32_t width = 0, height = 0, bits = 8, samples = 1, compression = 1, planar = 1;
+    std::uint32_t rows_per_strip = 0xffffffff;
+    const std::uint8_t *offsets = nullptr, *counts = nullptr;
+
+    for (std::size_t i = 0; i < count; i++) {
+        auto entry = data + ifd + 2 + i * 12;
+        std::uint32_t tag = get16(entry, be);
+        bool ok = true;
+
+        switch (tag) {
+        case 256: ok = value(entry, 0, width); break;
+        case 257: ok = value(entry, 0, height); break;
+        case 258: ok = value(entry, 0, bits); break;
+        case 259: ok = value(entry, 0, compression); break;
+        case 273: offsets = entry; break;
+        case 277: ok = value(entry, 0, samples); break;
+        case 278: ok = value(entry, 0, rows_per_strip); break;
+        case 279: counts = entry; break;
+        case 284: ok = value(entry, 0, planar); break;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    if (compression != 1 || planar != 1 || (bits != 8 && bits != 16) || !samples || samples > 4)
+        return false;
+    if (!offsets || !counts || !height || !rows_per_strip)
+        return false;
+
+    // Strips must follow each other so that the pixel array is contiguous
+    std::size_t strips = (height + std::min(rows_per_strip, height) - 1) / std::min(rows_per_strip, height);
+    std::uint32_t first, next, length;
+
+    if (!value(offsets, 0, first))
+        return false;
+
+    next = first;
+    for (std::size_t i = 0; i < strips; i++) {
+        std::uint32_t offset;
+        if (!value(offsets, i, offset) || !value(counts, i, length) || offset != next)
+            return false;
+        next = offset + length;
+    }
+
+    layout.format   = CarrierLayout::Format::TIFF;
+    layout.width    = width;
+    layout.height   = height;
+    layout.channels = samples;
+    layout.depth    = bits;
+    layout.offset   = first;
+    layout.stride   = std::size_t(width) * samples * (bits / 8);
+    layout.swizzle  = nullptr;
+    layout.big_endian = be;
+
+    return next - first >= std::size_t(layout.stride) * height && fits(layout, size);
+}
+
+bool parse_carrier(const std::uint8_t *data, std::size_t size, CarrierLayout &layout) {
+    if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+        return parse_bmp(data, size, layout);
+
+    if (size >= 3 && data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+        return parse_pnm(data, size, layout);
+
+    if (size >= 4 && ((data[0] == 'I' && data[1] == 'I' && data[2] == 42 && data[3] == 0) ||
+                      (data[0] == 'M' && data[1] == 'M' && data[2] == 0 && data[3] == 42)))
+        return parse_tiff(data, size, layout);
+
+    // TGA has no signature, so rely on the extension check done by the caller
+    return parse_tga(data, size, layout);
+}
+
+bool carrier_extension(const std::string &path) {
+    static const char *extensions[] = { ".bmp", ".ppm", ".pgm", ".pnm", ".tga", ".tif", ".tiff" };
+
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return std::tolower(ch); });
+
+    return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+}
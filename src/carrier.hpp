@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Location of the pixel array inside an uncompressed image file
+struct CarrierLayout {
+    enum class Format {
+        BMP,
+        PNM,
+        TGA,
+        TIFF,
+    };
+
+    Format format;
+    unsigned int width, height;
+    unsigned int channels, depth;
+
+    std::size_t    offset;  // File offset of the top row
+    std::ptrdiff_t stride;  // Bytes from one row to the next, negative for bottom-up files
+
+    const std::uint8_t *swizzle; // Storage index of each RGB(A) channel, nullptr when stored in order
+    bool big_endian;             // 16-bit samples are stored big-endian
+};
+
+// Parses only the header of a BMP, binary PPM/PGM, uncompressed TGA or strip-based TIFF file
+bool parse_carrier(const std::uint8_t *data, std::size_t size, CarrierLayout &layout);
+
+// Whether the file extension names one of the formats handled by parse_carrier
+bool carrier_extension(const std::string &path);
@@ -0,0 +1,1110 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include "argparse/argparse.hpp"
+#include "aes.hpp"
+#include "analysis.hpp"
+#include "erasure.hpp"
+#include "image.hpp"
+#include "random.hpp"
+#include "stego.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+// Antarmuka baris perintah tanpa GLFW/OpenGL, untuk server dan skrip.
+// Data dari stdin dan ke stdout ditandai dengan jalur "-"
+
+namespace fs = std::filesystem;
+
+// Ubah nama tingkat encoding menjadi EncodingLevel
+static bool parse_level(const std::string &name, Image::EncodingLevel &level) {
+    if (name == "low")
+        level = Image::EncodingLevel::Low;
+    else if (name == "medium")
+        level = Image::EncodingLevel::Med;
+    else if (name == "high")
+        level = Image::EncodingLevel::High;
+    else if (name == "stc")
+        level = Image::EncodingLevel::Stc;
+    else if (name == "adaptive")
+        level = Image::EncodingLevel::Adaptive;
+    else
+        return false;
+
+    return true;
+}
+
+// Batas memori PNG besar dari --band-size dalam MiB, 0 memakai bawaan Image
+static std::size_t band_size(const argparse::ArgumentParser &parser) {
+    return std::size_t(std::max(parser.get<int>("--band-size"), 0)) << 20;
+}
+
+// Kata sandi dari argumen, dari variabel lingkungan STEGO_PASSWORD agar tidak terlihat
+// di daftar proses, atau ditanyakan lewat stdin jika stdin tidak membawa data
+static bool get_password(const argparse::ArgumentParser &parser, bool stdin_used, std::array<std::uint8_t, 32> &hash) {
+    std::string password;
+
+    if (auto value = parser.present("--passwd"))
+        password = *value;
+    else if (auto env = std::getenv("STEGO_PASSWORD"))
+        password = env;
+    else if (stdin_used) {
+        std::cerr << "ERROR: Kata sandi tidak diberikan, gunakan --passwd atau STEGO_PASSWORD" << std::endl;
+        return false;
+    } else {
+        std::cerr << "Password: ";
+        std::getline(std::cin, password);
+    }
+
+    hash = password_hash(password);
+    return true;
+}
+
+// Direktori sementara yang unik untuk data dari atau ke pipa
+static bool make_temp_dir(fs::path &dir) {
+    std::uint8_t id[8];
+    Random random;
+    if (!random.get(id, sizeof(id)))
+        return false;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "stego-%02x%02x%02x%02x%02x%02x%02x%02x",
+                  id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+
+    std::error_code ec;
+    dir = fs::temp_directory_path(ec) / name;
+    return !ec && fs::create_directory(dir, ec);
+}
+
+// Salin seluruh isi stream ke stream lain
+static bool copy_stream(std::FILE *from, std::FILE *to) {
+    char buffer[64 * 1024];
+    std::size_t n;
+
+    while ((n = std::fread(buffer, 1, sizeof(buffer), from)) > 0)
+        if (std::fwrite(buffer, 1, n, to) != n)
+            return false;
+
+    return !std::ferror(from) && std::fflush(to) == 0;
+}
+
+// Gambar tanpa kompresi (BMP/PPM/TGA/TIFF) dan QOI tetap memakai formatnya sendiri,
+// yang lain disimpan sebagai PNG
+static std::string output_extension(const fs::path &cover) {
+    bool keep_format = Image::mappable(cover.string()) || cover.extension() == ".qoi";
+    return keep_format ? cover.extension().string() : ".png";
+}
+
+static fs::path default_output(const fs::path &cover) {
+    return cover.parent_path() / (cover.stem().string() + "_embedded" + output_extension(cover));
+}
+
+// Pesan kemajuan ke stdout, tanpa flush per baris
+static void print(const std::string &message) {
+    std::cout << "* " << message << '\n';
+}
+
+// Cetak kesalahan dari hasil encode atau decode pada gambar path
+static bool report(const StegoResult &result, const std::string &path) {
+    std::cout.flush();
+
+    if (result.error == StegoError::LoadImage)
+        std::cerr << "ERROR: Gagal memuat gambar '" << path << "'" << std::endl;
+    else if (!result)
+        std::cerr << "ERROR: " << describe_error(result) << std::endl;
+
+    return bool(result);
+}
+
+// File yang disematkan sebagai arsip. File diberi nama filenya, isi direktori diberi
+// nama direktori diikuti jalur relatifnya
+static bool archive_files(const std::vector<std::string> &embeds, std::vector<ArchiveFile> &files) {
+    for (auto &embed : embeds) {
+        fs::path path(embed);
+        std::error_code ec;
+
+        if (embed == "-") {
+            std::cerr << "ERROR: stdin tidak dapat menjadi bagian dari arsip" << std::endl;
+            return false;
+        }
+
+        if (!fs::is_directory(path, ec)) {
+            files.push_back({embed, path.filename().string()});
+            continue;
+        }
+
+        // Nama direktori tanpa garis miring di akhir
+        fs::path root = path.has_filename() ? path : path.parent_path();
+        std::vector<ArchiveFile> found;
+        for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file())
+                found.push_back({it->path().string(), (root.filename() / it->path().lexically_relative(path)).generic_string()});
+        }
+
+        if (ec) {
+            std::cerr << "ERROR: Tidak dapat membaca direktori '" << embed << "'" << std::endl;
+            return false;
+        }
+
+        std::sort(found.begin(), found.end(), [](const ArchiveFile &a, const ArchiveFile &b) { return a.name < b.name; });
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    return true;
+}
+
+static int run_encode(const argparse::ArgumentParser &parser) {
+    auto covers  = parser.get<std::vector<std::string>>("--input");
+    auto cover   = covers[0];
+    auto embeds  = parser.get<std::vector<std::string>>("--embed");
+    auto payload = embeds[0];
+
+    // Beberapa file atau direktori disematkan sebagai arsip, yang nantinya bisa diperbarui
+    std::vector<ArchiveFile> files;
+    if (parser.get<bool>("--archive") || embeds.size() > 1 || fs::is_directory(payload)) {
+        if (!archive_files(embeds, files))
+            return 1;
+        payload = "archive";
+    }
+
+    Image::EncodingLevel level;
+    if (!parse_level(parser.get("--level"), level)) {
+        std::cerr << "ERROR: Tingkat encoding tidak dikenal '" << parser.get("--level") << "'" << std::endl;
+        return 1;
+    }
+
+    std::array<std::uint8_t, 32> hash;
+    if (!get_password(parser, payload == "-", hash))
+        return 1;
+
+    std::string output;
+    if (auto value = parser.present("--output"))
+        output = *value;
+    else
+        output = default_output(cover).string();
+
+    Image::StcCost cost;
+    if (parser.get("--cost") == "texture")
+        cost = Image::StcCost::Texture;
+    else if (parser.get("--cost") == "flat")
+        cost = Image::StcCost::Flat;
+    else {
+        std::cerr << "ERROR: Biaya STC tidak dikenal '" << parser.get("--cost") << "'" << std::endl;
+        return 1;
+    }
+
+    int parity = parser.get<int>("--parity");
+    if (parity < 0 || (parity && std::size_t(parity) >= covers.size())) {
+        std::cerr << "ERROR: --parity harus lebih kecil dari jumlah gambar input" << std::endl;
+        return 1;
+    }
+
+    // Beberapa sampul: sematan dipecah, dan output adalah direktori untuk gambar-gambarnya
+    std::vector<std::string> outputs;
+    if (covers.size() > 1) {
+        std::error_code ec;
+        if (parser.present("--output"))
+            fs::create_directories(output, ec);
+
+        for (auto &path : covers) {
+            fs::path result = default_output(path);
+            outputs.push_back(parser.present("--output") ? (fs::path(output) / result.filename()).string() : result.string());
+        }
+    }
+
+    // Data dari stdin ditulis dulu ke file sementara, karena encode memetakan file input
+    fs::path temp;
+    std::error_code ec;
+    if (payload == "-") {
+        if (!make_temp_dir(temp)) {
+            std::cerr << "ERROR: Tidak dapat membuat direktori sementara" << std::endl;
+            return 1;
+        }
+
+        payload = (temp / "stdin").string();
+        std::FILE *file = std::fopen(payload.c_str(), "wb");
+        bool copied = file && copy_stream(stdin, file);
+        if (file)
+            copied = std::fclose(file) == 0 && copied;
+
+        if (!copied) {
+            std::cerr << "ERROR: Tidak dapat membaca data dari stdin" << std::endl;
+            fs::remove_all(temp, ec);
+            return 1;
+        }
+    }
+
+    EncodeRequest request;
+    request.password  = hash;
+    request.input     = payload;
+    request.output    = output;
+    request.level     = level;
+    request.measure   = parser.get<bool>("--quality");
+    request.compress  = !parser.get<bool>("--no-compress");
+    request.files     = files;
+    request.parity    = std::size_t(parity);
+    request.cost      = cost;
+    request.band_size = band_size(parser);
+    auto result = outputs.empty() ? encode_file(cover, request, print) : encode_shards(covers, outputs, request, print);
+    bool ok = report(result, outputs.empty() ? cover : result.output);
+
+    if (!temp.empty())
+        fs::remove_all(temp, ec);
+
+    return ok ? 0 : 1;
+}
+
+static int run_update(const argparse::ArgumentParser &parser) {
+    auto input  = parser.get("--input");
+    auto embeds = parser.get<std::vector<std::string>>("--embed");
+
+    std::vector<ArchiveFile> files;
+    if (!archive_files(embeds, files))
+        return 1;
+
+    // Letakkan file di bawah direktori arsip, misalnya untuk mengganti entri dari direktori yang disematkan
+    if (auto prefix = parser.present("--prefix")) {
+        for (auto &file : files)
+            file.name = (fs::path(*prefix) / file.name).generic_string();
+    }
+
+    std::array<std::uint8_t, 32> hash;
+    if (!get_password(parser, false, hash))
+        return 1;
+
+    std::string output;
+    if (auto value = parser.present("--output"))
+        output = *value;
+
+    EncodeRequest request;
+    request.password  = hash;
+    request.input     = "archive";
+    request.output    = output;
+    request.measure   = parser.get<bool>("--quality");
+    request.compress  = !parser.get<bool>("--no-compress");
+    request.files     = files;
+    request.band_size = band_size(parser);
+    return report(update_file(input, request, print), input) ? 0 : 1;
+}
+
+// Rentang "AWAL:PANJANG" dalam byte, tanpa panjang berarti sampai akhir file
+static bool parse_range(const std::string &text, std::uint64_t &offset, std::uint64_t &length) {
+    auto colon = text.find(':');
+    std::string start = text.substr(0, colon);
+    std::string count = colon == std::string::npos ? "" : text.substr(colon + 1);
+
+    auto parse = [](const std::string &digits, std::uint64_t &value) {
+        if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        errno = 0;
+        value = std::strtoull(digits.c_str(), nullptr, 10);
+        return errno != ERANGE;
+    };
+
+    length = UINT64_MAX;
+    return parse(start, offset) && (count.empty() || (parse(count, length) && length));
+}
+
+static int run_decode(const argparse::ArgumentParser &parser) {
+    auto inputs = parser.get<std::vector<std::string>>("--input");
+    auto input  = inputs[0];
+    auto output = parser.get("--output");
+
+    auto range = parser.present("--range");
+    std::uint64_t offset = 0, length = 0;
+    if (range && !parse_range(*range, offset, length)) {
+        std::cerr << "ERROR: Rentang tidak valid '" << *range << "', gunakan AWAL:PANJANG" << std::endl;
+        return 1;
+    }
+    if (range && inputs.size() > 1) {
+        std::cerr << "ERROR: --range hanya dapat dipakai dengan satu gambar" << std::endl;
+        return 1;
+    }
+
+    std::array<std::uint8_t, 32> hash;
+    if (!get_password(parser, false, hash))
+        return 1;
+
+    // Output ke stdout: decode ke file sementara lalu salin, pesan dialihkan ke stderr
+    bool to_stdout = output == "-";
+    fs::path temp;
+    std::error_code ec;
+
+    if (to_stdout) {
+        if (!make_temp_dir(temp)) {
+            std::cerr << "ERROR: Tidak dapat membuat direktori sementara" << std::endl;
+            return 1;
+        }
+
+        output = (temp / "stdout").string();
+        if (std::cout.rdbuf())
+            std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    DecodeRequest request;
+    request.password  = hash;
+    request.output    = output;
+    request.band_size = band_size(parser);
+    if (auto entries = parser.present<std::vector<std::string>>("--entry"))
+        request.entries = *entries;
+    request.list    = parser.get<bool>("--list");
+
+    // Beberapa gambar adalah pecahan dari satu sematan
+    StegoResult result;
+    if (inputs.size() > 1)
+        result = decode_shards(inputs, request, print);
+    else if (range)
+        result = decode_range_file(input, request, offset, length, print);
+    else
+        result = decode_file(input, request, print);
+    bool ok = report(result, inputs.size() > 1 ? result.output : input);
+
+    // Isi arsip: ukuran asli, ukuran tersimpan dan nama
+    if (ok && request.list) {
+        for (auto &entry : result.entries)
+            std::cout << std::setw(12) << entry.size << " " << std::setw(12) << entry.stored_size
+                      << (entry.compressed ? " deflate " : " stored  ") << entry.name << '\n';
+    }
+
+    // Arsip ke stdout: hanya satu entri yang dapat ditulis
+    if (ok && to_stdout && !result.entries.empty() && !request.list) {
+        if (request.entries.size() != 1) {
+            std::cerr << "ERROR: Pilih tepat satu entri dengan --entry untuk menulis arsip ke stdout" << std::endl;
+            ok = false;
+        } else {
+            output = (fs::path(output) / request.entries[0]).string();
+        }
+    }
+
+    if (to_stdout) {
+        if (ok && !request.list) {
+            std::FILE *file = std::fopen(output.c_str(), "rb");
+            if (!file || !copy_stream(file, stdout)) {
+                std::cerr << "ERROR: Tidak dapat menulis ke stdout" << std::endl;
+                ok = false;
+            }
+            if (file)
+                std::fclose(file);
+        }
+
+        fs::remove_all(temp, ec);
+    }
+
+    return ok ? 0 : 1;
+}
+
+static int run_info(const argparse::ArgumentParser &parser) {
+    auto input = parser.get("--input");
+
+    Image image;
+    if (!image.load(input)) {
+        std::cerr << "ERROR: Gagal memuat gambar '" << input << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Ukuran gambar: " << image.w() << "x" << image.h() << " piksel" << std::endl;
+    std::cout << "Format gambar: " << image.c() << " kanal, " << image.depth() << " bit" << std::endl;
+
+    for (int i = 0; i < 5; i++) {
+        auto level = static_cast<Image::EncodingLevel>(i);
+        std::cout << "Ukuran sematan maks (" << level_to_str[i] << "): " << data_size(capacity(image, level)) << std::endl;
+    }
+
+    auto stats = probe(image);
+    std::cout << "LSB Salt, IV dan Header: " << (stats.random ? "tampak acak, mungkin berisi sematan" : "tidak acak, tidak ada sematan")
+              << " (monobit " << std::fixed << std::setprecision(2) << stats.monobit << ", runs " << stats.runs
+              << ", pasangan " << stats.pairs << ", nibble " << stats.nibbles << ")" << std::endl;
+
+    return 0;
+}
+
+// Satu pekerjaan batch. Untuk decode, input adalah gambar dan output boleh kosong
+struct Job {
+    std::string input, payload, output, directory;
+    Image::EncodingLevel level;
+};
+
+// Baca manifest ('-' untuk stdin) berisi satu pekerjaan per baris dengan kolom dipisah tab:
+// encode "sampul, sematan, output[, tingkat]", decode "gambar[, output]".
+// Baris kosong dan baris yang diawali '#' dilewati
+static bool read_manifest(const std::string &path, bool decoding, Image::EncodingLevel level, std::vector<Job> &jobs) {
+    std::ifstream file;
+    if (path != "-" && (file.open(path), !file)) {
+        std::cerr << "ERROR: Tidak dapat membuka manifest '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::istream &in = path == "-" ? std::cin : file;
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); number++) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::vector<std::string> fields;
+        std::size_t start = 0, end;
+        while ((end = line.find('\t', start)) != std::string::npos) {
+            fields.push_back(line.substr(start, end - start));
+            start = end + 1;
+        }
+        fields.push_back(line.substr(start));
+
+        Job job{};
+        job.level = level;
+
+        bool valid;
+        if (decoding) {
+            valid = fields.size() <= 2;
+            job.input  = fields[0];
+            job.output = fields.size() > 1 ? fields[1] : "";
+        } else {
+            valid = fields.size() == 3 || (fields.size() == 4 && parse_level(fields[3], job.level));
+            if (valid) {
+                job.input   = fields[0];
+                job.payload = fields[1];
+                job.output  = fields[2];
+            }
+        }
+
+        if (!valid || job.input.empty()) {
+            std::cerr << "ERROR: Baris " << number << " pada manifest '" << path << "' tidak valid" << std::endl;
+            return false;
+        }
+
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+// File biasa di dalam direktori, diurutkan menurut nama
+static bool list_files(const std::string &directory, std::vector<fs::path> &files) {
+    std::error_code ec;
+    for (auto &entry : fs::directory_iterator(directory, ec))
+        if (entry.is_regular_file())
+            files.push_back(entry.path());
+
+    if (ec) {
+        std::cerr << "ERROR: Tidak dapat membaca direktori '" << directory << "'" << std::endl;
+        return false;
+    }
+
+    std::sort(files.begin(), files.end());
+    return true;
+}
+
+// Pasangan direktori: setiap sematan dimasukkan ke sampul dengan nama (tanpa ekstensi)
+// yang sama, dan setiap gambar didekode ke subdirektori output dengan namanya
+static bool read_directories(const argparse::ArgumentParser &parser, bool decoding, Image::EncodingLevel level, std::vector<Job> &jobs) {
+    auto input  = parser.present("--input");
+    auto output = parser.present("--output");
+    auto embed  = parser.present("--embed");
+
+    if (!input || !output || (!decoding && !embed)) {
+        std::cerr << "ERROR: Gunakan --manifest, atau --input dan --output" << (decoding ? "" : " dan --embed") << std::endl;
+        return false;
+    }
+
+    std::vector<fs::path> images;
+    if (!list_files(*input, images))
+        return false;
+
+    std::error_code ec;
+    fs::create_directories(*output, ec);
+
+    if (decoding) {
+        for (auto &image : images) {
+            Job job{};
+            job.input     = image.string();
+            job.directory = (fs::path(*output) / image.stem()).string();
+            jobs.push_back(job);
+        }
+
+        return true;
+    }
+
+    std::map<std::string, fs::path> covers;
+    for (auto &image : images)
+        covers.emplace(image.stem().string(), image);
+
+    std::vector<fs::path> payloads;
+    if (!list_files(*embed, payloads))
+        return false;
+
+    for (auto &payload : payloads) {
+        auto cover = covers.find(payload.stem().string());
+        if (cover == covers.end()) {
+            std::cerr << "ERROR: Tidak ada sampul untuk '" << payload.string() << "'" << std::endl;
+            return false;
+        }
+
+        Job job{};
+        job.input   = cover->second.string();
+        job.payload = payload.string();
+        job.output  = (fs::path(*output) / (cover->second.stem().string() + output_extension(cover->second))).string();
+        job.level   = level;
+        jobs.push_back(job);
+    }
+
+    return true;
+}
+
+static int run_batch(const argparse::ArgumentParser &parser) {
+    auto mode = parser.get("mode");
+    bool decoding = mode == "decode";
+    if (!decoding && mode != "encode") {
+        std::cerr << "ERROR: Mode batch tidak dikenal '" << mode << "', gunakan encode atau decode" << std::endl;
+        return 1;
+    }
+
+    Image::EncodingLevel level;
+    if (!parse_level(parser.get("--level"), level)) {
+        std::cerr << "ERROR: Tingkat encoding tidak dikenal '" << parser.get("--level") << "'" << std::endl;
+        return 1;
+    }
+
+    std::vector<Job> jobs;
+    auto manifest = parser.present("--manifest");
+    if (manifest ? !read_manifest(*manifest, decoding, level, jobs) : !read_directories(parser, decoding, level, jobs))
+        return 1;
+
+    std::array<std::uint8_t, 32> hash;
+    if (!get_password(parser, manifest && *manifest == "-", hash))
+        return 1;
+
+    // Pekerjaan dibagi ke pool work-stealing. Deflate di dalam pekerjaan memakai
+    // pekerja pool yang sama, sehingga jumlah thread tidak melebihi jumlah core
+    auto start = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::size_t failed = 0, skipped = 0;
+    std::uint64_t bytes = 0;
+    bool probing = decoding && !parser.get<bool>("--no-probe");
+    std::size_t bands = band_size(parser);
+
+    {
+        ThreadPool pool(parser.get<int>("--jobs") > 0 ? parser.get<int>("--jobs") : 0);
+
+        for (auto &job : jobs) {
+            pool.submit([&]() {
+                StegoResult result;
+
+                if (decoding) {
+                    std::error_code ec;
+                    if (!job.directory.empty())
+                        fs::create_directories(job.directory, ec);
+                    DecodeRequest request;
+                    request.password  = hash;
+                    request.output    = job.output;
+                    request.directory = job.directory;
+                    request.probe     = probing;
+                    request.band_size = bands;
+                    result = decode_file(job.input, request);
+                } else {
+                    EncodeRequest request;
+                    request.password  = hash;
+                    request.input     = job.payload;
+                    request.output    = job.output;
+                    request.level     = job.level;
+                    request.band_size = bands;
+                    result = encode_file(job.input, request);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (result.error == StegoError::NoEmbed) {
+                    skipped++;
+                    std::cout << "- " << job.input << ": " << describe_error(result) << '\n';
+                } else if (!result) {
+                    failed++;
+                    std::cerr << "ERROR: " << job.input << ": " << describe_error(result) << '\n';
+                } else {
+                    bytes += result.size;
+                    std::cout << "* " << job.input << " -> " << result.output << " (" << data_size(result.size) << ")\n";
+                }
+            });
+        }
+
+        pool.wait();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    seconds = std::max(seconds, 1e-9);
+
+    std::cout << "* " << jobs.size() - failed - skipped << " dari " << jobs.size() << " gambar berhasil";
+    if (skipped)
+        std::cout << ", " << skipped << " dilewati tanpa sematan";
+    std::cout << " dalam " << std::fixed << std::setprecision(2) << seconds << " detik: "
+              << jobs.size() / seconds << " gambar/detik, " << data_size(bytes / seconds) << "/detik" << std::endl;
+
+    return failed ? 1 : 0;
+}
+
+// Sematkan size byte acak dari sampel pertama pada tingkat tersebut, seperti encode tanpa
+// menyimpan gambar, lalu analisis hasilnya
+static bool simulate(const std::string &path, std::size_t size, Image::EncodingLevel level, Analysis &result) {
+    Image image;
+    if (!image.load(path) || image.streamed())
+        return false;
+
+    size = std::min(size, image.decoded_size(image.units(level), level));
+    std::vector<std::uint8_t> data(size);
+
+    Random random;
+    if (!random.get(data.data(), data.size()) || !image.encode(data.data(), data.size(), level))
+        return false;
+
+    return analyze(image, result);
+}
+
+static const char *verdict(const Analysis &analysis) {
+    return analysis.detected() ? "terdeteksi" : "tidak terdeteksi";
+}
+
+static int run_analyze(const argparse::ArgumentParser &parser) {
+    std::vector<std::string> images;
+    for (auto &input : parser.get<std::vector<std::string>>("--input")) {
+        std::vector<fs::path> files;
+        if (!fs::is_directory(input))
+            images.push_back(input);
+        else if (list_files(input, files))
+            for (auto &file : files)
+                images.push_back(file.string());
+        else
+            return 1;
+    }
+
+    std::size_t size = 0;
+    auto embed = parser.present("--embed");
+    if (embed) {
+        std::error_code ec;
+        size = fs::file_size(*embed, ec);
+        if (ec) {
+            std::cerr << "ERROR: Tidak dapat membuka file sematan '" << *embed << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    bool blocks = parser.get<bool>("--blocks");
+
+    auto start = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::size_t failed = 0, detected = 0;
+    std::uint64_t pixels = 0;
+
+    {
+        ThreadPool pool(parser.get<int>("--jobs") > 0 ? parser.get<int>("--jobs") : 0);
+
+        for (auto &path : images) {
+            pool.submit([&]() {
+                std::ostringstream ss;
+                ss << std::fixed << std::setprecision(3);
+
+                Image image;
+                Analysis analysis;
+                bool ok = image.load(path) && analyze(image, analysis);
+
+                if (ok) {
+                    ss << "* " << path << ": tingkat sematan " << analysis.rate << " (RS " << analysis.rs << ", SPA "
+                       << analysis.spa << ", p chi-kuadrat " << analysis.chi_square << ", blok tertinggi "
+                       << analysis.peak << "), " << verdict(analysis) << '\n';
+
+                    for (std::size_t c = 0; c < analysis.channels.size(); c++) {
+                        auto &channel = analysis.channels[c];
+                        ss << "  Kanal " << c << ": RS " << channel.rs << ", SPA " << channel.spa
+                           << ", p chi-kuadrat " << channel.chi_square << '\n';
+                    }
+
+                    if (blocks) {
+                        for (auto &block : analysis.blocks)
+                            ss << "  Baris " << block.y << "-" << block.y + block.rows - 1 << ": " << block.rate
+                               << " (RS " << block.rs << ", SPA " << block.spa << ", p chi-kuadrat " << block.chi_square << ")\n";
+                    }
+
+                    // Tingkat yang lebih tinggi memakai lebih sedikit sampel untuk sematan yang sama,
+                    // STC memakai lebih banyak sampel tetapi mengubah lebih sedikit, dan Adaptive
+                    // hanya memakai blok bertekstur
+                    for (int i = 0; embed && i < 5; i++) {
+                        Analysis simulated;
+                        if (simulate(path, size, static_cast<Image::EncodingLevel>(i), simulated))
+                            ss << "  Dengan sematan " << data_size(size) << " (" << level_to_str[i] << "): tingkat sematan "
+                               << simulated.rate << ", blok tertinggi " << simulated.peak << ", " << verdict(simulated) << '\n';
+                        else
+                            ss << "  Dengan sematan " << data_size(size) << " (" << level_to_str[i] << "): tidak dapat disimulasikan\n";
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok) {
+                    failed++;
+                    std::cerr << "ERROR: Gagal memuat gambar '" << path << "'\n";
+                } else {
+                    detected += analysis.detected();
+                    pixels   += std::uint64_t(image.w()) * image.h();
+                    std::cout << ss.str();
+                }
+            });
+        }
+
+        pool.wait();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    seconds = std::max(seconds, 1e-9);
+
+    std::cout << "* " << images.size() - failed << " gambar dianalisis, " << detected << " terdeteksi, dalam "
+              << std::fixed << std::setprecision(2) << seconds << " detik: " << images.size() / seconds << " gambar/detik, "
+              << pixels / seconds / 1e6 << " megapiksel/detik" << std::endl;
+
+    return failed ? 1 : 0;
+}
+
+// Waktu terbaik dari beberapa putaran f, dalam detik
+static double best_time(int rounds, const std::function<void()> &f) {
+    double best = 1e300;
+    for (int i = 0; i < rounds; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return std::max(best, 1e-9);
+}
+
+static void print_rate(const char *stage, std::size_t size, double seconds) {
+    std::cout << "* " << stage << ": " << data_size(size) << " dalam " << std::fixed << std::setprecision(2)
+              << seconds * 1e3 << " ms, " << size / seconds / 1e6 << " MB/detik" << std::endl;
+}
+
+// Ukur throughput kode erasure, AES dan encoding LSB pada buffer acak yang sama, sebesar
+// kapasitas gambar pada tingkat tersebut. Kode erasure dan AES berjalan pada satu thread
+static int run_bench(const argparse::ArgumentParser &parser) {
+    auto input = parser.get("--input");
+
+    Image::EncodingLevel level;
+    if (!parse_level(parser.get("--level"), level)) {
+        std::cerr << "ERROR: Tingkat encoding tidak dikenal '" << parser.get("--level") << "'" << std::endl;
+        return 1;
+    }
+
+    int data_count = parser.get<int>("--data"), parity = parser.get<int>("--parity");
+    int rounds = std::max(parser.get<int>("--rounds"), 1);
+    if (data_count < 1 || parity < 1 || parity > data_count || std::size_t(data_count + parity) > ErasureCode::max_blocks) {
+        std::cerr << "ERROR: Jumlah shard data atau paritas tidak valid" << std::endl;
+        return 1;
+    }
+
+    Image image;
+    if (!image.load(input) || image.streamed()) {
+        std::cerr << "ERROR: Gagal memuat gambar '" << input << "' ke memori" << std::endl;
+        return 1;
+    }
+
+    // Kelipatan 16 byte untuk AES dan sama rata untuk setiap shard data
+    std::size_t size  = image.decoded_size(image.units(level), level);
+    std::size_t block = size / data_count / 16 * 16;
+    size              = block * data_count;
+    if (block == 0) {
+        std::cerr << "ERROR: Gambar terlalu kecil untuk pengukuran" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::uint8_t> buffer(size), output(size), shards(block * parity);
+    std::uint8_t key[32], iv[16];
+    Random random;
+    if (!random.get(buffer.data(), size) || !random.get(key, sizeof(key)) || !random.get(iv, sizeof(iv))) {
+        std::cerr << "ERROR: Gagal membuat data acak" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Buffer: " << data_size(size) << ", " << data_count << " shard data dan " << parity
+              << " shard paritas, tingkat " << level_to_str[static_cast<int>(level)] << std::endl;
+
+    ErasureCode code(data_count, data_count + parity);
+    std::vector<const std::uint8_t *> blocks;
+    std::vector<std::uint8_t *> parities;
+    for (int i = 0; i < data_count; i++)
+        blocks.push_back(buffer.data() + i * block);
+    for (int i = 0; i < parity; i++)
+        parities.push_back(shards.data() + i * block);
+
+    print_rate("Kode erasure (encode)", size, best_time(rounds, [&]() {
+        code.encode(blocks.data(), parities.data(), block);
+    }));
+
+    // Shard data pertama hilang dan diganti oleh shard paritas
+    std::vector<std::size_t> present;
+    std::vector<const std::uint8_t *> chosen;
+    for (int i = 0; i < data_count; i++) {
+        present.push_back(i < parity ? data_count + i : i);
+        chosen.push_back(i < parity ? parities[i] : blocks[i]);
+    }
+
+    std::vector<std::uint8_t> inverse;
+    if (!code.solve(present, inverse)) {
+        std::cerr << "ERROR: Sistem paritas tidak dapat diselesaikan" << std::endl;
+        return 1;
+    }
+
+    print_rate("Kode erasure (rebuild)", block * parity, best_time(rounds, [&]() {
+        for (int i = 0; i < parity; i++)
+            code.rebuild(inverse, i, chosen.data(), output.data() + i * block, block);
+    }));
+
+    if (!std::equal(output.begin(), output.begin() + block * parity, buffer.begin())) {
+        std::cerr << "ERROR: Shard yang dibangun ulang tidak sama dengan aslinya" << std::endl;
+        return 1;
+    }
+
+    print_rate("AES-256-CBC (encrypt)", size, best_time(rounds, [&]() {
+        AES(key, iv).cbc_encrypt(buffer.data(), size, output.data());
+    }));
+
+    bool encoded = true;
+    print_rate("Encoding LSB", size, best_time(rounds, [&]() {
+        encoded &= image.encode(buffer.data(), size, level);
+    }));
+
+    if (!encoded) {
+        std::cerr << "ERROR: Gagal menyematkan buffer ke gambar" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    argparse::ArgumentParser program("steganography-cli");
+    program.add_argument("-q", "--quiet")
+        .help("only print errors.")
+        .default_value(false)
+        .implicit_value(true);
+
+    argparse::ArgumentParser encode_command("encode");
+    encode_command.add_description("Encodes an embed-file into an image");
+    encode_command.add_argument("-i", "--input")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("specify the input image. Several images share the embed, split by their capacity.");
+    encode_command.add_argument("-o", "--output")
+        .help("specify the output image, or the output directory for several images. [default: <input>_embedded]");
+    encode_command.add_argument("-e", "--embed")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("specify the file to embed, '-' reads stdin. Several files or directories are embedded as an archive.");
+    encode_command.add_argument("-l", "--level")
+        .default_value(std::string("low"))
+        .help("specify the encoding level: low, medium, high, stc or adaptive.");
+    encode_command.add_argument("-p", "--passwd")
+        .help("specify the encryption password.");
+    encode_command.add_argument("--quality")
+        .help("print the PSNR, SSIM and histogram shift caused by the embed.")
+        .default_value(false)
+        .implicit_value(true);
+    encode_command.add_argument("--no-compress")
+        .help("store the file without deflate, so that decode --range can seek into it.")
+        .default_value(false)
+        .implicit_value(true);
+    encode_command.add_argument("--archive")
+        .help("embed even a single file as an archive, which update can add files to.")
+        .default_value(false)
+        .implicit_value(true);
+    encode_command.add_argument("--cost")
+        .default_value(std::string("texture"))
+        .help("with level stc, the cost of changing a sample: texture avoids smooth areas, flat treats all samples alike.");
+    encode_command.add_argument("--parity")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("with several images, store Reed-Solomon parity in this many, so that decode needs only as many images as hold data.");
+
+    encode_command.add_argument("--band-size")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("stream PNG images whose pixels take more than this many MiB, in bands of that size. 0 streams above 1 GiB in 64 MiB bands.");
+
+    argparse::ArgumentParser update_command("update");
+    update_command.add_description("Adds or replaces files in an embedded archive, without re-embedding the others");
+    update_command.add_argument("-i", "--input")
+        .required()
+        .help("specify the image holding the archive.");
+    update_command.add_argument("-o", "--output")
+        .help("specify the output image. [default: update the input in place]");
+    update_command.add_argument("-e", "--embed")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("specify the files or directories to add, entries with the same name are replaced.");
+    update_command.add_argument("--prefix")
+        .help("place the files under this directory of the archive.");
+    update_command.add_argument("-p", "--passwd")
+        .help("specify the encryption password.");
+    update_command.add_argument("--quality")
+        .help("print the PSNR, SSIM and histogram shift caused by the update.")
+        .default_value(false)
+        .implicit_value(true);
+    update_command.add_argument("--no-compress")
+        .help("store the files without deflate.")
+        .default_value(false)
+        .implicit_value(true);
+
+    update_command.add_argument("--band-size")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("stream PNG images whose pixels take more than this many MiB, in bands of that size. 0 streams above 1 GiB in 64 MiB bands.");
+
+    argparse::ArgumentParser decode_command("decode");
+    decode_command.add_description("Decodes and extracts an embed-file from an image");
+    decode_command.add_argument("-i", "--input")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("specify the input image, or all images holding the shards of one embed in any order.");
+    decode_command.add_argument("-o", "--output")
+        .default_value(std::string(""))
+        .help("specify the output file, '-' writes stdout.");
+    decode_command.add_argument("-p", "--passwd")
+        .help("specify the encryption password.");
+    decode_command.add_argument("-x", "--entry")
+        .append()
+        .help("only extract this entry of an archive, may be repeated. Archives go to the output directory.");
+    decode_command.add_argument("--list")
+        .help("only list the entries of an archive.")
+        .default_value(false)
+        .implicit_value(true);
+    decode_command.add_argument("-r", "--range")
+        .help("only extract the bytes START:LENGTH of the embed-file. [default output: <name>.<start>-<end>]");
+
+    decode_command.add_argument("--band-size")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("stream PNG images whose pixels take more than this many MiB, in bands of that size. 0 streams above 1 GiB in 64 MiB bands.");
+
+    argparse::ArgumentParser info_command("info");
+    info_command.add_description("Shows the image format and the max embed size per level");
+    info_command.add_argument("-i", "--input")
+        .required()
+        .help("specify the input image.");
+
+    argparse::ArgumentParser batch_command("batch");
+    batch_command.add_description("Encodes or decodes many images on all cores");
+    batch_command.add_argument("mode")
+        .help("encode or decode.");
+    batch_command.add_argument("-m", "--manifest")
+        .help("specify a manifest with one tab separated job per line: cover, embed, output[, level] or image[, output].");
+    batch_command.add_argument("-i", "--input")
+        .help("specify the directory of covers or images, instead of a manifest.");
+    batch_command.add_argument("-e", "--embed")
+        .help("specify the directory of files to embed, each goes into the cover with the same name.");
+    batch_command.add_argument("-o", "--output")
+        .help("specify the output directory.");
+    batch_command.add_argument("-l", "--level")
+        .default_value(std::string("low"))
+        .help("specify the encoding level: low, medium, high, stc or adaptive.");
+    batch_command.add_argument("-j", "--jobs")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("specify the number of threads, 0 uses all cores.");
+    batch_command.add_argument("-p", "--passwd")
+        .help("specify the encryption password.");
+    batch_command.add_argument("--no-probe")
+        .help("decode every image, instead of skipping those whose low bits do not look encrypted.")
+        .default_value(false)
+        .implicit_value(true);
+
+    batch_command.add_argument("--band-size")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("stream PNG images whose pixels take more than this many MiB, in bands of that size. 0 streams above 1 GiB in 64 MiB bands.");
+
+    argparse::ArgumentParser analyze_command("analyze");
+    analyze_command.add_description("Estimates the LSB embedding rate of images");
+    analyze_command.add_argument("-i", "--input")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("specify the images or directories of images.");
+    analyze_command.add_argument("-e", "--embed")
+        .help("also analyse every image with a file of this size embedded at each level.");
+    analyze_command.add_argument("-b", "--blocks")
+        .help("print the estimate of every block of rows.")
+        .default_value(false)
+        .implicit_value(true);
+    analyze_command.add_argument("-j", "--jobs")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("specify the number of threads, 0 uses all cores.");
+
+    argparse::ArgumentParser bench_command("bench");
+    bench_command.add_description("Measures the throughput of the erasure code, AES and LSB encoding on one buffer");
+    bench_command.add_argument("-i", "--input")
+        .required()
+        .help("specify the cover image, the buffer takes its capacity at the level.");
+    bench_command.add_argument("-l", "--level")
+        .default_value(std::string("low"))
+        .help("specify the encoding level, as for encode.");
+    bench_command.add_argument("-d", "--data")
+        .default_value(4)
+        .scan<'i', int>()
+        .help("specify the number of data shards the buffer is cut into.");
+    bench_command.add_argument("--parity")
+        .default_value(2)
+        .scan<'i', int>()
+        .help("specify the number of parity shards, rebuild replaces as many data shards.");
+    bench_command.add_argument("-r", "--rounds")
+        .default_value(5)
+        .scan<'i', int>()
+        .help("specify the number of rounds, the fastest is printed.");
+
+    program.add_subparser(encode_command);
+    program.add_subparser(update_command);
+    program.add_subparser(decode_command);
+    program.add_subparser(info_command);
+    program.add_subparser(batch_command);
+    program.add_subparser(analyze_command);
+    program.add_subparser(bench_command);
+
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error &err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return 1;
+    }
+
+    if (program.get<bool>("--quiet"))
+        std::cout.rdbuf(nullptr);
+
+    if (program.is_subcommand_used("encode"))
+        return run_encode(encode_command);
+    if (program.is_subcommand_used("update"))
+        return run_update(update_command);
+    if (program.is_subcommand_used("decode"))
+        return run_decode(decode_command);
+    if (program.is_subcommand_used("info"))
+        return run_info(info_command);
+    if (program.is_subcommand_used("batch"))
+        return run_batch(batch_command);
+    if (program.is_subcommand_used("analyze"))
+        return run_analyze(analyze_command);
+    if (program.is_subcommand_used("bench"))
+        return run_bench(bench_command);
+
+    std::cerr << program;
+    return 1;
+}
@@ -0,0 +1,174 @@
+#include "deflate.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "thread_pool.hpp"
+
+// Uncompressed bytes per chunk handed to a thread
+static const std::size_t chunk_size = 1024 * 1024;
+// Deflate window, used as the dictionary of every chunk but the first
+static const std::size_t window_size = 32 * 1024;
+// Bytes looked at by the entropy probe
+static const std::size_t probe_size = 64 * 1024;
+
+struct Chunk {
+    std::vector<std::uint8_t> out;
+    std::uint32_t crc;
+    bool ok;
+};
+
+static void deflate_chunk(const std::uint8_t *data, std::size_t size, std::size_t begin, std::size_t end, Chunk &chunk) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+
+    chunk.ok  = false;
+    chunk.crc = crc32(0, data + begin, end - begin);
+
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    if (begin) {
+        auto dictionary = std::min(begin, window_size);
+        deflateSetDictionary(&stream, data + begin - dictionary, dictionary);
+    }
+
+    // The sync flush adds an empty stored block after the bound
+    chunk.out.resize(deflateBound(&stream, end - begin) + 16);
+
+    stream.next_in   = const_cast<std::uint8_t*>(data + begin);
+    stream.avail_in  = end - begin;
+    stream.next_out  = chunk.out.data();
+    stream.avail_out = chunk.out.size();
+
+    // Only the last chunk closes the stream, the others end on a byte boundary
+    int flush  = end == size ? Z_FINISH : Z_SYNC_FLUSH;
+    int result = deflate(&stream, flush);
+
+    chunk.ok = flush == Z_FINISH ? result == Z_STREAM_END : result == Z_OK && !stream.avail_in && stream.avail_out;
+    chunk.out.resize(stream.total_out);
+
+    deflateEnd(&stream);
+}
+
+bool deflate_parallel(const std::uint8_t *data, std::size_t size, std::vector<std::uint8_t> &out, std::uint32_t &crc) {
+    std::size_t count = std::max<std::size_t>(1, (size + chunk_size - 1) / chunk_size);
+    std::vector<Chunk> chunks(count);
+
+    parallel_for(count, [&](std::size_t i) {
+        deflate_chunk(data, size, i * chunk_size, std::min(size, (i + 1) * chunk_size), chunks[i]);
+    });
+
+    crc = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        if (!chunks[i].ok)
+            return false;
+
+        std::size_t length = std::min(size, (i + 1) * chunk_size) - i * chunk_size;
+        crc = i ? crc32_combine(crc, chunks[i].crc, length) : chunks[i].crc;
+        out.insert(out.end(), chunks[i].out.begin(), chunks[i].out.end());
+    }
+
+    return true;
+}
+
+bool looks_compressed(const std::uint8_t *data, std::size_t size) {
+    std::size_t n = std::min(size, probe_size);
+
+    // Too little to tell, deflate decides by the result instead
+    if (n < 1024)
+        return false;
+
+    std::size_t histogram[256] = {};
+    for (std::size_t i = 0; i < n; i++)
+        histogram[data[i]]++;
+
+    double entropy = 0;
+    for (auto count : histogram) {
+        if (count) {
+            double p = double(count) / n;
+            entropy -= p * std::log2(p);
+        }
+    }
+
+    // Bits per byte; deflated, JPEG and encrypted data sit close to 8
+    return entropy > 7.5;
+}
+
+Inflater::Inflater() : inflating(false), done(false), output(nullptr), length(0), produced(0) {
+}
+
+Inflater::~Inflater() {
+    if (inflating)
+        inflateEnd(&stream);
+}
+
+bool Inflater::begin(std::uint8_t *out, std::size_t size) {
+    if (inflating)
+        inflateEnd(&stream);
+
+    std::memset(&stream, 0, sizeof(stream));
+    inflating = inflateInit2(&stream, -15) == Z_OK;
+
+    done     = false;
+    output   = out;
+    length   = size;
+    produced = 0;
+
+    return inflating;
+}
+
+// inflate() refuses a null output even when there is no room
+static std::uint8_t empty;
+
+bool Inflater::update(const std::uint8_t *data, std::size_t size) {
+    while (size) {
+        if (done)
+            return false;
+
+        std::size_t in  = std::min<std::size_t>(size, UINT_MAX);
+        std::size_t out = std::min<std::size_t>(length - produced, UINT_MAX);
+
+        stream.next_in   = const_cast<std::uint8_t*>(data);
+        stream.avail_in  = in;
+        stream.next_out  = output ? output + produced : &empty;
+        stream.avail_out = out;
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+
+        std::size_t used = in - stream.avail_in;
+        data     += used;
+        size     -= used;
+        produced += out - stream.avail_out;
+
+        if (result == Z_STREAM_END)
+            done = true;
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+            return false;
+        // No progress means the output is full while input is left
+        else if (!used && out == stream.avail_out)
+            return false;
+    }
+
+    return true;
+}
+
+bool Inflater::finish() {
+    // The end of the last block may still sit in the bit buffer when the
+    // output filled up exactly
+    if (inflating && !done) {
+        std::size_t out = std::min<std::size_t>(length - produced, UINT_MAX);
+
+        stream.next_in   = nullptr;
+        stream.avail_in  = 0;
+        stream.next_out  = output ? output + produced : &empty;
+        stream.avail_out = out;
+
+        done = inflate(&stream, Z_NO_FLUSH) == Z_STREAM_END;
+        produced += out - stream.avail_out;
+    }
+
+    return done && produced == length;
+}
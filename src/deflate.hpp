@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "zlib/zlib.h"
+
+// Appends data to out as one raw deflate stream. The data is split into chunks
+// that are compressed on all cores, each primed with the 32 KiB before it, and
+// joined with sync flushes. crc receives the CRC32 of the uncompressed data
+bool deflate_parallel(const std::uint8_t *data, std::size_t size, std::vector<std::uint8_t> &out, std::uint32_t &crc);
+
+// Entropy probe on the first blocks of data. True when it looks like it is already
+// compressed or encrypted (zip, jpg, ...), so deflating it would not pay off
+bool looks_compressed(const std::uint8_t *data, std::size_t size);
+
+// Inflates a raw deflate stream, fed piece by piece, into a fixed output buffer
+class Inflater
+{
+public:
+    Inflater();
+    ~Inflater();
+
+    Inflater(const Inflater &) = delete;
+    Inflater &operator=(const Inflater &) = delete;
+
+    bool begin(std::uint8_t *out, std::size_t size);
+    // Fails on corrupt data, or data that would not fit into the output
+    bool update(const std::uint8_t *data, std::size_t size);
+
+    // Once all data was fed: the final block was inflated and filled the output exactly
+    bool finish();
+    std::size_t size() const { return produced; }
+
+private:
+    z_stream stream;
+    bool inflating, done;
+
+    std::uint8_t *output;
+    std::size_t length, produced;
+};
@@ -0,0 +1,115 @@
+#include "distortion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+DistortionMeter::DistortionMeter(unsigned int width, unsigned int height, unsigned int channels, unsigned int depth)
+    : width(width), height(height), channels(channels), depth(depth),
+      squared(channels), ssim(channels), windows(channels), histogram(std::size_t(channels) << depth) {
+}
+
+void DistortionMeter::add_rows(std::size_t rows, const std::uint8_t *before, const std::uint8_t *after) {
+    if (depth == 8) {
+        add(rows, before, after);
+        return;
+    }
+
+    std::size_t count = rows * width * channels;
+    std::vector<std::uint16_t> a(count), b(count);
+    std::memcpy(b.data(), before, count * 2);
+    std::memcpy(a.data(), after, count * 2);
+    add(rows, b.data(), a.data());
+}
+
+template <typename T> void DistortionMeter::add(std::size_t rows, const T *before, const T *after) {
+    std::size_t row = std::size_t(width) * channels;
+    double peak = double((1u << depth) - 1);
+    double c1 = (0.01 * peak) * (0.01 * peak), c2 = (0.03 * peak) * (0.03 * peak);
+
+    // Squared error and histogram change. Plain loops over contiguous samples, which
+    // the compiler vectorises
+    for (std::size_t c = 0; c < channels; c++) {
+        std::int64_t *delta = histogram.data() + (c << depth);
+        double sum = 0;
+
+        for (std::size_t i = c; i < rows * row; i += channels) {
+            int d = int(after[i]) - int(before[i]);
+            sum += double(d * std::int64_t(d));
+            if (d) {
+                delta[before[i]]--;
+                delta[after[i]]++;
+            }
+        }
+
+        squared[c] += sum;
+    }
+
+    for (std::size_t y = 0; y < rows; y += window_size) {
+        std::size_t h = std::min(window_size, rows - y);
+
+        for (std::size_t x = 0; x < width; x += window_size) {
+            std::size_t w = std::min<std::size_t>(window_size, width - x);
+            double n = double(w * h);
+
+            for (std::size_t c = 0; c < channels; c++) {
+                double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+
+                for (std::size_t j = 0; j < h; j++) {
+                    const T *p = before + (y + j) * row + x * channels + c;
+                    const T *q = after  + (y + j) * row + x * channels + c;
+
+                    for (std::size_t i = 0; i < w; i++) {
+                        double u = p[i * channels], v = q[i * channels];
+                        sx  += u;
+                        sy  += v;
+                        sxx += u * u;
+                        syy += v * v;
+                        sxy += u * v;
+                    }
+                }
+
+                double mx = sx / n, my = sy / n;
+                double vx = sxx / n - mx * mx, vy = syy / n - my * my, cov = sxy / n - mx * my;
+
+                ssim[c] += (2 * mx * my + c1) * (2 * cov + c2) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+                windows[c]++;
+            }
+        }
+    }
+}
+
+void DistortionMeter::result(Distortion &out) const {
+    double peak  = double((1u << depth) - 1);
+    double total = double(width) * height;
+    std::uint64_t all_windows = std::uint64_t((width + window_size - 1) / window_size) *
+                                ((height + window_size - 1) / window_size);
+
+    auto psnr = [&](double mse) {
+        return mse > 0 ? 10 * std::log10(peak * peak / mse) : std::numeric_limits<double>::infinity();
+    };
+
+    out.channels.clear();
+    out.mse  = 0;
+    out.ssim = 0;
+
+    for (std::size_t c = 0; c < channels; c++) {
+        ChannelDistortion channel;
+        channel.mse  = total ? squared[c] / total : 0;
+        channel.psnr = psnr(channel.mse);
+        channel.ssim = all_windows ? (ssim[c] + double(all_windows - windows[c])) / all_windows : 1;
+
+        std::uint64_t moved = 0;
+        for (std::size_t v = 0; v < (std::size_t(1) << depth); v++)
+            moved += std::uint64_t(std::llabs(histogram[(c << depth) + v]));
+        channel.histogram_shift = moved / 2;
+
+        out.mse  += channel.mse / channels;
+        out.ssim += channel.ssim / channels;
+        out.channels.push_back(channel);
+    }
+
+    out.psnr = psnr(out.mse);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// How much an embed changed an image. SSIM uses 8x8 windows; windows the embed did
+// not reach count as identical, so the values cover the whole image
+struct ChannelDistortion {
+    double mse;
+    double psnr;                   // dB, infinite when nothing changed
+    double ssim;
+    std::uint64_t histogram_shift; // Samples that moved to another histogram bin
+};
+
+struct Distortion {
+    std::size_t samples = 0;       // Samples written by the embed
+    double mse  = 0;
+    double psnr = 0;
+    double ssim = 1;
+    std::vector<ChannelDistortion> channels;
+};
+
+// Accumulates the difference between the rows an embed touched before and after it.
+// Bands passed to add_rows() start on a multiple of window_size rows
+class DistortionMeter
+{
+public:
+    static constexpr std::size_t window_size = 8;
+
+    DistortionMeter(unsigned int width, unsigned int height, unsigned int channels, unsigned int depth);
+
+    // Samples of whole rows in logical and native byte order
+    void add_rows(std::size_t rows, const std::uint8_t *before, const std::uint8_t *after);
+    void result(Distortion &out) const;
+
+private:
+    template <typename T> void add(std::size_t rows, const T *before, const T *after);
+
+    unsigned int width, height, channels, depth;
+
+    std::vector<double> squared, ssim;   // Per channel
+    std::vector<std::uint64_t> windows;  // Windows measured per channel
+    std::vector<std::int64_t> histogram; // Change in the count of every value, per channel
+};
@@ -0,0 +1,202 @@
+#include "erasure.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+
+// Exponent and logarithm tables for the field polynomial x^8 + x^4 + x^3 + x^2 + 1
+struct Field {
+    std::uint8_t exp[512];
+    std::uint8_t log[256];
+
+    Field() {
+        unsigned int x = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = exp[i + 255] = std::uint8_t(x);
+            log[x] = std::uint8_t(i);
+            x <<= 1;
+            if (x & 0x100)
+                x ^= 0x11d;
+        }
+        exp[510] = exp[511] = exp[0];
+        log[0] = 0;
+    }
+
+    std::uint8_t mul(std::uint8_t a, std::uint8_t b) const {
+        return a && b ? exp[log[a] + log[b]] : 0;
+    }
+
+    // b must not be zero
+    std::uint8_t div(std::uint8_t a, std::uint8_t b) const {
+        return a ? exp[log[a] + 255 - log[b]] : 0;
+    }
+};
+
+static const Field &field() {
+    static const Field instance;
+    return instance;
+}
+
+// Products of a coefficient with every low nibble, then with every high nibble. pshufb
+// looks up 16 or 32 of them at once, the xor of both halves is the product of the byte
+static void split_tables(std::uint8_t c, std::uint8_t *table) {
+    auto &gf = field();
+    for (int x = 0; x < 16; x++) {
+        table[x]      = gf.mul(c, std::uint8_t(x));
+        table[16 + x] = gf.mul(c, std::uint8_t(x << 4));
+    }
+}
+
+static void combine_scalar(const std::uint8_t *tables, const std::uint8_t *const *blocks, std::size_t count,
+                           std::uint8_t *out, std::size_t from, std::size_t size) {
+    for (std::size_t i = from; i < size; i++) {
+        std::uint8_t value = 0;
+        for (std::size_t b = 0; b < count; b++) {
+            std::uint8_t s = blocks[b][i];
+            value ^= tables[b * 32 + (s & 0x0f)] ^ tables[b * 32 + 16 + (s >> 4)];
+        }
+        out[i] = value;
+    }
+}
+
+#ifdef SIMD_X86
+
+TARGET("ssse3") static std::size_t combine_ssse3(const std::uint8_t *tables, const std::uint8_t *const *blocks,
+                                                 std::size_t count, std::uint8_t *out, std::size_t size) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i value = _mm_setzero_si128();
+        for (std::size_t b = 0; b < count; b++) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tables + b * 32));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tables + b * 32 + 16));
+            __m128i s  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks[b] + i));
+
+            lo = _mm_shuffle_epi8(lo, _mm_and_si128(s, mask));
+            hi = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+            value = _mm_xor_si128(value, _mm_xor_si128(lo, hi));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), value);
+    }
+
+    return i;
+}
+
+TARGET("avx2") static std::size_t combine_avx2(const std::uint8_t *tables, const std::uint8_t *const *blocks,
+                                               std::size_t count, std::uint8_t *out, std::size_t size) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i value = _mm256_setzero_si256();
+        for (std::size_t b = 0; b < count; b++) {
+            __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tables + b * 32)));
+            __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tables + b * 32 + 16)));
+            __m256i s  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks[b] + i));
+
+            lo = _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask));
+            hi = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+            value = _mm256_xor_si256(value, _mm256_xor_si256(lo, hi));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), value);
+    }
+
+    return i;
+}
+
+#endif
+
+void gf_combine(const std::uint8_t *coefficients, const std::uint8_t *const *blocks, std::size_t count,
+                std::uint8_t *out, std::size_t size) {
+    std::vector<std::uint8_t> tables(count * 32);
+    for (std::size_t b = 0; b < count; b++)
+        split_tables(coefficients[b], tables.data() + b * 32);
+
+    std::size_t done = 0;
+#ifdef SIMD_X86
+    Isa isa = cpu_isa();
+    if (isa == Isa::AVX2)
+        done = combine_avx2(tables.data(), blocks, count, out, size);
+    else if (isa == Isa::SSSE3)
+        done = combine_ssse3(tables.data(), blocks, count, out, size);
+#endif
+
+    combine_scalar(tables.data(), blocks, count, out, done, size);
+}
+
+ErasureCode::ErasureCode(std::size_t data, std::size_t total) : k(data), n(total), parity_rows((total - data) * data) {
+    auto &gf = field();
+
+    // Row j, column i: 1 / (x_j + y_i) with x_j = data + j and y_i = i, all distinct
+    for (std::size_t j = 0; j < n - k; j++)
+        for (std::size_t i = 0; i < k; i++)
+            parity_rows[j * k + i] = gf.div(1, std::uint8_t((k + j) ^ i));
+}
+
+void ErasureCode::encode(const std::uint8_t *const *blocks, std::uint8_t *const *parity, std::size_t size) const {
+    for (std::size_t j = 0; j < n - k; j++)
+        gf_combine(parity_rows.data() + j * k, blocks, k, parity[j], size);
+}
+
+bool ErasureCode::solve(const std::vector<std::size_t> &present, std::vector<std::uint8_t> &inverse) const {
+    if (present.size() != k)
+        return false;
+
+    // Rows of the generator matrix for the blocks at hand, next to the identity
+    std::vector<std::uint8_t> rows(k * k, 0);
+    std::vector<char> seen(n, 0);
+    for (std::size_t r = 0; r < k; r++) {
+        std::size_t index = present[r];
+        if (index >= n || seen[index])
+            return false;
+        seen[index] = 1;
+
+        if (index < k)
+            rows[r * k + index] = 1;
+        else
+            std::copy_n(parity_rows.data() + (index - k) * k, k, rows.data() + r * k);
+    }
+
+    inverse.assign(k * k, 0);
+    for (std::size_t r = 0; r < k; r++)
+        inverse[r * k + r] = 1;
+
+    // Gauss-Jordan elimination; subtraction is xor in GF(2^8)
+    auto &gf = field();
+    for (std::size_t col = 0; col < k; col++) {
+        std::size_t pivot = col;
+        while (pivot < k && !rows[pivot * k + col])
+            pivot++;
+        if (pivot == k)
+            return false;
+
+        if (pivot != col) {
+            std::swap_ranges(rows.begin() + pivot * k, rows.begin() + (pivot + 1) * k, rows.begin() + col * k);
+            std::swap_ranges(inverse.begin() + pivot * k, inverse.begin() + (pivot + 1) * k, inverse.begin() + col * k);
+        }
+
+        std::uint8_t scale = gf.div(1, rows[col * k + col]);
+        for (std::size_t i = 0; i < k; i++) {
+            rows[col * k + i]    = gf.mul(rows[col * k + i], scale);
+            inverse[col * k + i] = gf.mul(inverse[col * k + i], scale);
+        }
+
+        for (std::size_t r = 0; r < k; r++) {
+            std::uint8_t factor = rows[r * k + col];
+            if (r == col || !factor)
+                continue;
+
+            for (std::size_t i = 0; i < k; i++) {
+                rows[r * k + i]    ^= gf.mul(factor, rows[col * k + i]);
+                inverse[r * k + i] ^= gf.mul(factor, inverse[col * k + i]);
+            }
+        }
+    }
+
+    return true;
+}
+
+void ErasureCode::rebuild(const std::vector<std::uint8_t> &inverse, std::size_t block, const std::uint8_t *const *blocks,
+                          std::uint8_t *out, std::size_t size) const {
+    gf_combine(inverse.data() + block * k, blocks, k, out, size);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Systematic Reed-Solomon erasure code over GF(2^8). The data blocks are stored as they
+// are and total - data parity blocks are added, so that any data of the total blocks
+// rebuild the others. The parity rows form a Cauchy matrix, every square submatrix of
+// which is invertible. Each byte only depends on the bytes at the same position in the
+// other blocks, so blocks can be coded in independent ranges
+class ErasureCode
+{
+public:
+    static const std::size_t max_blocks = 255;
+
+    // 1 <= data <= total <= max_blocks
+    ErasureCode(std::size_t data, std::size_t total);
+
+    std::size_t data() const { return k; }
+    std::size_t total() const { return n; }
+
+    // Fills the total - data parity blocks from the data blocks, size bytes each
+    void encode(const std::uint8_t *const *blocks, std::uint8_t *const *parity, std::size_t size) const;
+
+    // Inverts the rows of the data blocks given by index, in the order they are passed to
+    // rebuild(). False when there are not exactly data indices, or one repeats or is out of range
+    bool solve(const std::vector<std::size_t> &present, std::vector<std::uint8_t> &inverse) const;
+
+    // Rebuilds data block `block` from the blocks passed to solve()
+    void rebuild(const std::vector<std::uint8_t> &inverse, std::size_t block, const std::uint8_t *const *blocks,
+                 std::uint8_t *out, std::size_t size) const;
+
+private:
+    std::size_t k, n;
+    std::vector<std::uint8_t> parity_rows; // (total - data) x data
+};
+
+// out = sum of coefficients[i] * blocks[i] over GF(2^8), with pshufb split tables on
+// CPUs with SSSE3 or AVX2
+void gf_combine(const std::uint8_t *coefficients, const std::uint8_t *const *blocks, std::size_t count,
+                std::uint8_t *out, std::size_t size);
@@ -7,15 +7,8 @@
 #include <array>
 #include <filesystem>
 #include <windows.h>
-#include "sha256.hpp"
 #include "image.hpp"
-
-// Forward declarations of encode and decode from main.cpp
-int encode(Image &image, const std::array<std::uint8_t, 32> &password, const std::string &input, const std::string &output, Image::EncodingLevel level);
-int decode(Image &image, const std::array<std::uint8_t, 32> &password, std::string output);
-
-// Deklarasi fungsi yang menghasilkan hash kata sandi
-static std::array<std::uint8_t, 32> generate_password_hash(const std::string &password_str);
+#include "stego.hpp"
 
 // Deklarasi fungsi yang menampilkan dialog pemilihan file
 static void show_file_dialog(std::string &path, const char *dialog_title);
@@ -109,18 +102,25 @@ int run_gui() {
                     // Periksa apakah jalur input dan sematan tidak kosong
                     if (!encode_input_image_path.empty() && !encode_embed_file_path.empty()) {
                         std::filesystem::path input_path(encode_input_image_path);
+                        // Gambar tanpa kompresi (BMP/PPM/TGA/TIFF) dan QOI tetap memakai formatnya sendiri
+                        bool keep_format = Image::mappable(encode_input_image_path) || input_path.extension() == ".qoi";
                         // Buat jalur output untuk gambar yang disematkan
-                        std::string output_path_str = input_path.parent_path().string() + "/" + input_path.stem().string() + "_embedded.png";
+                        std::string output_path_str = input_path.parent_path().string() + "/" + input_path.stem().string() + "_embedded" +
+                                                      (keep_format ? input_path.extension().string() : ".png");
 
+                        // Gambar tanpa kompresi disalin di samping output lalu ditambal lewat mmap,
+                        // sehingga hanya halaman yang tersentuh yang ditulis ulang. Salinannya baru
+                        // menggantikan output setelah encode berhasil
                         Image image;
-                        // Muat gambar input
-                        if (!image.load(encode_input_image_path)) {
+                        std::string staging;
+                        bool loaded = open_cover(image, encode_input_image_path, output_path_str, staging);
+                        if (!loaded) {
                             encode_status = "Error: Gagal memuat gambar input.";
                         } else {
                             // Hasilkan hash kata sandi
-                            auto password_hash = generate_password_hash(std::string(encode_password));
+                            auto hash = password_hash(std::string(encode_password));
                             // Panggil fungsi encode
-                            int result = encode(image, password_hash, encode_embed_file_path, output_path_str, Image::EncodingLevel::Low);
+                            int result = encode(image, hash, encode_embed_file_path, output_path_str, Image::EncodingLevel::Low, staging);
                             // Atur status berdasarkan hasil encoding
                             encode_status = (result >= 0) ? "Berhasil!" : "Error: Encoding gagal.";
                         }
@@ -155,18 +155,15 @@ int run_gui() {
                         // Buat jalur output default untuk file yang didekode
                         std::string output_path_str = input_path.parent_path().string() + "/" + input_path.stem().string() + "_decoded.zip";
 
-                        Image image;
-                        // Muat gambar input
-                        if (!image.load(decode_input_image_path)) {
-                            decode_status = "Error: Gagal memuat gambar.";
-                        } else {
-                            // Hasilkan hash kata sandi
-                            auto password_hash = generate_password_hash(std::string(decode_password));
-                            // Panggil fungsi decode
-                            int result = decode(image, password_hash, output_path_str);
-                            // Atur status berdasarkan hasil decoding
-                            decode_status = (result >= 0) ? "Berhasil! Output disimpan ke " + output_path_str : "Error: Decoding gagal.";
-                        }
+                        // Hasilkan hash kata sandi
+                        auto hash = password_hash(std::string(decode_password));
+                        // Muat gambar dan dekode, PBKDF2 berjalan selama gambar dimuat
+                        DecodeRequest request;
+                        request.password = hash;
+                        request.output   = output_path_str;
+                        auto result = decode_file(decode_input_image_path, request);
+                        // Atur status berdasarkan hasil decoding
+                        decode_status = result ? "Berhasil! Output disimpan ke " + output_path_str : "Error: " + describe_error(result);
                     } else {
                         decode_status = "Error: Harap pilih gambar untuk didekode.";
                     }
@@ -216,17 +213,6 @@ int run_gui() {
     return 0;
 }
 
-// Fungsi untuk menghasilkan hash SHA256 dari string kata sandi
-static std::array<std::uint8_t, 32> generate_password_hash(const std::string &password_str) {
-    std::array<std::uint8_t, 32> hash{}; // Inisialisasi array hash
-    // Gunakan SHA256 untuk menghash string kata sandi
-    SHA256 sha; // Buat objek SHA256
-    sha.update(password_str.data(), password_str.size()); // Perbarui hash dengan data kata sandi
-    sha.finish(); // Selesaikan perhitungan hash
-    sha.get_hash(hash.data()); // Dapatkan hash yang dihasilkan
-    return hash; // Kembalikan hash
-}
-
 // Fungsi untuk menampilkan dialog pemilihan file (khusus Windows)
 static void show_file_dialog(std::string &path, const char *dialog_title) {
     OPENFILENAMEA ofn; // Struktur untuk parameter dialog file
@@ -1,39 +1,95 @@
 #include "image.hpp"
+#include "carrier.hpp"
+#include "distortion.hpp"
+#include "png_stream.hpp"
+#include "qoi.hpp"
+#include "stc.hpp"
+#include "texture.hpp"
+#include "thread_pool.hpp"
 #include "stb/stb_image.h"
-#include "stb/stb_image_write.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 
-Image::Image() : width(0), height(0) {
-}
+// Bits replaced per channel sample, indexed by EncodingLevel up to High. 16-bit samples
+// take roughly the same relative distortion as their 8-bit counterparts
+static const unsigned int level_bits_8 [3] = { 1, 2, 4 };
+static const unsigned int level_bits_16[3] = { 8, 10, 12 };
 
-bool Image::load(const std::string &path) {
-    int x, y, n = 4;
+// Level Adaptive: bits per sample of the texture classes, and the bits left out when
+// judging texture, at least as many as Low (Salt, IV and Header) and Adaptive replace
+static const unsigned int adapt_bits_8 [4] = { 0, 1, 2, 3 };
+static const unsigned int adapt_bits_16[4] = { 0, 9, 10, 11 };
+static const unsigned int adapt_shift_8  = 3;
+static const unsigned int adapt_shift_16 = 11;
+// Texture below which a block counts as flat whatever the quartiles, one step of the
+// remaining bits in every eighth sample (texture is scaled by 256)
+static const std::uint32_t adapt_flat = 32;
 
-    auto *buffer = stbi_load(path.c_str(), &x, &y, &n, n);
-    if (!buffer)
-        return false;
+// Split into whole groups and a remainder so that only a result which really
+// does not fit saturates
+static std::size_t bit_samples(std::size_t size, std::size_t bits) {
+    std::size_t rest = (size % bits * 8 + bits - 1) / bits;
 
-    image = std::make_unique<std::uint8_t[]>(x * y * 4);
-    std::copy_n(buffer, x * y * 4, image.get());
-    stbi_image_free(buffer);
+    if (size / bits > (SIZE_MAX - rest) / 8)
+        return SIZE_MAX;
+
+    return size / bits * 8 + rest;
+}
 
-    width  = x;
-    height = y;
+static std::uint16_t load16(const std::uint8_t *p, bool swapped = false) {
+    std::uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return swapped ? (v >> 8) | (v << 8) : v;
+}
 
-    return true;
+static void store16(std::uint8_t *p, std::uint16_t v, bool swapped = false) {
+    if (swapped)
+        v = (v >> 8) | (v << 8);
+    std::memcpy(p, &v, sizeof(v));
 }
 
-bool Image::save(const std::string &path) {
-    int result = stbi_write_png(path.c_str(), width, height, 4, image.get(), width * 4);
+static bool big_endian_host() {
+    const std::uint16_t probe = 1;
+    return *reinterpret_cast<const std::uint8_t*>(&probe) == 0;
+}
 
-    return result != 0;
+static std::string extension(const std::string &path) {
+    auto ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char ch) { return std::tolower(ch); });
+    return ext;
 }
 
-void Image::encode(const std::uint8_t *data, std::size_t size, EncodingLevel level, std::size_t offset) {
-    auto image = this->image.get() + offset;
+static bool write_file(const std::string &path, const std::uint8_t *data, std::size_t size) {
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
 
-    if (level == EncodingLevel::Low) {
+    file.write(reinterpret_cast<const char*>(data), size);
+    return file.good();
+}
+
+// Position inside the data being embedded or extracted, carried across runs
+struct BitReader {
+    const std::uint8_t *data;
+    std::size_t size, i;
+    std::uint32_t acc;
+    unsigned int have;
+};
+
+struct BitWriter {
+    std::uint8_t *data;
+    std::size_t size, i;
+    std::uint32_t acc;
+    unsigned int have;
+};
+
+// Unrolled kernels for whole bytes of data in 8-bit samples
+static void embed8(std::uint8_t *image, const std::uint8_t *data, std::size_t size, unsigned int bits) {
+    if (bits == 1) {
         for (auto i = 0; i < size; i++, image += 8) {
             image[0] = (image[0] & ~0b1) | ((data[i] >> 0) & 0b1);
             image[1] = (image[1] & ~0b1) | ((data[i] >> 1) & 0b1);
@@ -46,7 +102,7 @@ void Image::encode(const std::uint8_t *data, std::size_t size, EncodingLevel lev
         }
     }
 
-    else if (level == EncodingLevel::Med) {
+    else if (bits == 2) {
         for (auto i = 0; i < size; i++, image += 4) {
             image[0] = (image[0] & ~0b11) | ((data[i] >> 0) & 0b11);
             image[1] = (image[1] & ~0b11) | ((data[i] >> 2) & 0b11);
@@ -55,7 +111,7 @@ void Image::encode(const std::uint8_t *data, std::size_t size, EncodingLevel lev
         }
     }
 
-    // High
+    // 4 bits
     else {
         for (auto i = 0; i < size / 2; i++, image += 4, data += 2) {
             image[0] = (image[0] & ~0xf) | (data[0] & 0xf);
@@ -71,11 +127,8 @@ void Image::encode(const std::uint8_t *data, std::size_t size, EncodingLevel lev
     }
 }
 
-std::unique_ptr<std::uint8_t[]> Image::decode(std::size_t size, EncodingLevel level, std::size_t offset) {
-    auto data  = std::make_unique<std::uint8_t[]>(size);
-    auto image = this->image.get() + offset;
-
-    if (level == EncodingLevel::Low) {
+static void extract8(const std::uint8_t *image, std::uint8_t *data, std::size_t size, unsigned int bits) {
+    if (bits == 1) {
         for (auto i = 0; i < size; i++, image += 8) {
             data[i] = ((image[0] & 0b1) << 0) | ((image[1] & 0b1) << 1) |
                       ((image[2] & 0b1) << 2) | ((image[3] & 0b1) << 3) |
@@ -84,36 +137,1087 @@ std::unique_ptr<std::uint8_t[]> Image::decode(std::size_t size, EncodingLevel le
         }
     }
 
-    else if (level == EncodingLevel::Med) {
+    else if (bits == 2) {
         for (auto i = 0; i < size; i++, image += 4) {
             data[i] = ((image[0] & 0b11) << 0) | ((image[1] & 0b11) << 2) |
                       ((image[2] & 0b11) << 4) | ((image[3] & 0b11) << 6);
         }
     }
 
-    // High
+    // 4 bits
     else {
-        auto buffer = data.get();
-
-        for (auto i = 0; i < size / 2; i++, image += 4, buffer += 2) {
-            buffer[0] = (image[0] & 0xf) | (image[1] << 4);
-            buffer[1] = (image[2] & 0xf) | (image[3] << 4);
+        for (auto i = 0; i < size / 2; i++, image += 4, data += 2) {
+            data[0] = (image[0] & 0xf) | (image[1] << 4);
+            data[1] = (image[2] & 0xf) | (image[3] << 4);
         }
 
         if (size % 2)
-            *buffer = (image[0] & 0xf) | (image[1] << 4);
+            *data = (image[0] & 0xf) | (image[1] << 4);
+    }
+}
+
+// Stores the next count * bits bits of the reader into count consecutive samples
+static void embed_run(std::uint8_t *image, std::size_t count, unsigned int depth, bool swapped, unsigned int bits, BitReader &in) {
+    if (depth == 8 && in.have == 0) {
+        std::size_t bytes = std::min(count * bits / 8, in.size - in.i);
+
+        embed8(image, in.data + in.i, bytes, bits);
+        in.i  += bytes;
+        image += bytes * 8 / bits;
+        count -= bytes * 8 / bits;
+    }
+
+    auto mask = (1u << bits) - 1;
+
+    for (std::size_t s = 0; s < count; s++) {
+        while (in.have < bits && in.i < in.size) {
+            in.acc |= std::uint32_t(in.data[in.i++]) << in.have;
+            in.have += 8;
+        }
+
+        auto value = in.acc & mask;
+        in.acc >>= bits;
+        in.have = in.have > bits ? in.have - bits : 0;
+
+        if (depth == 8) {
+            image[s] = (image[s] & ~mask) | value;
+        } else {
+            auto sample = image + s * 2;
+            store16(sample, (load16(sample, swapped) & ~mask) | value, swapped);
+        }
+    }
+}
+
+static void extract_run(const std::uint8_t *image, std::size_t count, unsigned int depth, bool swapped, unsigned int bits, BitWriter &out) {
+    if (depth == 8 && out.have == 0) {
+        std::size_t bytes = std::min(count * bits / 8, out.size - out.i);
+
+        extract8(image, out.data + out.i, bytes, bits);
+        out.i += bytes;
+        image += bytes * 8 / bits;
+        count -= bytes * 8 / bits;
+    }
+
+    auto mask = (1u << bits) - 1;
+
+    for (std::size_t s = 0; s < count && out.i < out.size; s++) {
+        auto value = depth == 8 ? image[s] : load16(image + s * 2, swapped);
+
+        out.acc  |= (value & mask) << out.have;
+        out.have += bits;
+
+        for (; out.have >= 8 && out.i < out.size; out.have -= 8, out.acc >>= 8)
+            out.data[out.i++] = out.acc & 0xff;
+    }
+}
+
+Image::Image() : width(0), height(0), channels(0), bit_depth(0),
+                 pixels(nullptr), first_row(0), stride(0), swizzle(nullptr), swapped(false),
+                 dirty_begin(0), dirty_end(0), keeping(false), stc_cost(StcCost::Texture),
+                 adaptive_lock(std::make_unique<std::mutex>()),
+                 stream_threshold(default_stream_threshold), band_bytes(default_band_size) {
+}
+
+bool Image::load(const std::string &path) {
+    // Uncompressed carriers are mapped copy-on-write instead of being decoded
+    if (mappable(path) && open_carrier(path, MappedFile::Mode::Private))
+        return true;
+
+    if (qoi_signature(path)) {
+        if (!qoi_read(path, width, height, channels, image))
+            return false;
+
+        mapping.close();
+        source.clear();
+        pending.clear();
+        originals.clear();
+        adaptive.reset();
+
+        bit_depth = 8;
+        pixels    = image.get();
+        first_row = 0;
+        stride    = std::size_t(width) * channels;
+        swizzle   = nullptr;
+        swapped   = false;
+
+        return true;
+    }
+
+    // Large PNG images stay on disk
+    if (open_streamed(path))
+        return true;
+
+    int x, y, n;
+    bool wide = stbi_is_16_bit(path.c_str());
+
+    void *buffer = wide ? static_cast<void*>(stbi_load_16(path.c_str(), &x, &y, &n, 0))
+                        : static_cast<void*>(stbi_load(path.c_str(), &x, &y, &n, 0));
+    if (!buffer)
+        return false;
+
+    mapping.close();
+
+    width     = x;
+    height    = y;
+    channels  = n;
+    bit_depth = wide ? 16 : 8;
+
+    std::size_t size = samples() * (bit_depth / 8);
+    image = std::make_unique<std::uint8_t[]>(size);
+    std::copy_n(static_cast<std::uint8_t*>(buffer), size, image.get());
+    stbi_image_free(buffer);
+
+    source.clear();
+    pending.clear();
+    originals.clear();
+    adaptive.reset();
+
+    pixels    = image.get();
+    first_row = 0;
+    stride  = std::size_t(width) * channels * (bit_depth / 8);
+    swizzle = nullptr;
+    swapped = false;
+
+    return true;
+}
+
+bool Image::load_head(const std::string &path, std::size_t count) {
+    PngReader reader;
+    if (!reader.open(path))
+        return false;
+
+    std::size_t row_samples = std::size_t(reader.w()) * reader.c();
+    std::size_t rows = std::min<std::size_t>(reader.h(), (count + row_samples - 1) / row_samples);
+
+    auto head = std::make_unique<std::uint8_t[]>(rows * reader.row_size());
+    if (!reader.read_rows(head.get(), rows))
+        return false;
+
+    mapping.close();
+    source.clear();
+    pending.clear();
+    originals.clear();
+    adaptive.reset();
+    image = std::move(head);
+
+    width     = reader.w();
+    height    = rows;
+    channels  = reader.c();
+    bit_depth = reader.depth();
+
+    pixels    = image.get();
+    first_row = 0;
+    stride    = reader.row_size();
+    swizzle   = nullptr;
+    swapped   = false;
+
+    return true;
+}
+
+bool Image::save(const std::string &path) {
+    if (streamed())
+        return save_streamed(path);
+
+    if (mapping.data()) {
+        std::error_code ec;
+
+        if (mapping.mode() == MappedFile::Mode::Write && std::filesystem::equivalent(path, mapping.path(), ec))
+            return flush();
+
+        // Same container format, so the mapped file can be written out as is
+        if (extension(path) == extension(mapping.path()))
+            return write_file(path, mapping.data(), mapping.size());
+    }
+
+    std::size_t row = std::size_t(width) * channels * (bit_depth / 8);
+    bool packed = !swizzle && !swapped && stride == std::ptrdiff_t(row);
+
+    if (extension(path) == ".qoi") {
+        if (bit_depth != 8)
+            return false;
+        if (packed)
+            return qoi_write(path, width, height, channels, pixels);
+
+        auto buffer = std::make_unique<std::uint8_t[]>(samples());
+        pack_rows(0, height, buffer.get());
+
+        return qoi_write(path, width, height, channels, buffer.get());
+    }
+
+    PngWriter out;
+    if (!out.open(path, width, height, channels, bit_depth))
+        return false;
+
+    if (packed)
+        return out.write_rows(pixels, height) && out.finish();
+
+    auto buffer = std::make_unique<std::uint8_t[]>(row);
+    for (std::size_t y = 0; y < height; y++) {
+        pack_rows(y, 1, buffer.get());
+        if (!out.write_rows(buffer.get(), 1))
+            return false;
+    }
+
+    return out.finish();
+}
+
+bool Image::map(const std::string &path) {
+    return open_carrier(path, MappedFile::Mode::Write);
+}
+
+bool Image::mappable(const std::string &path) {
+    return carrier_extension(path);
+}
+
+bool Image::open_carrier(const std::string &path, MappedFile::Mode mode) {
+    CarrierLayout layout;
+
+    if (!mapping.open(path, mode) || !parse_carrier(mapping.data(), mapping.size(), layout)) {
+        mapping.close();
+        return false;
     }
 
+    image.reset();
+    source.clear();
+    pending.clear();
+    originals.clear();
+    adaptive.reset();
+
+    width     = layout.width;
+    height    = layout.height;
+    channels  = layout.channels;
+    bit_depth = layout.depth;
+
+    pixels    = mapping.data() + layout.offset;
+    first_row = 0;
+    stride    = layout.stride;
+    swizzle   = layout.swizzle;
+    swapped   = bit_depth == 16 && layout.big_endian != big_endian_host();
+
+    dirty_begin = mapping.size();
+    dirty_end   = 0;
+
+    return true;
+}
+
+bool Image::open_streamed(const std::string &path) {
+    PngReader reader;
+
+    if (!reader.open(path) || reader.h() <= stream_threshold / reader.row_size() ||
+        reader.h() > SIZE_MAX / reader.row_size())
+        return false;
+
+    mapping.close();
+    image.reset();
+    pending.clear();
+    originals.clear();
+    adaptive.reset();
+    source = path;
+
+    width     = reader.w();
+    height    = reader.h();
+    channels  = reader.c();
+    bit_depth = reader.depth();
+
+    // Only set while a band is held in memory
+    pixels    = nullptr;
+    first_row = 0;
+    stride    = reader.row_size();
+    swizzle   = nullptr;
+    swapped   = false;
+
+    return true;
+}
+
+bool Image::flush() {
+    if (dirty_begin >= dirty_end)
+        return true;
+
+    bool result = mapping.flush(dirty_begin, dirty_end - dirty_begin);
+
+    dirty_begin = mapping.size();
+    dirty_end   = 0;
+
+    return result;
+}
+
+template <typename F> void Image::for_each_run(std::size_t offset, std::size_t count, F &&f) const {
+    std::size_t bytes = bit_depth / 8;
+    std::size_t row   = std::size_t(width) * channels;
+
+    // Rows follow each other without gaps
+    if (!swizzle && stride == std::ptrdiff_t(row * bytes)) {
+        f(pixels + (offset - first_row * row) * bytes, count);
+        return;
+    }
+
+    while (count) {
+        std::size_t y = offset / row, x = offset % row;
+        std::size_t n = std::min(count, row - x);
+        auto line = pixels + std::ptrdiff_t(y - first_row) * stride;
+
+        if (!swizzle)
+            f(line + x * bytes, n);
+        else
+            for (std::size_t i = x; i < x + n; i++)
+                f(line + (i - i % channels + swizzle[i % channels]) * bytes, 1);
+
+        offset += n;
+        count  -= n;
+    }
+}
+
+void Image::pack_rows(std::size_t y, std::size_t rows, std::uint8_t *out) const {
+    std::size_t bytes = bit_depth / 8;
+    std::size_t row   = std::size_t(width) * channels;
+
+    for_each_run(y * row, rows * row, [&](const std::uint8_t *run, std::size_t n) {
+        if (bytes == 1)
+            out = std::copy_n(run, n, out);
+        else
+            for (std::size_t i = 0; i < n; i++, out += 2)
+                store16(out, load16(run + i * 2, swapped));
+    });
+}
+
+template <typename F> bool Image::for_each_band(PngWriter *out, std::size_t end, F &&f) {
+    PngReader reader;
+
+    if (!reader.open(source) || reader.w() != width || reader.h() != height ||
+        reader.c() != channels || reader.depth() != bit_depth)
+        return false;
+
+    std::size_t row  = std::size_t(width) * channels;
+    std::size_t rows = std::clamp<std::size_t>(band_bytes / reader.row_size(), 1, height);
+    auto band = std::make_unique<std::uint8_t[]>(rows * reader.row_size());
+    bool result = true;
+
+    pixels = band.get();
+
+    for (std::size_t y = 0; y < height && result; y += rows) {
+        std::size_t n = std::min<std::size_t>(rows, height - y);
+
+        if (!out && y * row >= end)
+            break;
+
+        first_row = y;
+        result = reader.read_rows(band.get(), n);
+
+        if (result) {
+            f(y * row, (y + n) * row);
+            if (out)
+                result = out->write_rows(band.get(), n);
+        }
+    }
+
+    pixels    = nullptr;
+    first_row = 0;
+
+    return result;
+}
+
+bool Image::save_streamed(const std::string &path) {
+    // QOI output would need the whole image at once
+    if (extension(path) == ".qoi")
+        return false;
+
+    // The source is still being read while the result is written
+    std::error_code ec;
+    bool replace = std::filesystem::equivalent(path, source, ec);
+    auto target  = replace ? path + ".tmp" : path;
+
+    std::vector<BitReader> readers;
+    for (auto &p : pending)
+        readers.push_back({ p.data.data(), p.data.size(), 0, 0, 0 });
+
+    PngWriter out;
+    bool result = out.open(target, width, height, channels, bit_depth) &&
+                  for_each_band(&out, samples(), [&](std::size_t begin, std::size_t end) {
+        // Later writes overwrite earlier ones, as they would in memory
+        for (std::size_t i = 0; i < pending.size(); i++) {
+            auto &p = pending[i];
+            auto first = std::max(begin, p.offset);
+            auto last  = std::min(end, p.offset + (p.data.size() * 8 + p.bits - 1) / p.bits);
+
+            if (first < last) {
+                for_each_run(first, last - first, [&](std::uint8_t *run, std::size_t n) {
+                    embed_run(run, n, bit_depth, swapped, p.bits, readers[i]);
+                });
+            }
+        }
+    }) && out.finish();
+
+    if (replace) {
+        if (result)
+            std::filesystem::rename(target, path, ec);
+        else
+            std::filesystem::remove(target, ec);
+
+        result = result && !ec;
+    }
+
+    return result;
+}
+
+bool Image::contains(std::size_t offset, std::size_t count) const {
+    return offset <= samples() && count <= samples() - offset;
+}
+
+bool Image::encode(const std::uint8_t *data, std::size_t size, EncodingLevel level, std::size_t offset) {
+    if (level == EncodingLevel::Adaptive)
+        return encode_adaptive(data, size, offset);
+
+    auto bits  = bits_per_sample(level);
+    auto count = encoded_size(size, level);
+
+    if (!contains(offset, count))
+        return false;
+
+    if (streamed()) {
+        // A trellis needs the cover bits before it can pick the stego bits
+        if (level == EncodingLevel::Stc)
+            return false;
+
+        pending.push_back({ std::vector<std::uint8_t>(data, data + size), bits, offset });
+        return true;
+    }
+
+    if (keeping)
+        keep_original(offset, count);
+
+    if (level == EncodingLevel::Stc) {
+        encode_stc(data, size, offset);
+        return true;
+    }
+
+    BitReader in = { data, size, 0, 0, 0 };
+
+    for_each_run(offset, count, [&](std::uint8_t *run, std::size_t n) {
+        embed_run(run, n, bit_depth, swapped, bits, in);
+        touch(run, n);
+    });
+
+    return true;
+}
+
+void Image::keep_original(std::size_t offset, std::size_t count) {
+    Original original = { offset, std::vector<std::uint8_t>(count * (bit_depth / 8)) };
+    auto out = original.samples.data();
+
+    for_each_run(offset, count, [&](const std::uint8_t *run, std::size_t n) {
+        if (bit_depth == 8)
+            out = std::copy_n(run, n, out);
+        else
+            for (std::size_t i = 0; i < n; i++, out += 2)
+                store16(out, load16(run + i * 2, swapped));
+    });
+
+    originals.push_back(std::move(original));
+}
+
+// Remember which part of a mapped file has to be written back
+void Image::touch(const std::uint8_t *run, std::size_t n) {
+    if (mapping.data()) {
+        std::size_t at = run - mapping.data();
+        dirty_begin = std::min(dirty_begin, at);
+        dirty_end   = std::max(dirty_end, at + n * (bit_depth / 8));
+    }
+}
+
+// Blocks are coded on all cores, a batch at a time. Every block reads its cover bits and
+// costs, which may reach into the neighbouring blocks, and the stego bits of the batch
+// are only written once all of them are done
+void Image::encode_stc(const std::uint8_t *data, std::size_t size, std::size_t offset) {
+    const std::size_t batch = 256;
+    const std::size_t plane = stc_block * stc_width;
+    std::size_t blocks = (size + stc_block - 1) / stc_block;
+    std::vector<std::uint8_t> stego(std::min(blocks, batch) * plane);
+
+    for (std::size_t first = 0; first < blocks; first += batch) {
+        std::size_t n = std::min(batch, blocks - first);
+        auto place = [&](std::size_t i, std::size_t &bytes, std::size_t &start) {
+            std::size_t at = (first + i) * stc_block;
+            bytes = std::min(stc_block, size - at);
+            start = offset + at * 8 * stc_width;
+        };
+
+        parallel_for(n, [&](std::size_t i) {
+            std::size_t bytes, start;
+            place(i, bytes, start);
+
+            std::vector<std::uint8_t> cover(bytes * stc_width);
+            BitWriter out = { cover.data(), cover.size(), 0, 0, 0 };
+            for_each_run(start, cover.size() * 8, [&](const std::uint8_t *run, std::size_t c) {
+                extract_run(run, c, bit_depth, swapped, 1, out);
+            });
+
+            std::vector<float> costs;
+            if (stc_cost == StcCost::Texture) {
+                costs.resize(cover.size() * 8);
+                texture_costs(start, costs.size(), costs.data());
+            }
+
+            stc_embed(cover.data(), costs.empty() ? nullptr : costs.data(), data + (first + i) * stc_block, bytes,
+                      stego.data() + i * plane);
+        });
+
+        for (std::size_t i = 0; i < n; i++) {
+            std::size_t bytes, start;
+            place(i, bytes, start);
+
+            BitReader in = { stego.data() + i * plane, bytes * stc_width, 0, 0, 0 };
+            for_each_run(start, bytes * stc_width * 8, [&](std::uint8_t *run, std::size_t c) {
+                embed_run(run, c, bit_depth, swapped, 1, in);
+                touch(run, c);
+            });
+        }
+    }
+}
+
+// 1 / (1 + d), d the mean absolute difference to the horizontal and vertical neighbours
+// in the same channel on an 8-bit scale. The lowest bits are left out, so the costs do
+// not change while the block is being coded
+void Image::texture_costs(std::size_t offset, std::size_t count, float *costs) const {
+    std::size_t row = std::size_t(width) * channels, total = samples();
+
+    auto gather = [&](std::size_t from, std::size_t to, std::vector<int> &out) {
+        out.resize(to > from ? to - from : 0);
+        auto p = out.data();
+        for_each_run(from, out.size(), [&](const std::uint8_t *run, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++)
+                *p++ = (bit_depth == 8 ? run[i] : load16(run + i * 2, swapped)) >> 1;
+        });
+    };
+
+    // The samples with a pixel on either side, and the samples a row above and below
+    std::size_t mid  = offset - std::min<std::size_t>(offset, channels);
+    std::size_t up   = offset - std::min(offset, row);
+    std::size_t down = std::min(total, offset + row);
+    std::vector<int> middle, above, below;
+    gather(mid, std::min<std::size_t>(total, offset + count + channels), middle);
+    gather(up, offset + count > row ? offset + count - row : 0, above);
+    gather(down, std::min(total, offset + count + row), below);
+
+    float scale = bit_depth == 8 ? 2.0f : 2.0f / 256;
+    std::size_t y = offset / row, x = offset % row;
+    for (std::size_t i = 0; i < count; i++) {
+        std::size_t index = offset + i;
+        int value = middle[index - mid];
+        int sum = 0, n = 0;
+        auto add = [&](int other) {
+            sum += std::abs(other - value);
+            n++;
+        };
+
+        if (x >= channels)
+            add(middle[index - channels - mid]);
+        if (x + channels < row)
+            add(middle[index + channels - mid]);
+        if (y > 0)
+            add(above[index - row - up]);
+        if (y + 1 < height)
+            add(below[index + row - down]);
+
+        costs[i] = n ? 1.0f / (1.0f + sum * scale / n) : 1.0f;
+
+        if (++x == row) {
+            x = 0;
+            y++;
+        }
+    }
+}
+
+void Image::keep_originals(bool keep) {
+    keeping = keep;
+    originals.clear();
+}
+
+bool Image::distortion(Distortion &result) const {
+    if (streamed())
+        return false;
+
+    std::size_t row    = std::size_t(width) * channels;
+    std::size_t bytes  = bit_depth / 8;
+    std::size_t window = DistortionMeter::window_size;
+    std::size_t bands  = (height + window - 1) / window;
+
+    // Bands of window rows holding touched samples
+    std::vector<bool> touched(bands);
+    result.samples = 0;
+    for (auto &original : originals) {
+        std::size_t count = original.samples.size() / bytes;
+        if (!count)
+            continue;
+
+        for (std::size_t b = original.offset / row / window; b <= (original.offset + count - 1) / row / window; b++)
+            touched[b] = true;
+        result.samples += count;
+    }
+
+    DistortionMeter meter(width, height, channels, bit_depth);
+    std::vector<std::uint8_t> before(window * row * bytes), after(window * row * bytes);
+
+    for (std::size_t b = 0; b < bands; b++) {
+        if (!touched[b])
+            continue;
+
+        std::size_t y    = b * window;
+        std::size_t rows = std::min<std::size_t>(window, height - y);
+        std::size_t begin = y * row, end = (y + rows) * row;
+
+        pack_rows(y, rows, after.data());
+        std::copy_n(after.data(), rows * row * bytes, before.data());
+
+        // The oldest copy of a sample is its original value, so it is applied last
+        for (auto original = originals.rbegin(); original != originals.rend(); ++original) {
+            std::size_t first = std::max(begin, original->offset);
+            std::size_t last  = std::min(end, original->offset + original->samples.size() / bytes);
+
+            if (first < last)
+                std::copy_n(original->samples.data() + (first - original->offset) * bytes, (last - first) * bytes,
+                            before.data() + (first - begin) * bytes);
+        }
+
+        meter.add_rows(rows, before.data(), after.data());
+    }
+
+    meter.result(result);
+    return true;
+}
+
+bool Image::read_rows(std::size_t band_rows, const std::function<void(std::size_t, std::size_t, const std::uint8_t *)> &f) {
+    std::size_t row = std::size_t(width) * channels;
+
+    band_rows = std::clamp<std::size_t>(band_rows, 1, std::max(height, 1u));
+    auto band = std::make_unique<std::uint8_t[]>(band_rows * row * (bit_depth / 8));
+
+    auto split = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; y += band_rows) {
+            std::size_t n = std::min(band_rows, end - y);
+            pack_rows(y, n, band.get());
+            f(y, n, band.get());
+        }
+    };
+
+    if (!streamed()) {
+        split(0, height);
+        return true;
+    }
+
+    return for_each_band(nullptr, samples(), [&](std::size_t begin, std::size_t end) {
+        split(begin / row, end / row);
+    });
+}
+
+// Syndromes of the blocks in a plane of size * stc_width bytes
+static void extract_blocks(const std::uint8_t *plane, std::size_t size, std::uint8_t *data) {
+    for (std::size_t at = 0; at < size; at += Image::stc_block)
+        stc_extract(plane + at * stc_width, std::min(Image::stc_block, size - at), data + at);
+}
+
+std::unique_ptr<std::uint8_t[]> Image::decode(std::size_t size, EncodingLevel level, std::size_t offset) {
+    if (level == EncodingLevel::Adaptive) {
+        auto data = std::make_unique<std::uint8_t[]>(size);
+        auto done = [](const std::uint8_t *, std::size_t) { return true; };
+        return decode_adaptive(size, offset, data.get(), std::max<std::size_t>(size, 1), done) ? std::move(data) : nullptr;
+    }
+
+    if (level != EncodingLevel::Stc)
+        return decode_bits(size, bits_per_sample(level), offset);
+
+    if (size > SIZE_MAX / stc_width)
+        return nullptr;
+
+    auto plane = decode_bits(size * stc_width, 1, offset);
+    if (!plane)
+        return nullptr;
+
+    auto data = std::make_unique<std::uint8_t[]>(size);
+    extract_blocks(plane.get(), size, data.get());
+    return data;
+}
+
+bool Image::decode(std::size_t size, EncodingLevel level, std::size_t offset, std::size_t tile_size,
+                   const std::function<bool(const std::uint8_t *, std::size_t)> &sink) {
+    if (level == EncodingLevel::Adaptive) {
+        if (!tile_size)
+            return false;
+
+        auto tile = std::make_unique<std::uint8_t[]>(std::min(tile_size, size));
+        return decode_adaptive(size, offset, tile.get(), tile_size, sink);
+    }
+
+    if (level != EncodingLevel::Stc)
+        return decode_bits(size, bits_per_sample(level), offset, tile_size, sink);
+
+    if (!tile_size || tile_size % stc_block || size > SIZE_MAX / stc_width || tile_size > SIZE_MAX / stc_width)
+        return false;
+
+    auto tile = std::make_unique<std::uint8_t[]>(std::min(tile_size, size));
+    return decode_bits(size * stc_width, 1, offset, tile_size * stc_width, [&](const std::uint8_t *plane, std::size_t n) {
+        extract_blocks(plane, n / stc_width, tile.get());
+        return sink(tile.get(), n / stc_width);
+    });
+}
+
+std::unique_ptr<std::uint8_t[]> Image::decode_bits(std::size_t size, unsigned int bits, std::size_t offset) {
+    auto count = bit_samples(size, bits);
+
+    if (!contains(offset, count))
+        return nullptr;
+
+    auto data = std::make_unique<std::uint8_t[]>(size);
+    BitWriter out = { data.get(), size, 0, 0, 0 };
+
+    auto extract = [&](const std::uint8_t *run, std::size_t n) {
+        extract_run(run, n, bit_depth, swapped, bits, out);
+    };
+
+    if (!streamed()) {
+        for_each_run(offset, count, extract);
+        return data;
+    }
+
+    // Only the bands up to the last sample needed are read
+    for_each_band(nullptr, offset + count, [&](std::size_t begin, std::size_t end) {
+        auto first = std::max(begin, offset);
+        auto last  = std::min(end, offset + count);
+
+        if (first < last)
+            for_each_run(first, last - first, extract);
+    });
+
     return data;
 }
 
-std::size_t Image::encoded_size(std::size_t size, EncodingLevel level) {
-    if (level == EncodingLevel::Low)
-        return size * 8;
+bool Image::decode_bits(std::size_t size, unsigned int bits, std::size_t offset, std::size_t tile_size,
+                        const std::function<bool(const std::uint8_t *, std::size_t)> &sink) {
+    auto count = bit_samples(size, bits);
+
+    if (!contains(offset, count) || !tile_size)
+        return false;
+
+    auto tile = std::make_unique<std::uint8_t[]>(std::min(tile_size, size));
+    BitWriter out = { tile.get(), std::min(tile_size, size), 0, 0, 0 };
+    std::size_t done = 0;
+    bool result = true;
+
+    // Extracts the samples [first, first + n), handing over every tile they complete
+    auto extract = [&](std::size_t first, std::size_t n) {
+        while (n && result) {
+            std::size_t tile_end = offset + bit_samples(done + out.size, bits);
+            std::size_t k = std::min(n, tile_end - first);
+
+            for_each_run(first, k, [&](const std::uint8_t *run, std::size_t c) {
+                extract_run(run, c, bit_depth, swapped, bits, out);
+            });
+
+            first += k;
+            n     -= k;
+
+            if (first == tile_end) {
+                result   = sink(tile.get(), out.size);
+                done    += out.size;
+                out.i    = 0;
+                out.size = std::min(tile_size, size - done);
+            }
+        }
+    };
+
+    if (!streamed()) {
+        extract(offset, count);
+        return result;
+    }
+
+    bool read = for_each_band(nullptr, offset + count, [&](std::size_t begin, std::size_t end) {
+        auto first = std::max(begin, offset);
+        auto last  = std::min(end, offset + count);
+
+        if (first < last)
+            extract(first, last - first);
+    });
+
+    return read && result;
+}
+
+// Texture of a block is the mean absolute difference of its samples to their left and
+// upper neighbour in the same channel, without the bits Low and Adaptive replace. Every
+// block row is read once, in parallel with the others. The quartiles of the texture split
+// the blocks into classes, the flattest quarter (and any flat block) taking no bits and
+// the most textured quarter the most
+std::unique_ptr<Image::AdaptiveMap> Image::measure_blocks() const {
+    std::size_t row     = std::size_t(width) * channels;
+    std::size_t bytes   = bit_depth / 8;
+    std::size_t columns = (width + adapt_block - 1) / adapt_block;
+    std::size_t bands   = (height + adapt_block - 1) / adapt_block;
+    std::size_t block   = adapt_block * channels;
+    unsigned int shift  = bit_depth == 16 ? adapt_shift_16 : adapt_shift_8;
+
+    std::vector<std::uint32_t> texture(columns * bands);
+
+    parallel_for(bands, [&](std::size_t b) {
+        std::size_t y    = b * adapt_block;
+        std::size_t rows = std::min<std::size_t>(adapt_block, height - y);
+        std::size_t top  = y ? y - 1 : 0;
+        std::size_t read = y + rows - top;
+
+        std::vector<std::uint8_t> packed(read * row * bytes), masked(read * row), left(row);
+        pack_rows(top, read, packed.data());
+        for (std::size_t i = 0; i < read * row; i++)
+            masked[i] = (bytes == 1 ? packed[i] : load16(packed.data() + i * 2)) >> shift;
+
+        // Groups of eight samples, block holds channels of them
+        std::vector<std::uint32_t> groups((row + 7) / 8);
+        for (std::size_t r = y - top; r < read; r++) {
+            auto line = masked.data() + r * row;
+            std::copy_n(line, std::min<std::size_t>(channels, row), left.data());
+            std::copy_n(line, row - std::min<std::size_t>(channels, row), left.data() + channels);
+            gradient_sums(line, left.data(), r ? line - row : line, row, groups.data());
+        }
+
+        for (std::size_t x = 0; x < columns; x++) {
+            std::size_t first = x * channels, last = std::min(groups.size(), first + channels);
+            std::uint64_t sum = 0;
+            for (std::size_t g = first; g < last; g++)
+                sum += groups[g];
+
+            std::size_t count = rows * std::min(block, row - x * block);
+            texture[b * columns + x] = std::uint32_t(sum * 256 / count);
+        }
+    });
+
+    auto map = std::make_unique<AdaptiveMap>();
+    const unsigned int *classes = bit_depth == 16 ? adapt_bits_16 : adapt_bits_8;
+
+    std::uint32_t quartiles[3] = {};
+    std::vector<std::uint32_t> sorted(texture);
+    for (std::size_t q = 0; q < 3 && !sorted.empty(); q++) {
+        auto at = sorted.begin() + sorted.size() * (q + 1) / 4;
+        std::nth_element(sorted.begin(), at, sorted.end());
+        quartiles[q] = *at;
+    }
+
+    map->bits.resize(texture.size());
+    for (std::size_t i = 0; i < texture.size(); i++) {
+        std::uint32_t t = texture[i];
+        map->bits[i] = std::uint8_t(t < adapt_flat ? 0 : classes[(t > quartiles[0]) + (t > quartiles[1]) + (t > quartiles[2])]);
+    }
+
+    map->rows.resize(std::size_t(height) + 1);
+    for (std::size_t y = 0; y < height; y++) {
+        std::uint64_t slots = 0;
+        for (std::size_t x = 0; x < columns; x++)
+            slots += map->bits[y / adapt_block * columns + x] * std::min(block, row - x * block);
+        map->rows[y + 1] = map->rows[y] + slots;
+    }
+
+    return map;
+}
+
+const Image::AdaptiveMap &Image::adaptive_map() const {
+    std::lock_guard<std::mutex> lock(*adaptive_lock);
+
+    if (!adaptive)
+        adaptive = measure_blocks();
+    return *adaptive;
+}
+
+template <typename F> void Image::for_each_slot(std::size_t offset, std::size_t count, F &&f) const {
+    const auto &map     = adaptive_map();
+    std::size_t row     = std::size_t(width) * channels;
+    std::size_t bytes   = bit_depth / 8;
+    std::size_t columns = (width + adapt_block - 1) / adapt_block;
+    std::size_t block   = adapt_block * channels;
+
+    std::size_t y  = std::upper_bound(map.rows.begin(), map.rows.end(), offset) - map.rows.begin() - 1;
+    std::uint64_t at = map.rows[y];
+
+    for (; count; y++) {
+        auto bits = map.bits.data() + y / adapt_block * columns;
+
+        for (std::size_t x = 0; x < row && count; x += block) {
+            unsigned int b = bits[x / block];
+            std::size_t n = std::min(block, row - x);
+
+            at += b * n;
+            if (offset >= at)
+                continue;
+
+            // The first slot may lie in the middle of a sample
+            std::size_t skip = offset - (at - b * n);
+            unsigned int lo = skip % b;
+
+            for_each_run(y * row + x + skip / b, n - skip / b, [&](std::uint8_t *run, std::size_t c) {
+                for (std::size_t i = 0; i < c && count; i++) {
+                    unsigned int hi = unsigned(std::min<std::size_t>(b, lo + count));
+                    f(run + i * bytes, lo, hi);
+
+                    offset += hi - lo;
+                    count  -= hi - lo;
+                    lo = 0;
+                }
+            });
+        }
+    }
+}
+
+// Sample holding a slot before the end of the image
+std::size_t Image::slot_sample(std::size_t slot) const {
+    const auto &map     = adaptive_map();
+    std::size_t row     = std::size_t(width) * channels;
+    std::size_t columns = (width + adapt_block - 1) / adapt_block;
+    std::size_t block   = adapt_block * channels;
+
+    std::size_t y  = std::upper_bound(map.rows.begin(), map.rows.end(), slot) - map.rows.begin() - 1;
+    std::uint64_t at = map.rows[y];
+
+    for (std::size_t x = 0; x < row; x += block) {
+        unsigned int b = map.bits[y / adapt_block * columns + x / block];
+        std::size_t n = std::min(block, row - x);
+
+        if (slot < at + b * n)
+            return y * row + x + (slot - at) / b;
+        at += b * n;
+    }
+
+    return samples();
+}
+
+bool Image::encode_adaptive(const std::uint8_t *data, std::size_t size, std::size_t offset) {
+    auto count = encoded_size(size, EncodingLevel::Adaptive);
+    auto total = units(EncodingLevel::Adaptive);
+
+    // The blocks are only known once the whole cover has been read
+    if (streamed() || offset > total || count > total - offset)
+        return false;
+    if (!count)
+        return true;
+
+    if (keeping) {
+        std::size_t first = slot_sample(offset);
+        keep_original(first, slot_sample(offset + count - 1) + 1 - first);
+    }
+
+    BitReader in = { data, size, 0, 0, 0 };
+
+    for_each_slot(offset, count, [&](std::uint8_t *sample, unsigned int lo, unsigned int hi) {
+        unsigned int bits = hi - lo;
+        while (in.have < bits && in.i < in.size) {
+            in.acc |= std::uint32_t(in.data[in.i++]) << in.have;
+            in.have += 8;
+        }
+
+        auto value = in.acc & ((1u << bits) - 1);
+        in.acc >>= bits;
+        in.have = in.have > bits ? in.have - bits : 0;
+
+        auto mask = ((1u << bits) - 1) << lo;
+        if (bit_depth == 8)
+            *sample = std::uint8_t((*sample & ~mask) | (value << lo));
+        else
+            store16(sample, std::uint16_t((load16(sample, swapped) & ~mask) | (value << lo)), swapped);
+        touch(sample, 1);
+    });
+
+    return true;
+}
+
+// Hands every tile_size bytes to sink as soon as they are complete, like decode_bits()
+bool Image::decode_adaptive(std::size_t size, std::size_t offset, std::uint8_t *tile, std::size_t tile_size,
+                            const std::function<bool(const std::uint8_t *, std::size_t)> &sink) const {
+    auto count = encoded_size(size, EncodingLevel::Adaptive);
+    auto total = units(EncodingLevel::Adaptive);
+
+    if (streamed() || offset > total || count > total - offset)
+        return false;
+
+    BitWriter out = { tile, std::min(tile_size, size), 0, 0, 0 };
+    std::size_t done = 0;
+    bool result = true;
+
+    for_each_slot(offset, count, [&](const std::uint8_t *sample, unsigned int lo, unsigned int hi) {
+        if (!result)
+            return;
+
+        unsigned int bits = hi - lo;
+        std::uint32_t value = (bit_depth == 8 ? *sample : load16(sample, swapped)) >> lo;
+
+        out.acc  |= (value & ((1u << bits) - 1)) << out.have;
+        out.have += bits;
+
+        for (; out.have >= 8 && result; out.have -= 8, out.acc >>= 8) {
+            out.data[out.i++] = out.acc & 0xff;
+
+            if (out.i == out.size) {
+                result   = sink(tile, out.size);
+                done    += out.size;
+                out.i    = 0;
+                out.size = std::min(tile_size, size - done);
+            }
+        }
+    });
+
+    return result;
+}
+
+unsigned int Image::bits_per_sample(EncodingLevel level) const {
+    if (level == EncodingLevel::Stc)
+        return 1;
+    if (level == EncodingLevel::Adaptive)
+        return bit_depth == 16 ? adapt_bits_16[3] : adapt_bits_8[3];
+
+    auto index = static_cast<int>(level);
+
+    return bit_depth == 16 ? level_bits_16[index] : level_bits_8[index];
+}
+
+std::size_t Image::encoded_size(std::size_t size, EncodingLevel level) const {
+    if (level == EncodingLevel::Stc)
+        return size > SIZE_MAX / (8 * stc_width) ? SIZE_MAX : size * 8 * stc_width;
+    if (level == EncodingLevel::Adaptive)
+        return size > SIZE_MAX / 8 ? SIZE_MAX : size * 8;
+
+    return bit_samples(size, bits_per_sample(level));
+}
+
+std::size_t Image::decoded_size(std::size_t samples, EncodingLevel level) const {
+    if (level == EncodingLevel::Stc)
+        return samples / (8 * stc_width);
+    if (level == EncodingLevel::Adaptive)
+        return samples / 8;
+
+    std::size_t bits = bits_per_sample(level);
+
+    return samples / 8 * bits + samples % 8 * bits / 8;
+}
+
+std::size_t Image::units(EncodingLevel level) const {
+    if (level != EncodingLevel::Adaptive)
+        return samples();
+
+    return streamed() ? 0 : adaptive_map().rows.back();
+}
+
+std::size_t Image::unit_at(std::size_t sample, EncodingLevel level) const {
+    if (level != EncodingLevel::Adaptive)
+        return sample;
+    if (streamed())
+        return 0;
+
+    const auto &map     = adaptive_map();
+    std::size_t row     = std::size_t(width) * channels;
+    std::size_t columns = (width + adapt_block - 1) / adapt_block;
+    std::size_t block   = adapt_block * channels;
+
+    if (!row || sample >= samples())
+        return map.rows.back();
+
+    std::size_t y = sample / row, x = sample % row;
+    std::uint64_t at = map.rows[y];
+    auto bits = map.bits.data() + y / adapt_block * columns;
 
-    else if (level == EncodingLevel::Med)
-        return size * 4;
+    for (std::size_t first = 0; first < x; first += block)
+        at += bits[first / block] * (std::min(x, first + block) - first);
 
-    // High
-    return size * 2;
+    return at;
 }
@@ -1,32 +1,209 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+class PngWriter;
+struct Distortion;
 
 class Image
 {
 public:
     enum class EncodingLevel {
-        Low  = 0,
-        Med  = 1,
-        High = 2,
+        Low      = 0,
+        Med      = 1,
+        High     = 2,
+        Stc      = 3,
+        Adaptive = 4,
     };
 
+    // Cost of changing a sample at level Stc. Texture makes changes in smooth areas
+    // expensive, judged from the neighbouring samples without their lowest bit
+    enum class StcCost { Flat, Texture };
+
+    // Level Stc codes every stc_block bytes as a trellis of its own (see stc.hpp)
+    static constexpr std::size_t stc_block = 240;
+
+    // Level Adaptive replaces 1 to 3 low bits of a sample (9 to 11 in 16-bit images)
+    // depending on how textured its adapt_block x adapt_block pixel block is, and none in
+    // the flattest ones. Texture is judged without the bits Low and Adaptive replace, so
+    // the decoder finds the same blocks in the stego image. Offsets and sizes at this level
+    // count those bits ("slots") in raster order instead of samples, see units()
+    static constexpr unsigned int adapt_block = 8;
+
+    // Stc and Adaptive read the cover before placing any data, so streamed images can
+    // be used at neither of them
+    static bool needs_memory(EncodingLevel level) {
+        return level == EncodingLevel::Stc || level == EncodingLevel::Adaptive;
+    }
+
     Image();
 
+    // Images keep the channel count and bit depth (8 or 16) of the source file.
+    // QOI files are recognised by their magic, and written for a ".qoi" path
     bool load(const std::string &path);
     bool save(const std::string &path);
 
-    void encode(const std::uint8_t *data, std::size_t size, EncodingLevel level, std::size_t offset = 0);
+    // Loads only the rows holding the first count samples of a non-interlaced PNG, so
+    // a prefix can be read before the rest of the file is decoded. False for other files
+    bool load_head(const std::string &path, std::size_t count);
+
+    // Maps an uncompressed BMP, PPM/PGM, TGA or TIFF file so that encode() patches its
+    // pixels in place. Saving to the same path then only writes back the touched pages
+    bool map(const std::string &path);
+    static bool mappable(const std::string &path);
+
+    // PNG images whose pixels would take more than threshold bytes are not decoded
+    // into memory. Their rows are read back from disk in bands of at most band_size
+    // bytes whenever they are needed, and save() applies the encoded data band by
+    // band while writing the result out. Applies to the next load()
+    static constexpr std::size_t default_stream_threshold = std::size_t(1) << 30;
+    static constexpr std::size_t default_band_size        = std::size_t(64) << 20;
+    void set_streaming(std::size_t threshold, std::size_t band_size) {
+        stream_threshold = threshold;
+        band_bytes       = band_size;
+    }
+    bool streamed() const { return !source.empty(); }
+    // File mapped by map() or load(), empty when the pixels are held in memory
+    const std::string &mapped_path() const { return mapping.path(); }
+
+    // Both fail (false / nullptr) when the samples would run past the end of the image.
+    // At level Stc the data is cut into blocks of stc_block bytes from the start of the
+    // call, so calls for one embed have to start at multiples of stc_block from its start
+    // and read whole blocks, except at its end. See needs_memory() for streamed images
+    bool encode(const std::uint8_t *data, std::size_t size, EncodingLevel level, std::size_t offset = 0);
     std::unique_ptr<std::uint8_t[]> decode(std::size_t size, EncodingLevel level, std::size_t offset = 0);
 
-    static std::size_t encoded_size(std::size_t size, EncodingLevel level);
+    // Extracts the same bytes as decode(), but into a buffer of tile_size bytes that
+    // is handed to sink every time it fills up (the last tile may be shorter).
+    // tile_size bytes must cover a whole number of samples, or of blocks at level Stc;
+    // stops when sink fails
+    bool decode(std::size_t size, EncodingLevel level, std::size_t offset, std::size_t tile_size,
+                const std::function<bool(const std::uint8_t *, std::size_t)> &sink);
+
+    // While enabled, encode() keeps a copy of the samples it is about to replace, and
+    // distortion() compares them with the current ones in one pass over the rows they
+    // lie in. False for streamed images, whose encode() is applied while saving
+    void keep_originals(bool keep);
+    bool distortion(Distortion &result) const;
+
+    void set_stc_cost(StcCost cost) { stc_cost = cost; }
+
+    // Calls f(y, rows, data) for consecutive bands of at most band_rows whole rows, with
+    // the samples in logical order and native byte order. Streamed images are read from
+    // disk once; false when that fails
+    bool read_rows(std::size_t band_rows, const std::function<void(std::size_t, std::size_t, const std::uint8_t *)> &f);
+
+    // Number of units (see units()) needed to store size bytes, SIZE_MAX if that overflows
+    std::size_t encoded_size(std::size_t size, EncodingLevel level) const;
+    // Number of whole bytes that fit into the given number of units
+    std::size_t decoded_size(std::size_t samples, EncodingLevel level) const;
+    // Number of low bits replaced in every channel sample, at level Stc the lowest one and
+    // at level Adaptive the most any block takes
+    unsigned int bits_per_sample(EncodingLevel level) const;
+
+    // Offsets at a level count channel samples, or slots at level Adaptive. units() is
+    // their number in the image and unit_at() the first one at or after a sample. Both
+    // are 0 at Adaptive for streamed images
+    std::size_t units(EncodingLevel level) const;
+    std::size_t unit_at(std::size_t sample, EncodingLevel level) const;
 
     unsigned int w() const { return width; }
     unsigned int h() const { return height; }
+    unsigned int c() const { return channels; }
+    unsigned int depth() const { return bit_depth; }
+
+    std::size_t samples() const { return std::size_t(width) * height * channels; }
 
 private:
+    bool open_carrier(const std::string &path, MappedFile::Mode mode);
+    bool open_streamed(const std::string &path);
+    bool flush();
+    bool save_streamed(const std::string &path);
+
+    // Calls f(pointer, count) for every stretch of consecutively stored samples
+    // in [offset, offset + count), in logical (top-down, RGBA) order
+    template <typename F> void for_each_run(std::size_t offset, std::size_t count, F &&f) const;
+    bool contains(std::size_t offset, std::size_t count) const;
+    // Extends the range of the mapping to write back over a run encode() has changed
+    void touch(const std::uint8_t *run, std::size_t n);
+    // Copies whole rows into out in logical order and native byte order
+    void pack_rows(std::size_t y, std::size_t rows, std::uint8_t *out) const;
+
+    // Reads the streamed image band by band, calling f(begin, end) with the samples
+    // held by each band, and passes every band on to out when given. Without an
+    // output it stops after the band holding sample end - 1
+    template <typename F> bool for_each_band(PngWriter *out, std::size_t end, F &&f);
+
+    // Level Stc, and the raw bit planes of decode() underneath it and the other levels
+    void encode_stc(const std::uint8_t *data, std::size_t size, std::size_t offset);
+    void texture_costs(std::size_t offset, std::size_t count, float *costs) const;
+    std::unique_ptr<std::uint8_t[]> decode_bits(std::size_t size, unsigned int bits, std::size_t offset);
+    bool decode_bits(std::size_t size, unsigned int bits, std::size_t offset, std::size_t tile_size,
+                     const std::function<bool(const std::uint8_t *, std::size_t)> &sink);
+    void keep_original(std::size_t offset, std::size_t count);
+
+    // Level Adaptive. The map holds the slots per sample of every block and the slots
+    // before every row, and is built on first use
+    struct AdaptiveMap {
+        std::vector<std::uint8_t> bits;
+        std::vector<std::uint64_t> rows;
+    };
+    const AdaptiveMap &adaptive_map() const;
+    std::unique_ptr<AdaptiveMap> measure_blocks() const;
+    // Calls f(sample, lo, hi) for the bits [lo, hi) of every sample holding the slots
+    // [offset, offset + count), in order
+    template <typename F> void for_each_slot(std::size_t offset, std::size_t count, F &&f) const;
+    std::size_t slot_sample(std::size_t slot) const;
+    bool encode_adaptive(const std::uint8_t *data, std::size_t size, std::size_t offset);
+    bool decode_adaptive(std::size_t size, std::size_t offset, std::uint8_t *tile, std::size_t tile_size,
+                         const std::function<bool(const std::uint8_t *, std::size_t)> &sink) const;
+
+    // encode() on a streamed image, applied when it is saved
+    struct Pending {
+        std::vector<std::uint8_t> data;
+        unsigned int bits;
+        std::size_t offset;
+    };
+
     std::unique_ptr<std::uint8_t[]> image;
+    MappedFile mapping;
+
     unsigned int width, height;
+    unsigned int channels, bit_depth;
+
+    std::uint8_t *pixels;        // First sample of row first_row
+    std::size_t first_row;       // Top row held in memory, only non-zero while streaming
+    std::ptrdiff_t stride;       // Bytes from one row to the next
+    const std::uint8_t *swizzle; // Storage index of each channel, nullptr when stored in order
+    bool swapped;                // 16-bit samples are stored in the opposite byte order
+
+    std::size_t dirty_begin, dirty_end; // Range of the mapping touched by encode()
+
+    std::string source;           // File a streamed image is read from
+    std::vector<Pending> pending;
+
+    // Samples replaced by encode() while keeping originals, in logical and native byte order
+    struct Original {
+        std::size_t offset;
+        std::vector<std::uint8_t> samples;
+    };
+
+    bool keeping;
+    std::vector<Original> originals;
+
+    StcCost stc_cost;
+
+    // Dropped whenever other pixels are loaded; the lock lets parallel decode() calls share it
+    mutable std::unique_ptr<AdaptiveMap> adaptive;
+    std::unique_ptr<std::mutex> adaptive_lock;
+
+    std::size_t stream_threshold, band_bytes;
 };
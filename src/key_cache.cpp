@@ -0,0 +1,179 @@
+#include "key_cache.hpp"
+#include "sha256.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+void secure_zero(void *data, std::size_t size) {
+    volatile std::uint8_t *p = static_cast<volatile std::uint8_t*>(data);
+    while (size--)
+        *p++ = 0;
+}
+
+// Page-locked allocation, falling back to the heap when locking is not allowed
+static void *lock_alloc(std::size_t size, bool &locked) {
+    locked = false;
+
+#if defined(__linux__) || defined(__APPLE__)
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) {
+#if defined(__linux__)
+        madvise(p, size, MADV_DONTDUMP);
+#endif
+        if (mlock(p, size) == 0) {
+            locked = true;
+            return p;
+        }
+        munmap(p, size);
+    }
+#elif defined(_WIN32)
+    void *p = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (p) {
+        if (VirtualLock(p, size)) {
+            locked = true;
+            return p;
+        }
+        VirtualFree(p, 0, MEM_RELEASE);
+    }
+#endif
+
+    return std::calloc(1, size);
+}
+
+static void lock_free(void *p, std::size_t size, bool locked) {
+    if (!locked) {
+        std::free(p);
+        return;
+    }
+
+#if defined(__linux__) || defined(__APPLE__)
+    munlock(p, size);
+    munmap(p, size);
+#elif defined(_WIN32)
+    VirtualUnlock(p, size);
+    VirtualFree(p, 0, MEM_RELEASE);
+#endif
+}
+
+static void entry_id(const std::uint8_t *password, std::size_t password_size, const std::uint8_t *salt, std::size_t salt_size,
+                     unsigned int rounds, std::uint8_t *id) {
+    std::uint8_t params[4] = {
+        std::uint8_t(rounds), std::uint8_t(rounds >> 8), std::uint8_t(rounds >> 16), std::uint8_t(rounds >> 24)
+    };
+
+    SHA256 sha;
+    sha.update(password, password_size);
+    sha.update(salt, salt_size);
+    sha.update(params, sizeof(params));
+    sha.finish();
+    sha.get_hash(id);
+}
+
+KeyCache::KeyCache(std::size_t capacity, std::chrono::seconds ttl) : count(capacity), lifetime(ttl) {
+    bytes   = std::max<std::size_t>(1, count) * sizeof(Entry);
+    entries = static_cast<Entry*>(lock_alloc(bytes, locked));
+    if (!entries)
+        throw std::bad_alloc();
+
+    for (std::size_t i = 0; i < count; i++)
+        new (&entries[i]) Entry{};
+}
+
+KeyCache::~KeyCache() {
+    clear();
+    lock_free(entries, bytes, locked);
+}
+
+KeyCache &KeyCache::global() {
+    static KeyCache cache;
+    return cache;
+}
+
+void KeyCache::wipe(Entry &entry) {
+    secure_zero(entry.id, sizeof(entry.id));
+    secure_zero(entry.key, sizeof(entry.key));
+    entry.valid = false;
+}
+
+void KeyCache::expire(Clock::time_point now) {
+    for (std::size_t i = 0; i < count; i++)
+        if (entries[i].valid && now - entries[i].created >= lifetime)
+            wipe(entries[i]);
+}
+
+bool KeyCache::get(const std::uint8_t *password, std::size_t password_size, const std::uint8_t *salt, std::size_t salt_size,
+                   unsigned int rounds, std::uint8_t *key) {
+    std::uint8_t id[32];
+    entry_id(password, password_size, salt, salt_size, rounds, id);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+    expire(now);
+
+    for (std::size_t i = 0; i < count; i++) {
+        auto &entry = entries[i];
+
+        if (entry.valid && std::equal(id, id + sizeof(id), entry.id)) {
+            std::copy_n(entry.key, key_size, key);
+            entry.used = now;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void KeyCache::put(const std::uint8_t *password, std::size_t password_size, const std::uint8_t *salt, std::size_t salt_size,
+                   unsigned int rounds, const std::uint8_t *key) {
+    std::uint8_t id[32];
+    entry_id(password, password_size, salt, salt_size, rounds, id);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = Clock::now();
+    expire(now);
+
+    if (!count || lifetime.count() <= 0)
+        return;
+
+    // A free slot, otherwise the least recently used entry
+    Entry *slot = &entries[0];
+    for (std::size_t i = 0; i < count; i++) {
+        auto &entry = entries[i];
+
+        if (!entry.valid || std::equal(id, id + sizeof(id), entry.id)) {
+            slot = &entry;
+            break;
+        }
+        if (entry.used < slot->used)
+            slot = &entry;
+    }
+
+    wipe(*slot);
+
+    std::copy_n(id, sizeof(id), slot->id);
+    std::copy_n(key, key_size, slot->key);
+    slot->created = now;
+    slot->used    = now;
+    slot->valid   = true;
+}
+
+void KeyCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (std::size_t i = 0; i < count; i++)
+        wipe(entries[i]);
+}
+
+void KeyCache::set_ttl(std::chrono::seconds ttl) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    lifetime = ttl;
+    expire(Clock::now());
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+// Memory writes the compiler may not drop as dead stores
+void secure_zero(void *data, std::size_t size);
+
+// Small LRU cache of derived keys, so retrying the same image and password does not
+// rerun PBKDF2. Entries are looked up by SHA256(password, salt, rounds) and kept in
+// page-locked memory that never reaches swap. They expire after ttl, and are wiped
+// when they expire, are evicted or the cache is cleared
+class KeyCache
+{
+public:
+    static const std::size_t key_size = 32;
+
+    explicit KeyCache(std::size_t capacity = 8, std::chrono::seconds ttl = std::chrono::seconds(60));
+    ~KeyCache();
+
+    KeyCache(const KeyCache &) = delete;
+    KeyCache &operator=(const KeyCache &) = delete;
+
+    bool get(const std::uint8_t *password, std::size_t password_size, const std::uint8_t *salt, std::size_t salt_size,
+             unsigned int rounds, std::uint8_t *key);
+    void put(const std::uint8_t *password, std::size_t password_size, const std::uint8_t *salt, std::size_t salt_size,
+             unsigned int rounds, const std::uint8_t *key);
+
+    void clear();
+    // A ttl of zero disables the cache
+    void set_ttl(std::chrono::seconds ttl);
+
+    // Cache shared by encode() and decode()
+    static KeyCache &global();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::uint8_t id[32];
+        std::uint8_t key[key_size];
+        Clock::time_point created, used;
+        bool valid;
+    };
+
+    void expire(Clock::time_point now);
+    void wipe(Entry &entry);
+
+    Entry *entries;
+    std::size_t count, bytes;
+    bool locked;
+    std::chrono::seconds lifetime;
+    std::mutex mutex;
+};
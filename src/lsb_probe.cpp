@@ -0,0 +1,73 @@
+#include "lsb_probe.hpp"
+
+#include <bitset>
+#include <cmath>
+#include <cstring>
+
+// Rejection bounds, each at p ~ 1e-7 for uniformly random bits
+static const double max_z        = 5.33;
+static const double max_pairs    = 35.0; // 3 degrees of freedom
+static const double max_nibbles  = 64.0; // 15 degrees of freedom
+
+ProbeResult probe_bits(const std::uint8_t *data, std::size_t size) {
+    ProbeResult result{};
+    double n = double(size) * 8;
+
+    if (!size)
+        return result;
+
+    // Ones and bit changes counted 64 bits at a time, reading the bytes least
+    // significant bit first. Changes across byte boundaries are added separately
+    std::size_t ones = 0, changes = 0;
+    std::size_t words = size / 8;
+
+    for (std::size_t i = 0; i < words; i++) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i * 8, 8);
+
+        ones    += std::bitset<64>(word).count();
+        changes += std::bitset<64>((word ^ (word >> 1)) & 0x7f7f7f7f7f7f7f7full).count();
+    }
+
+    for (std::size_t i = words * 8; i < size; i++) {
+        ones    += std::bitset<8>(data[i]).count();
+        changes += std::bitset<8>((data[i] ^ (data[i] >> 1)) & 0x7f).count();
+    }
+
+    for (std::size_t i = 1; i < size; i++)
+        changes += (data[i - 1] >> 7) != (data[i] & 1);
+
+    result.monobit = std::fabs(2.0 * ones - n) / std::sqrt(n);
+
+    // Wald-Wolfowitz runs test
+    double n1 = double(ones), n0 = n - n1;
+    double mean     = 2 * n0 * n1 / n + 1;
+    double variance = (mean - 1) * (mean - 2) / (n - 1);
+    result.runs = variance > 0 ? std::fabs(changes + 1 - mean) / std::sqrt(variance) : INFINITY;
+
+    std::size_t pairs[4] = {}, nibbles[16] = {};
+    for (std::size_t i = 0; i < size; i++) {
+        std::uint8_t byte = data[i];
+
+        pairs[byte & 3]++;
+        pairs[(byte >> 2) & 3]++;
+        pairs[(byte >> 4) & 3]++;
+        pairs[byte >> 6]++;
+
+        nibbles[byte & 15]++;
+        nibbles[byte >> 4]++;
+    }
+
+    double expected = n / 8;
+    for (auto count : pairs)
+        result.pairs += (count - expected) * (count - expected) / expected;
+
+    expected = n / 64;
+    for (auto count : nibbles)
+        result.nibbles += (count - expected) * (count - expected) / expected;
+
+    result.random = result.monobit < max_z && result.runs < max_z &&
+                    result.pairs < max_pairs && result.nibbles < max_nibbles;
+
+    return result;
+}
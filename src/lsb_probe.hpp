@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Randomness statistics on the bits of extracted LSB data. Encrypted data passes all
+// of them, while the low bits of flat, synthetic or re-quantised image regions fail
+// at least one. The bounds sit near p = 1e-7 per test, so an image that does hold
+// ciphertext is practically never rejected
+struct ProbeResult {
+    double monobit; // |z| of the number of one bits
+    double runs;    // |z| of the number of runs of equal bits
+    double pairs;   // Chi-square of the non-overlapping bit pairs, 3 degrees of freedom
+    double nibbles; // Chi-square of the 4-bit values, 15 degrees of freedom
+    bool random;    // All within bounds, so the data may be ciphertext
+};
+
+ProbeResult probe_bits(const std::uint8_t *data, std::size_t size);
@@ -0,0 +1,186 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : ptr(nullptr), length(0), access(Mode::Read) {
+#if defined(__linux__) || defined(__APPLE__)
+    fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+
+bool MappedFile::open(const std::string &path, Mode mode) {
+    close();
+
+    fd = ::open(path.c_str(), mode == Mode::Write ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+
+    int prot  = mode == Mode::Read ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == Mode::Write ? MAP_SHARED : MAP_PRIVATE;
+
+    void *p = mmap(nullptr, st.st_size, prot, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    if (mode == Mode::Read)
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    ptr    = static_cast<std::uint8_t*>(p);
+    length = st.st_size;
+    name   = path;
+    access = mode;
+
+    return true;
+}
+
+bool MappedFile::create(const std::string &path, std::size_t size) {
+    close();
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+#if defined(__linux__)
+    // Reserve the blocks up front, so that a full disk fails here rather than
+    // with SIGBUS while writing to the mapping
+    int error = size ? posix_fallocate(fd, 0, size) : 0;
+    if (error && error != EOPNOTSUPP && error != EINVAL) {
+        close();
+        return false;
+    }
+#endif
+
+    if (ftruncate(fd, size) != 0) {
+        close();
+        return false;
+    }
+
+    // An empty file can't be mapped, but there is nothing to write either
+    if (size) {
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close();
+            return false;
+        }
+
+        madvise(p, size, MADV_SEQUENTIAL);
+        ptr = static_cast<std::uint8_t*>(p);
+    }
+
+    length = size;
+    name   = path;
+    access = Mode::Write;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr)
+        munmap(ptr, length);
+    if (fd >= 0)
+        ::close(fd);
+
+    ptr    = nullptr;
+    length = 0;
+    fd     = -1;
+    name.clear();
+}
+
+bool MappedFile::flush(std::size_t offset, std::size_t size) {
+    if (access != Mode::Write || !size)
+        return true;
+
+    // msync wants a page aligned start
+    std::size_t page  = sysconf(_SC_PAGESIZE);
+    std::size_t begin = offset / page * page;
+
+    return msync(ptr + begin, offset + size - begin, MS_SYNC) == 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path, Mode mode) {
+    close();
+
+    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+
+    buffer.resize(file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+    if (!file || buffer.empty())
+        return false;
+
+    ptr    = buffer.data();
+    length = buffer.size();
+    name   = path;
+    access = mode;
+
+    return true;
+}
+
+bool MappedFile::create(const std::string &path, std::size_t size) {
+    close();
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    // Written out by flush()
+    buffer.resize(size);
+
+    ptr    = buffer.data();
+    length = size;
+    name   = path;
+    access = Mode::Write;
+
+    return true;
+}
+
+void MappedFile::close() {
+    buffer.clear();
+    buffer.shrink_to_fit();
+
+    ptr    = nullptr;
+    length = 0;
+    name.clear();
+}
+
+bool MappedFile::flush(std::size_t offset, std::size_t size) {
+    if (access != Mode::Write || !size)
+        return true;
+
+    std::fstream file(name, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(ptr + offset), size);
+
+    return file.good();
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Memory mapping of a whole file. Falls back to reading the file into memory
+// and writing flushed ranges back on systems without mmap
+class MappedFile
+{
+public:
+    enum class Mode {
+        Read,    // Read-only view, expected to be read front to back
+        Private, // Copy-on-write, changes never reach the file
+        Write,   // Changes are written back to the file by flush()
+    };
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path, Mode mode);
+    // Creates or truncates path to size bytes and maps it for writing
+    bool create(const std::string &path, std::size_t size);
+    void close();
+
+    // Writes back the pages covering [offset, offset + size)
+    bool flush(std::size_t offset, std::size_t size);
+
+    std::uint8_t *data() const { return ptr; }
+    std::size_t size() const { return length; }
+    const std::string &path() const { return name; }
+    Mode mode() const { return access; }
+
+private:
+    std::uint8_t *ptr;
+    std::size_t length;
+    Mode access;
+    std::string name;
+
+#if defined(__linux__) || defined(__APPLE__)
+    int fd;
+#else
+    std::vector<std::uint8_t> buffer;
+#endif
+};
@@ -0,0 +1,349 @@
+#include "png_stream.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+// Size of the compressed data buffers on both sides
+static const std::size_t buffer_size = 64 * 1024;
+
+static std::uint32_t get32(const std::uint8_t *p) {
+    return (std::uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put32(std::uint8_t *p, std::uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static bool big_endian_host() {
+    const std::uint16_t probe = 1;
+    return *reinterpret_cast<const std::uint8_t*>(&probe) == 0;
+}
+
+static int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return a;
+
+    return pb <= pc ? b : c;
+}
+
+PngReader::PngReader() : file(nullptr), inflating(false), width(0), height(0), channels(0), bit_depth(0),
+                         row(0), remaining(0) {
+}
+
+PngReader::~PngReader() {
+    close();
+}
+
+bool PngReader::open(const std::string &path) {
+    close();
+
+    file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    std::uint8_t head[8 + 8 + 13 + 4];
+    if (fread(head, 1, sizeof(head), file) != sizeof(head) || std::memcmp(head, signature, 8) != 0 ||
+        std::memcmp(head + 12, "IHDR", 4) != 0) {
+        close();
+        return false;
+    }
+
+    auto ihdr = head + 16;
+    static const unsigned int channel_count[7] = { 1, 0, 3, 0, 2, 0, 4 };
+
+    width     = get32(ihdr);
+    height    = get32(ihdr + 4);
+    bit_depth = ihdr[8];
+    channels  = ihdr[9] < 7 ? channel_count[ihdr[9]] : 0;
+
+    // Palettes, sub-byte depths and interlacing are left to stb_image
+    if (!width || !height || !channels || (bit_depth != 8 && bit_depth != 16) || ihdr[12] != 0 ||
+        width > (SIZE_MAX - 1) / (channels * (bit_depth / 8))) {
+        close();
+        return false;
+    }
+
+    row = std::size_t(width) * channels * (bit_depth / 8);
+
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        close();
+        return false;
+    }
+
+    inflating = true;
+    remaining = 0;
+    input   = std::make_unique<std::uint8_t[]>(buffer_size);
+    current = std::make_unique<std::uint8_t[]>(row + 1);
+    prior   = std::make_unique<std::uint8_t[]>(row + 1);
+
+    return true;
+}
+
+void PngReader::close() {
+    if (inflating)
+        inflateEnd(&stream);
+    if (file)
+        fclose(file);
+
+    inflating = false;
+    file = nullptr;
+}
+
+bool PngReader::fill_input() {
+    // Skip to the next IDAT chunk once the current one is used up
+    while (!remaining) {
+        std::uint8_t head[8];
+
+        if (fread(head, 1, sizeof(head), file) != sizeof(head))
+            return false;
+
+        std::uint32_t length = get32(head);
+
+        if (std::memcmp(head + 4, "IDAT", 4) == 0)
+            remaining = length;
+        else if (std::memcmp(head + 4, "IEND", 4) == 0 || fseek(file, length + 4, SEEK_CUR) != 0)
+            return false;
+
+        if (remaining)
+            break;
+
+        // Empty IDAT chunk, skip its CRC
+        if (fseek(file, 4, SEEK_CUR) != 0)
+            return false;
+    }
+
+    std::size_t size = fread(input.get(), 1, std::min(remaining, buffer_size), file);
+    if (!size)
+        return false;
+
+    remaining -= size;
+    if (!remaining && fseek(file, 4, SEEK_CUR) != 0)
+        return false;
+
+    stream.next_in  = input.get();
+    stream.avail_in = size;
+
+    return true;
+}
+
+bool PngReader::read_row(std::uint8_t *dst) {
+    stream.next_out  = current.get();
+    stream.avail_out = row + 1;
+
+    while (stream.avail_out) {
+        if (!stream.avail_in && !fill_input())
+            return false;
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END && stream.avail_out)
+            return false;
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+            return false;
+    }
+
+    std::size_t bpp = channels * (bit_depth / 8);
+    auto cur = current.get() + 1, up = prior.get() + 1;
+
+    switch (current[0]) {
+    case 0:
+        break;
+    case 1:
+        for (std::size_t i = bpp; i < row; i++)
+            cur[i] += cur[i - bpp];
+        break;
+    case 2:
+        for (std::size_t i = 0; i < row; i++)
+            cur[i] += up[i];
+        break;
+    case 3:
+        for (std::size_t i = 0; i < row; i++)
+            cur[i] += ((i >= bpp ? cur[i - bpp] : 0) + up[i]) / 2;
+        break;
+    case 4:
+        for (std::size_t i = 0; i < row; i++)
+            cur[i] += paeth(i >= bpp ? cur[i - bpp] : 0, up[i], i >= bpp ? up[i - bpp] : 0);
+        break;
+    default:
+        return false;
+    }
+
+    if (bit_depth == 16 && !big_endian_host()) {
+        for (std::size_t i = 0; i < row; i += 2) {
+            dst[i + 0] = cur[i + 1];
+            dst[i + 1] = cur[i + 0];
+        }
+    } else {
+        std::copy_n(cur, row, dst);
+    }
+
+    std::swap(current, prior);
+
+    return true;
+}
+
+bool PngReader::read_rows(std::uint8_t *rows, std::size_t count) {
+    for (std::size_t y = 0; y < count; y++, rows += row)
+        if (!read_row(rows))
+            return false;
+
+    return true;
+}
+
+PngWriter::PngWriter() : file(nullptr), deflating(false), width(0), height(0), channels(0), bit_depth(0),
+                         row(0), written(0) {
+}
+
+PngWriter::~PngWriter() {
+    if (deflating)
+        deflateEnd(&stream);
+    if (file)
+        fclose(file);
+}
+
+bool PngWriter::open(const std::string &path, unsigned int w, unsigned int h, unsigned int c, unsigned int depth) {
+    static const std::uint8_t color_type[5] = { 0, 0, 4, 2, 6 };
+
+    if (!w || !h || !c || c > 4 || (depth != 8 && depth != 16))
+        return false;
+
+    width     = w;
+    height    = h;
+    channels  = c;
+    bit_depth = depth;
+    row       = std::size_t(w) * c * (depth / 8);
+    written   = 0;
+
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+
+    deflating = true;
+    output   = std::make_unique<std::uint8_t[]>(buffer_size);
+    raw      = std::make_unique<std::uint8_t[]>(row);
+    prior    = std::make_unique<std::uint8_t[]>(row);
+    filtered = std::make_unique<std::uint8_t[]>((row + 1) * 5);
+
+    std::uint8_t ihdr[13];
+    put32(ihdr, w);
+    put32(ihdr + 4, h);
+    ihdr[8]  = depth;
+    ihdr[9]  = color_type[c];
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    std::fill_n(prior.get(), row, 0);
+
+    return fwrite(signature, 1, sizeof(signature), file) == sizeof(signature) &&
+           write_chunk("IHDR", ihdr, sizeof(ihdr));
+}
+
+bool PngWriter::write_chunk(const char *type, const std::uint8_t *data, std::size_t size) {
+    std::uint8_t head[8], tail[4];
+    put32(head, size);
+    std::memcpy(head + 4, type, 4);
+
+    // IEND passes a null buffer, which neither crc32() nor fwrite() may see
+    auto crc = crc32(0, head + 4, 4);
+    if (size)
+        crc = crc32(crc, data, size);
+    put32(tail, crc);
+
+    return fwrite(head, 1, 8, file) == 8 && (!size || fwrite(data, 1, size, file) == size) &&
+           fwrite(tail, 1, 4, file) == 4;
+}
+
+bool PngWriter::deflate_data(const std::uint8_t *data, std::size_t size, int flush) {
+    stream.next_in  = const_cast<std::uint8_t*>(data);
+    stream.avail_in = size;
+
+    do {
+        stream.next_out  = output.get();
+        stream.avail_out = buffer_size;
+
+        int result = deflate(&stream, flush);
+        if (result == Z_STREAM_ERROR)
+            return false;
+
+        std::size_t produced = buffer_size - stream.avail_out;
+        if (produced && !write_chunk("IDAT", output.get(), produced))
+            return false;
+    } while (stream.avail_out == 0 || (flush == Z_FINISH && stream.avail_in));
+
+    return true;
+}
+
+bool PngWriter::write_rows(const std::uint8_t *rows, std::size_t count) {
+    std::size_t bpp = channels * (bit_depth / 8);
+
+    for (std::size_t y = 0; y < count; y++, rows += row, written++) {
+        // Samples are stored big-endian
+        if (bit_depth == 16 && !big_endian_host()) {
+            for (std::size_t i = 0; i < row; i += 2) {
+                raw[i + 0] = rows[i + 1];
+                raw[i + 1] = rows[i + 0];
+            }
+        } else {
+            std::copy_n(rows, row, raw.get());
+        }
+
+        // Try every filter and keep the one with the smallest sum of absolute values
+        std::size_t best = 0, best_score = SIZE_MAX;
+        for (int f = 0; f < 5; f++) {
+            auto out = filtered.get() + f * (row + 1);
+            auto cur = raw.get(), up = prior.get();
+            std::size_t score = 0;
+
+            out[0] = f;
+            for (std::size_t i = 0; i < row; i++) {
+                int a = i >= bpp ? cur[i - bpp] : 0, b = up[i], c = i >= bpp ? up[i - bpp] : 0;
+                std::uint8_t v;
+
+                switch (f) {
+                case 0:  v = cur[i]; break;
+                case 1:  v = cur[i] - a; break;
+                case 2:  v = cur[i] - b; break;
+                case 3:  v = cur[i] - (a + b) / 2; break;
+                default: v = cur[i] - paeth(a, b, c); break;
+                }
+
+                out[i + 1] = v;
+                score += std::abs(static_cast<std::int8_t>(v));
+            }
+
+            if (score < best_score) {
+                best = f;
+                best_score = score;
+            }
+        }
+
+        if (!deflate_data(filtered.get() + best * (row + 1), row + 1, Z_NO_FLUSH))
+            return false;
+
+        std::swap(raw, prior);
+    }
+
+    return true;
+}
+
+bool PngWriter::finish() {
+    if (!file || written != height || !deflate_data(nullptr, 0, Z_FINISH) || !write_chunk("IEND", nullptr, 0))
+        return false;
+
+    deflateEnd(&stream);
+    deflating = false;
+
+    bool result = fclose(file) == 0;
+    file = nullptr;
+
+    return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "zlib/zlib.h"
+
+// Row by row PNG decoder for non-interlaced 8 and 16-bit grey, grey-alpha, RGB
+// and RGBA images. 16-bit samples are returned in native byte order
+class PngReader
+{
+public:
+    PngReader();
+    ~PngReader();
+
+    PngReader(const PngReader &) = delete;
+    PngReader &operator=(const PngReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool read_rows(std::uint8_t *rows, std::size_t count);
+
+    unsigned int w() const { return width; }
+    unsigned int h() const { return height; }
+    unsigned int c() const { return channels; }
+    unsigned int depth() const { return bit_depth; }
+    std::size_t row_size() const { return row; }
+
+private:
+    bool fill_input();
+    bool read_row(std::uint8_t *dst);
+
+    FILE *file;
+    z_stream stream;
+    bool inflating;
+
+    unsigned int width, height, channels, bit_depth;
+    std::size_t row;
+    std::size_t remaining; // Bytes left in the current IDAT chunk
+
+    std::unique_ptr<std::uint8_t[]> input;
+    std::unique_ptr<std::uint8_t[]> current, prior;
+};
+
+// Row by row PNG encoder with per-row filter selection
+class PngWriter
+{
+public:
+    PngWriter();
+    ~PngWriter();
+
+    PngWriter(const PngWriter &) = delete;
+    PngWriter &operator=(const PngWriter &) = delete;
+
+    bool open(const std::string &path, unsigned int w, unsigned int h, unsigned int c, unsigned int depth);
+    bool write_rows(const std::uint8_t *rows, std::size_t count);
+    bool finish();
+
+private:
+    bool write_chunk(const char *type, const std::uint8_t *data, std::size_t size);
+    bool deflate_data(const std::uint8_t *data, std::size_t size, int flush);
+
+    FILE *file;
+    z_stream stream;
+    bool deflating;
+
+    unsigned int width, height, channels, bit_depth;
+    std::size_t row, written;
+
+    std::unique_ptr<std::uint8_t[]> output;
+    std::unique_ptr<std::uint8_t[]> raw, prior, filtered;
+};
@@ -0,0 +1,272 @@
+#include "qoi.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+static const std::uint8_t QOI_OP_INDEX = 0x00;
+static const std::uint8_t QOI_OP_DIFF  = 0x40;
+static const std::uint8_t QOI_OP_LUMA  = 0x80;
+static const std::uint8_t QOI_OP_RUN   = 0xc0;
+static const std::uint8_t QOI_OP_RGB   = 0xfe;
+static const std::uint8_t QOI_OP_RGBA  = 0xff;
+static const std::uint8_t QOI_MASK     = 0xc0;
+
+static const std::uint8_t qoi_end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+// Both directions go through a fixed buffer instead of holding the whole file
+static const std::size_t buffer_size = 64 * 1024;
+
+struct Pixel {
+    std::uint8_t r, g, b, a;
+
+    bool operator==(const Pixel &o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
+};
+
+static unsigned int qoi_hash(const Pixel &p) {
+    return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+}
+
+static std::uint32_t get32(const std::uint8_t *p) {
+    return (std::uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put32(std::uint8_t *p, std::uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+class Reader
+{
+public:
+    explicit Reader(FILE *file) : file(file), buffer(new std::uint8_t[buffer_size]), pos(0), end(0), truncated(false) {}
+
+    // Returns 0 past the end of the file and marks the stream as truncated
+    std::uint8_t next() {
+        if (pos == end) {
+            end = fread(buffer.get(), 1, buffer_size, file);
+            pos = 0;
+            if (!end) {
+                truncated = true;
+                return 0;
+            }
+        }
+        return buffer[pos++];
+    }
+
+    bool eof() const { return truncated; }
+
+private:
+    FILE *file;
+    std::unique_ptr<std::uint8_t[]> buffer;
+    std::size_t pos, end;
+    bool truncated;
+};
+
+class Writer
+{
+public:
+    explicit Writer(FILE *file) : file(file), buffer(new std::uint8_t[buffer_size]), pos(0), ok(true) {}
+
+    void put(std::uint8_t b) {
+        if (pos == buffer_size)
+            flush();
+        buffer[pos++] = b;
+    }
+
+    bool flush() {
+        ok = ok && fwrite(buffer.get(), 1, pos, file) == pos;
+        pos = 0;
+        return ok;
+    }
+
+private:
+    FILE *file;
+    std::unique_ptr<std::uint8_t[]> buffer;
+    std::size_t pos;
+    bool ok;
+};
+
+bool qoi_signature(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char magic[4];
+    bool result = fread(magic, 1, 4, file) == 4 && std::memcmp(magic, "qoif", 4) == 0;
+    fclose(file);
+
+    return result;
+}
+
+bool qoi_read(const std::string &path, unsigned int &width, unsigned int &height, unsigned int &channels,
+              std::unique_ptr<std::uint8_t[]> &pixels) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    std::uint8_t header[14];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || std::memcmp(header, "qoif", 4) != 0 ||
+        (header[12] != 3 && header[12] != 4)) {
+        fclose(file);
+        return false;
+    }
+
+    width    = get32(header + 4);
+    height   = get32(header + 8);
+    channels = header[12];
+
+    std::size_t count = std::size_t(width) * height;
+    if (!count || count / width != height || count > SIZE_MAX / 4) {
+        fclose(file);
+        return false;
+    }
+
+    pixels = std::make_unique<std::uint8_t[]>(count * channels);
+
+    Reader in(file);
+    Pixel index[64] = {};
+    Pixel px = { 0, 0, 0, 255 };
+    unsigned int run = 0;
+    auto out = pixels.get();
+
+    for (std::size_t i = 0; i < count; i++, out += channels) {
+        if (run) {
+            run--;
+        } else {
+            std::uint8_t b1 = in.next();
+
+            if (b1 == QOI_OP_RGB) {
+                px.r = in.next();
+                px.g = in.next();
+                px.b = in.next();
+            } else if (b1 == QOI_OP_RGBA) {
+                px.r = in.next();
+                px.g = in.next();
+                px.b = in.next();
+                px.a = in.next();
+            } else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+                px = index[b1];
+            } else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+                px.r += ((b1 >> 4) & 0x03) - 2;
+                px.g += ((b1 >> 2) & 0x03) - 2;
+                px.b += ( b1       & 0x03) - 2;
+            } else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+                std::uint8_t b2 = in.next();
+                int vg = (b1 & 0x3f) - 32;
+                px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.g += vg;
+                px.b += vg - 8 + (b2 & 0x0f);
+            } else {
+                run = b1 & 0x3f;
+            }
+
+            index[qoi_hash(px)] = px;
+        }
+
+        out[0] = px.r;
+        out[1] = px.g;
+        out[2] = px.b;
+        if (channels == 4)
+            out[3] = px.a;
+    }
+
+    fclose(file);
+
+    // The pixels ran past the end of the file
+    return !in.eof();
+}
+
+bool qoi_write(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+               const std::uint8_t *pixels) {
+    if ((channels != 3 && channels != 4) || !width || !height)
+        return false;
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    Writer out(file);
+
+    std::uint8_t header[14];
+    std::memcpy(header, "qoif", 4);
+    put32(header + 4, width);
+    put32(header + 8, height);
+    header[12] = channels;
+    header[13] = 0;
+    for (auto b : header)
+        out.put(b);
+
+    Pixel index[64] = {};
+    Pixel prev = { 0, 0, 0, 255 };
+    Pixel px   = prev;
+    unsigned int run = 0;
+    std::size_t count = std::size_t(width) * height;
+
+    for (std::size_t i = 0; i < count; i++, pixels += channels) {
+        px.r = pixels[0];
+        px.g = pixels[1];
+        px.b = pixels[2];
+        if (channels == 4)
+            px.a = pixels[3];
+
+        if (px == prev) {
+            if (++run == 62) {
+                out.put(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run) {
+            out.put(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        auto hash = qoi_hash(px);
+
+        if (index[hash] == px) {
+            out.put(QOI_OP_INDEX | hash);
+        } else {
+            index[hash] = px;
+
+            // LSB noise keeps neighbouring pixels a few levels apart, so the
+            // one and two byte delta encodings are tried before the literals
+            if (px.a == prev.a) {
+                std::int8_t vr = px.r - prev.r;
+                std::int8_t vg = px.g - prev.g;
+                std::int8_t vb = px.b - prev.b;
+                std::int8_t vg_r = vr - vg;
+                std::int8_t vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out.put(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                    out.put(QOI_OP_LUMA | (vg + 32));
+                    out.put((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    out.put(QOI_OP_RGB);
+                    out.put(px.r);
+                    out.put(px.g);
+                    out.put(px.b);
+                }
+            } else {
+                out.put(QOI_OP_RGBA);
+                out.put(px.r);
+                out.put(px.g);
+                out.put(px.b);
+                out.put(px.a);
+            }
+        }
+
+        prev = px;
+    }
+
+    if (run)
+        out.put(QOI_OP_RUN | (run - 1));
+
+    for (auto b : qoi_end)
+        out.put(b);
+
+    bool result = out.flush();
+
+    return fclose(file) == 0 && result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Streaming codec for QOI ("Quite OK Image") files, 8-bit RGB or RGBA only
+
+// Whether the file starts with the "qoif" magic
+bool qoi_signature(const std::string &path);
+
+bool qoi_read(const std::string &path, unsigned int &width, unsigned int &height, unsigned int &channels,
+              std::unique_ptr<std::uint8_t[]> &pixels);
+
+bool qoi_write(const std::string &path, unsigned int width, unsigned int height, unsigned int channels,
+               const std::uint8_t *pixels);
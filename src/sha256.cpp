@@ -157,6 +157,39 @@ void hmac_sha256(const void *data, std::size_t size, const void *key, std::size_
     H(opad, 64, ihash, 32, hash);
 }
 
+HMAC::HMAC(const void *key, std::size_t key_size) {
+    std::uint8_t K[64];
+    std::fill_n(K, 64, 0x00);
+
+    if (key_size <= 64)
+        std::copy_n(static_cast<const std::uint8_t*>(key), key_size, K);
+    else {
+        SHA256 sha;
+        sha.update(key, key_size);
+        sha.finish();
+        sha.get_hash(K);
+    }
+
+    std::uint8_t ipad[64];
+    for (int i = 0; i < 64; i++) {
+        ipad[i] = K[i] ^ 0x36;
+        opad[i] = K[i] ^ 0x5c;
+    }
+
+    inner.update(ipad, 64);
+}
+
+void HMAC::update(const void *data, std::size_t size) {
+    inner.update(data, size);
+}
+
+void HMAC::finish(std::uint8_t hash[32]) {
+    std::uint8_t ihash[32];
+    inner.finish();
+    inner.get_hash(ihash);
+    H(opad, 64, ihash, 32, hash);
+}
+
 void pbkdf2_hmac_sha256(const void *pass, std::size_t pass_size, const void *salt, std::size_t salt_size, void *result, std::size_t result_size, std::size_t rounds) {
     std::uint8_t u1[32], u2[32], f[32];
     std::uint8_t *s = new std::uint8_t[salt_size + 4];
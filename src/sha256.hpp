@@ -23,5 +23,19 @@ private:
     std::uint8_t last_data[64];
 };
 
+// HMAC-SHA256 over data passed in pieces
+class HMAC
+{
+public:
+    HMAC(const void *key, std::size_t key_size);
+
+    void update(const void *data, std::size_t size);
+    void finish(std::uint8_t hash[32]);
+
+private:
+    SHA256 inner;
+    std::uint8_t opad[64];
+};
+
 void hmac_sha256(const void *data, std::size_t size, const void *key, std::size_t key_size, std::uint8_t hash[32]);
 void pbkdf2_hmac_sha256(const void *pass, std::size_t pass_size, const void *salt, std::size_t salt_size, void *result, std::size_t result_size, std::size_t rounds);
@@ -0,0 +1,38 @@
+#include "simd.hpp"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static Isa detect_isa() {
+#if !defined(SIMD_X86)
+    return Isa::Scalar;
+#else
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int highest = info[0];
+
+    __cpuid(info, 1);
+    bool ssse3 = info[2] & (1 << 9);
+    bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (highest >= 7 && os_avx) {
+        __cpuidex(info, 7, 0);
+        avx2 = info[1] & (1 << 5);
+    }
+#else
+    __builtin_cpu_init();
+    bool ssse3 = __builtin_cpu_supports("ssse3");
+    bool avx2  = __builtin_cpu_supports("avx2");
+#endif
+
+    return avx2 ? Isa::AVX2 : ssse3 ? Isa::SSSE3 : Isa::Scalar;
+#endif
+}
+
+Isa cpu_isa() {
+    static const Isa isa = detect_isa();
+    return isa;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// x86 builds carry SSSE3/AVX2 kernels next to their scalar versions, and the CPU picks
+// one at run time, so the binary still runs on machines without them
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit SSSE3/AVX2 instructions in functions marked for them; MSVC always does
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET(isa) __attribute__((target(isa)))
+#else
+#define TARGET(isa)
+#endif
+
+enum class Isa { Scalar, SSSE3, AVX2 };
+
+// Best instruction set of this CPU, detected on the first call. Always Scalar off x86
+Isa cpu_isa();
@@ -0,0 +1,148 @@
+#include "stc.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static const std::size_t states = std::size_t(1) << stc_height;
+
+// Columns of the submatrix, bit k of a column feeds message bit i + k. Both have the
+// first and last bit set so that every cover bit reaches its own and the last message bit
+static const std::uint32_t columns[stc_width] = { 0x5f, 0x6d };
+
+static const float unreachable = std::numeric_limits<float>::infinity();
+
+static unsigned int bit(const std::uint8_t *plane, std::size_t i) {
+    return (plane[i / 8] >> (i % 8)) & 1;
+}
+
+// Cover bit visited at every step of the trellis. A stride sharing a factor with the
+// count would skip bits, those calls keep the plain order
+static std::vector<std::uint32_t> visit_order(std::size_t count) {
+    std::size_t stride = count % stc_stride ? stc_stride % count : 1;
+    std::vector<std::uint32_t> order(count);
+
+    for (std::size_t j = 0, at = 0; j < count; j++, at = (at + stride) % count)
+        order[j] = std::uint32_t(at);
+    return order;
+}
+
+// One cover bit: state s is reached either with stego bit 0 from s, or with stego bit 1
+// from s ^ column. Bit s of decisions records which, 1 for the second
+static void step_scalar(const float *in, float *out, std::uint32_t column, float cost0, float cost1,
+                        std::uint8_t *decisions) {
+    std::fill_n(decisions, states / 8, 0);
+    for (std::size_t s = 0; s < states; s++) {
+        float keep = in[s] + cost0, flip = in[s ^ column] + cost1;
+        bool taken = flip < keep;
+        out[s] = taken ? flip : keep;
+        decisions[s / 8] |= std::uint8_t(taken) << (s % 8);
+    }
+}
+
+// Every message bit drops the states whose lowest bit differs from it and moves on to
+// the next one; the new highest bit is not fed by any cover bit yet
+static void shift_scalar(const float *in, float *out, unsigned int message) {
+    for (std::size_t t = 0; t < states / 2; t++)
+        out[t] = in[t * 2 + message];
+    std::fill(out + states / 2, out + states, unreachable);
+}
+
+#ifdef SIMD_X86
+
+// The eight states of a vector differ only in their three lowest bits, so s ^ column
+// is the vector at (s ^ column) / 8 with its lanes permuted by the three lowest bits
+TARGET("avx2") static void step_avx2(const float *in, float *out, std::uint32_t column, float cost0, float cost1,
+                                     std::uint8_t *decisions) {
+    const __m256i lanes = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(column & 7));
+    const __m256 c0 = _mm256_set1_ps(cost0), c1 = _mm256_set1_ps(cost1);
+
+    for (std::size_t v = 0; v < states / 8; v++) {
+        __m256 keep = _mm256_add_ps(_mm256_loadu_ps(in + v * 8), c0);
+        __m256 flip = _mm256_add_ps(_mm256_permutevar8x32_ps(_mm256_loadu_ps(in + (v ^ (column >> 3)) * 8), lanes), c1);
+        __m256 taken = _mm256_cmp_ps(flip, keep, _CMP_LT_OQ);
+
+        _mm256_storeu_ps(out + v * 8, _mm256_min_ps(flip, keep));
+        decisions[v] = std::uint8_t(_mm256_movemask_ps(taken));
+    }
+}
+
+TARGET("avx2") static void shift_avx2(const float *in, float *out, unsigned int message) {
+    const __m256i even = _mm256_add_epi32(_mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6), _mm256_set1_epi32(message));
+
+    for (std::size_t v = 0; v < states / 16; v++) {
+        __m256 low  = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in + v * 16), even);
+        __m256 high = _mm256_permutevar8x32_ps(_mm256_loadu_ps(in + v * 16 + 8), even);
+        _mm256_storeu_ps(out + v * 8, _mm256_blend_ps(low, high, 0xf0));
+    }
+    for (std::size_t v = states / 16; v < states / 8; v++)
+        _mm256_storeu_ps(out + v * 8, _mm256_set1_ps(unreachable));
+}
+
+#endif
+
+void stc_embed(const std::uint8_t *cover, const float *costs, const std::uint8_t *message, std::size_t size,
+               std::uint8_t *stego) {
+    auto step  = step_scalar;
+    auto shift = shift_scalar;
+#ifdef SIMD_X86
+    if (cpu_isa() == Isa::AVX2) {
+        step  = step_avx2;
+        shift = shift_avx2;
+    }
+#endif
+
+    std::size_t bits = size * 8;
+    auto order = visit_order(bits * stc_width);
+    std::vector<float> path(states, unreachable), next(states);
+    std::vector<std::uint8_t> decisions(bits * stc_width * (states / 8));
+    path[0] = 0;
+
+    // Forward pass, keeping the decisions of every cover bit
+    for (std::size_t i = 0; i < bits; i++) {
+        for (std::size_t c = 0; c < stc_width; c++) {
+            std::size_t j = i * stc_width + c;
+            float cost = costs ? costs[order[j]] : 1.0f;
+            bool one = bit(cover, order[j]);
+
+            step(path.data(), next.data(), columns[c], one ? cost : 0, one ? 0 : cost, decisions.data() + j * (states / 8));
+            path.swap(next);
+        }
+
+        shift(path.data(), next.data(), bit(message, i));
+        path.swap(next);
+    }
+
+    // The cheapest end state leads back through the decisions to the stego bits
+    std::size_t s = std::min_element(path.begin(), path.end()) - path.begin();
+    std::fill_n(stego, size * stc_width, 0);
+
+    for (std::size_t i = bits; i-- > 0;) {
+        s = (s << 1) | bit(message, i);
+
+        for (std::size_t c = stc_width; c-- > 0;) {
+            std::size_t j = i * stc_width + c;
+            if ((decisions[j * (states / 8) + s / 8] >> (s % 8)) & 1) {
+                stego[order[j] / 8] |= std::uint8_t(1 << (order[j] % 8));
+                s ^= columns[c];
+            }
+        }
+    }
+}
+
+void stc_extract(const std::uint8_t *stego, std::size_t size, std::uint8_t *message) {
+    auto order = visit_order(size * 8 * stc_width);
+    std::uint32_t state = 0;
+
+    for (std::size_t i = 0; i < size * 8; i++) {
+        for (std::size_t c = 0; c < stc_width; c++)
+            if (bit(stego, order[i * stc_width + c]))
+                state ^= columns[c];
+
+        if (i % 8 == 0)
+            message[i / 8] = 0;
+        message[i / 8] |= std::uint8_t((state & 1) << (i % 8));
+        state >>= 1;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Syndrome-trellis code over the lowest bit plane. Message bit i is the parity of the
+// cover bits visited at steps i * stc_width .. (i + stc_height) * stc_width - 1 selected by a fixed
+// stc_height x stc_width submatrix, which slides one message bit further every
+// stc_width cover bits. The embedder runs the Viterbi algorithm over the 2^stc_height
+// partial syndromes to find the stego bits of least total cost with that syndrome, so
+// it changes far fewer cover bits than plain replacement and prefers cheap ones. The
+// trellis visits the cover bits of a call with a stride of stc_stride, so that the few
+// bits one message bit depends on are spread over the whole call and cheap ones are
+// nearby wherever the costs are high. Planes are packed eight bits to a byte, lowest bit first
+static const unsigned int stc_width  = 2; // Cover bits per message bit
+static const unsigned int stc_height = 7; // Constraint height
+// Prime, so that it steps through all cover bits of a call unless their count is a multiple
+static const std::size_t stc_stride = 2039;
+
+// Picks stego (size * stc_width bytes) closest to cover (as many) such that stc_extract()
+// returns the size bytes of message. Changing cover bit j costs costs[j], or 1 for every
+// bit without costs. One call is one trellis, so calls are independent of each other
+void stc_embed(const std::uint8_t *cover, const float *costs, const std::uint8_t *message, std::size_t size,
+               std::uint8_t *stego);
+
+// Syndrome of size * stc_width bytes of stego bits, size bytes of message
+void stc_extract(const std::uint8_t *stego, std::size_t size, std::uint8_t *message);
@@ -0,0 +1,2899 @@
+#include "stego.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include "aes.hpp"
+#include "archive.hpp"
+#include "sha256.hpp"
+#include "crc32.hpp"
+#include "deflate.hpp"
+#include "erasure.hpp"
+#include "random.hpp"
+#include "image.hpp"
+#include "key_cache.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+// Definisikan versi format file
+#define VERSION 2
+// Bendera header: sematan dikompresi dengan deflate
+#define FLAG_DEFLATE 0x01
+// Bendera header sejak versi 2: sematan adalah arsip beberapa file, lihat archive.hpp
+#define FLAG_ARCHIVE 0x02
+// Bendera header sejak versi 2: sematan adalah satu pecahan dari aliran chunk yang dibagi ke beberapa gambar
+#define FLAG_SHARD 0x04
+// Definisikan jumlah round untuk PBKDF2
+#define KEY_ROUNDS 20000
+// Definisikan tingkat encoding default
+#define LEVEL Image::EncodingLevel::Low
+// Ukuran tile saat memproses data, kelipatan TILE_ALIGN sehingga setiap tile
+// (kecuali yang terakhir) mengisi sejumlah sampel yang utuh di semua tingkat
+#define TILE_ALIGN 240
+#define TILE_SIZE  (TILE_ALIGN * 68)
+// Sejak versi 2 sematan dibagi menjadi chunk berukuran CHUNK_SIZE byte, masing-masing
+// dengan IV sendiri dan diikuti tag HMAC TAG_SIZE byte. Chunk beserta tagnya mengisi
+// kelipatan TILE_ALIGN sehingga setiap chunk dimulai tepat di awal sebuah sampel
+#define TAG_SIZE     16
+#define CHUNK_STORED (TILE_ALIGN * 4369)
+#define CHUNK_SIZE   (CHUNK_STORED - TAG_SIZE)
+
+// Buat alias untuk namespace std::filesystem menjadi fs
+namespace fs = std::filesystem;
+
+// Struktur Header 64 byte untuk menyimpan metadata file yang disematkan
+struct Header {
+    std::uint8_t  sig[4];    // Tanda tangan file (HIDE)
+    std::uint16_t version;   // Versi format
+    std::uint8_t  level;     // Tingkat encoding
+    std::uint8_t  flags;     // Bendera (misalnya, untuk opsi tambahan)
+    std::uint64_t offset;    // Offset ke data yang disematkan dalam gambar
+    std::uint64_t size;      // Ukuran data yang disematkan
+    std::uint32_t hash;      // Hash CRC32 dari data asli, nol sejak versi 2 karena diganti tag per chunk. Pecahan: id set
+    std::uint8_t  name[32];  // Nama file asli, ruang yang tidak digunakan diisi dengan nol
+    std::uint8_t  reserved[4]; // Harus diisi dengan nol untuk kompatibilitas di masa mendatang. Pecahan: indeks, jumlah
+                               // pecahan dan jumlah pecahan data, lalu nol
+};
+// Pastikan ukuran Header adalah 64 byte
+static_assert(sizeof(Header) == 64);
+
+// Header versi 1 dengan offset dan ukuran 32-bit, hanya untuk membaca gambar lama
+struct HeaderV1 {
+    std::uint8_t  sig[4];
+    std::uint16_t version;
+    std::uint8_t  level;
+    std::uint8_t  flags;
+    std::uint32_t offset;
+    std::uint32_t size;
+    std::uint32_t hash;
+    std::uint8_t  name[32];
+    std::uint8_t  reserved[12];
+};
+static_assert(sizeof(HeaderV1) == 64);
+
+// Salt, IV dan Header disematkan di awal gambar dengan tingkat Low
+static const std::size_t PREFIX_SIZE = 16 + 16 + sizeof(Header);
+
+// Letak sebuah pecahan di dalam setnya. Semua pecahan satu set memiliki id yang sama.
+// Jika data lebih kecil dari count, pecahan data diikuti count - data pecahan paritas
+// Reed-Solomon dan data pecahan mana pun cukup untuk membangun ulang sematan
+struct Shard {
+    std::uint32_t set = 0;
+    std::uint8_t index = 0;
+    std::uint8_t count = 0;
+    std::uint8_t data = 0;
+};
+
+static Shard shard_of(const Header &header) {
+    Shard shard;
+    shard.set   = header.hash;
+    shard.index = header.reserved[0];
+    shard.count = header.reserved[1];
+    shard.data  = header.reserved[2];
+    return shard;
+}
+
+static void set_shard(Header &header, const Shard &shard) {
+    header.hash = shard.set;
+    header.reserved[0] = shard.index;
+    header.reserved[1] = shard.count;
+    header.reserved[2] = shard.data;
+    header.reserved[3] = 0;
+}
+
+// Blok data set dengan paritas diakhiri Salt dan IV aliran chunk, lalu ukuran aliran dan
+// "HIDE" yang dienkripsi. Aliran tidak dienkripsi dengan kunci pecahan pertama, yang bisa
+// saja hilang, tetapi dengan kunci dari Salt ini
+static const std::size_t TRAILER_SIZE = 16 + 16 + 16;
+
+static void trailer_block(std::uint64_t size, std::uint8_t *block) {
+    for (int i = 0; i < 8; i++)
+        block[i] = std::uint8_t(size >> (i * 8));
+    std::memcpy(block + 8, "HIDE", 4);
+    std::fill_n(block + 12, 4, 0);
+}
+
+// Sematan sebagai potongan memori yang berurutan, sehingga file arsip tidak perlu disalin
+struct Payload {
+    std::vector<const std::uint8_t *> parts;
+    std::vector<std::size_t> starts; // Awal setiap potongan di dalam sematan
+    std::size_t size = 0;
+
+    void add(const std::uint8_t *data, std::size_t n) {
+        if (!n)
+            return;
+
+        parts.push_back(data);
+        starts.push_back(size);
+        size += n;
+    }
+
+    // Salin n byte mulai dari offset ke out
+    void copy(std::size_t offset, std::size_t n, std::uint8_t *out) const {
+        std::size_t i = std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1;
+
+        while (n) {
+            std::size_t end = i + 1 < parts.size() ? starts[i + 1] : size;
+            std::size_t m = std::min(n, end - offset);
+
+            std::copy_n(parts[i] + (offset - starts[i]), m, out);
+            out    += m;
+            offset += m;
+            n      -= m;
+            i++;
+        }
+    }
+};
+
+// E(kunci, IV), dasar IV setiap chunk. Versi 1 melanjutkan rantai CBC dari header
+static void data_iv(const std::uint8_t *key, const std::uint8_t *iv, std::uint8_t *result) {
+    const std::uint8_t zero[16] = {};
+    AES aes(key, zero);
+    aes.cbc_encrypt(iv, 16, result);
+}
+
+// IV chunk, yaitu E(kunci, IV xor indeks chunk)
+static void chunk_iv(const std::uint8_t *key, const std::uint8_t *iv, std::uint64_t index, std::uint8_t *result) {
+    std::uint8_t block[16];
+    std::copy_n(iv, 16, block);
+    for (int i = 0; i < 8; i++)
+        block[i] ^= std::uint8_t(index >> (i * 8));
+    data_iv(key, block, result);
+}
+
+// Kunci HMAC diturunkan dari kunci AES agar keduanya tidak pernah sama
+static void mac_key(const std::uint8_t *key, std::uint8_t *result) {
+    hmac_sha256("HIDE tag", 8, key, 32, result);
+}
+
+// HMAC sebuah chunk dimulai dengan indeks dan jumlah chunk, sehingga chunk tidak bisa
+// ditukar, dipindah atau dibuang tanpa ketahuan
+static HMAC chunk_mac(const std::uint8_t *mac, std::uint64_t index, std::uint64_t count) {
+    std::uint8_t info[16];
+    for (int i = 0; i < 8; i++) {
+        info[i]     = std::uint8_t(index >> (i * 8));
+        info[8 + i] = std::uint8_t(count >> (i * 8));
+    }
+
+    HMAC hmac(mac, 32);
+    hmac.update(info, sizeof(info));
+    return hmac;
+}
+
+// Array string untuk mengonversi tingkat encoding menjadi representasi string
+const char *level_to_str[5] = {
+    "Low (Default)", // Representasi string untuk tingkat encoding rendah
+    "Medium",        // Representasi string untuk tingkat encoding menengah
+    "High",          // Representasi string untuk tingkat encoding tinggi
+    "STC",           // Representasi string untuk syndrome-trellis coding
+    "Adaptive"       // Representasi string untuk sematan adaptif menurut tekstur
+};
+
+std::array<std::uint8_t, 32> password_hash(const std::string &password) {
+    std::array<std::uint8_t, 32> hash{};
+    SHA256 sha;
+    sha.update(password.data(), password.size());
+    sha.finish();
+    sha.get_hash(hash.data());
+    return hash;
+}
+
+// Satuan pertama pada tingkat level setelah Salt, IV dan Header, yaitu sampel atau slot
+static std::size_t reserved_units(const Image &image, Image::EncodingLevel level) {
+    return image.unit_at(image.encoded_size(PREFIX_SIZE, Image::EncodingLevel::Low), level);
+}
+
+std::size_t capacity(const Image &image, Image::EncodingLevel level) {
+    std::size_t reserved = reserved_units(image, level), units = image.units(level);
+    return image.decoded_size(units > reserved ? units - reserved : 0, level);
+}
+
+// Milidetik sejak start
+static double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Pesan kemajuan hanya dirangkai jika ada logger
+template <typename... Parts> static void note(const StegoLogger &log, const Parts &...parts) {
+    if (!log)
+        return;
+
+    std::ostringstream ss;
+    (ss << ... << parts);
+    log(ss.str());
+}
+
+// Kunci hasil PBKDF2 beserta Salt-nya. Setiap salinan, termasuk yang ada di dalam
+// std::future, dihapus dari memori saat dibuang
+struct DerivedKey {
+    std::uint8_t salt[16];
+    std::uint8_t key[32];
+    double time;
+
+    DerivedKey() = default;
+    DerivedKey(const DerivedKey &) = default;
+    DerivedKey &operator=(const DerivedKey &) = default;
+    ~DerivedKey() { secure_zero(key, sizeof(key)); }
+};
+
+// Jalankan PBKDF2 di thread tersendiri agar berjalan bersamaan dengan memuat gambar dan
+// membaca sematan. Di dalam pekerja pool, atau dengan satu core, tidak ada core yang
+// menganggur, sehingga kunci baru diturunkan saat get() dipanggil. Hanya decode yang
+// memakai cache: encode selalu memakai Salt acak yang baru, jadi kuncinya tidak akan
+// pernah dicari lagi dan hanya akan mendesak kunci decode keluar dari cache
+static std::future<DerivedKey> derive_key(const std::array<std::uint8_t, 32> &password, const std::uint8_t *salt, bool cache) {
+    DerivedKey derived;
+    std::copy_n(salt, sizeof(derived.salt), derived.salt);
+
+    // Kunci yang baru saja diturunkan untuk Salt dan kata sandi yang sama diambil dari cache
+    if (cache && KeyCache::global().get(password.data(), password.size(), derived.salt, sizeof(derived.salt), KEY_ROUNDS,
+                                        derived.key)) {
+        derived.time = 0;
+        std::promise<DerivedKey> ready;
+        ready.set_value(derived);
+        return ready.get_future();
+    }
+
+    bool idle_core = !ThreadPool::current() && std::thread::hardware_concurrency() > 1;
+    auto policy = idle_core ? std::launch::async : std::launch::deferred;
+
+    return std::async(policy, [password, derived, cache]() mutable {
+        auto start = std::chrono::steady_clock::now();
+        pbkdf2_hmac_sha256(password.data(), password.size(), derived.salt, sizeof(derived.salt), derived.key, sizeof(derived.key), KEY_ROUNDS);
+        derived.time = elapsed(start);
+
+        if (cache)
+            KeyCache::global().put(password.data(), password.size(), derived.salt, sizeof(derived.salt), KEY_ROUNDS, derived.key);
+        return derived;
+    });
+}
+
+const char *error_to_str(StegoError error) {
+    switch (error) {
+    case StegoError::None:          return "Berhasil";
+    case StegoError::OpenFile:      return "Tidak dapat membuka file sematan";
+    case StegoError::LoadImage:     return "Gagal memuat gambar";
+    case StegoError::TooLarge:      return "File data terlalu besar";
+    case StegoError::NameTooLong:   return "Nama file lebih dari 32 karakter";
+    case StegoError::Random:        return "Tidak dapat membuat angka acak";
+    case StegoError::SaveImage:     return "Tidak dapat menyimpan gambar";
+    case StegoError::ImageTooSmall: return "Gambar terlalu kecil";
+    case StegoError::InvalidKey:    return "Dekripsi gagal, kunci tidak valid atau file rusak";
+    case StegoError::Version:       return "Versi file tidak didukung";
+    case StegoError::OutOfBounds:   return "Sematan melewati batas gambar, file rusak";
+    case StegoError::Corrupt:       return "File rusak!";
+    case StegoError::SaveFile:      return "Tidak dapat menyimpan file";
+    case StegoError::NoEmbed:       return "Tidak ada sematan di gambar ini";
+    case StegoError::Range:         return "Rentang dimulai setelah akhir sematan";
+    case StegoError::EntryName:     return "Nama entri arsip tidak valid atau tidak ada";
+    case StegoError::NotArchive:    return "Sematan bukan arsip";
+    case StegoError::Shards:        return "Pecahan sematan tidak lengkap atau tidak cocok";
+    case StegoError::Streamed:      return "Tingkat STC dan Adaptive membutuhkan seluruh gambar di memori";
+    }
+
+    return "Kesalahan tidak dikenal";
+}
+
+// Petakan file data ke memori, file kosong tidak perlu dipetakan. Arsip memetakan semua
+// filenya. False jika ada file yang tidak dapat dibuka, yang namanya lalu disalin ke bad
+static bool map_inputs(const EncodeRequest &request, std::vector<MappedFile> &files, std::string &bad) {
+    bool archive = !request.files.empty();
+    files = std::vector<MappedFile>(archive ? request.files.size() : 1);
+
+    for (std::size_t i = 0; i < files.size(); i++) {
+        const auto &path = archive ? request.files[i].path : request.input;
+
+        std::error_code ec;
+        auto file_size = fs::file_size(path, ec);
+        if (ec || (file_size && !files[i].open(path, MappedFile::Mode::Read))) {
+            bad = fs::path(path).filename().string();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Kompres setiap file arsip sendiri-sendiri di semua core, atau hitung CRC32 saja jika
+// deflate tidak menguntungkan. False jika ada nama entri yang tidak valid atau ganda,
+// yang lalu disalin ke bad
+static bool pack_entries(const EncodeRequest &request, const std::vector<MappedFile> &files, std::vector<ArchiveEntry> &entries,
+                         std::vector<std::vector<std::uint8_t>> &packed, std::string &bad) {
+    entries.assign(files.size(), ArchiveEntry{});
+    packed.assign(files.size(), {});
+
+    parallel_for(entries.size(), [&](std::size_t i) {
+        const std::uint8_t *data = files[i].data();
+        auto &entry = entries[i];
+
+        entry.name = request.files[i].name;
+        entry.size = files[i].size();
+
+        if (request.compress && entry.size && !looks_compressed(data, entry.size)) {
+            entry.compressed = deflate_parallel(data, entry.size, packed[i], entry.crc) &&
+                               packed[i].size() < entry.size;
+        }
+
+        if (entry.compressed) {
+            entry.stored_size = packed[i].size();
+        } else {
+            packed[i].clear();
+            packed[i].shrink_to_fit();
+
+            CRC32 crc;
+            crc.update(data, entry.size);
+            entry.crc = crc.get_hash();
+            entry.stored_size = entry.size;
+        }
+    });
+
+    for (auto &entry : entries) {
+        if (!safe_entry_name(entry.name) || entry.name.size() > UINT16_MAX) {
+            bad = entry.name;
+            return false;
+        }
+    }
+
+    std::vector<std::string> names;
+    for (auto &entry : entries)
+        names.push_back(entry.name);
+    std::sort(names.begin(), names.end());
+    auto twice = std::adjacent_find(names.begin(), names.end());
+    if (twice != names.end()) {
+        bad = *twice;
+        return false;
+    }
+
+    return true;
+}
+
+// Sematan yang siap dienkripsi. payload menunjuk ke file yang dipetakan, hasil deflate
+// dan daftar isi arsip di dalamnya
+struct Prepared {
+    std::vector<MappedFile> files;
+    std::vector<std::uint8_t> packed;
+    std::vector<ArchiveEntry> entries;
+    std::vector<std::vector<std::uint8_t>> packed_entries;
+    Payload payload;
+    std::size_t size = 0; // Ukuran asli semua file
+    bool archive = false;
+    bool compressed = false;
+};
+
+// Petakan file data lalu kompres dengan deflate kecuali datanya sudah terkompresi (zip, jpg, ...).
+// Ukuran asli disimpan sebagai 8 byte pertama, dan hasil yang tidak lebih kecil dibuang.
+// File arsip dikompresi masing-masing agar setiap entri bisa diekstrak sendiri. Nama file
+// atau entri yang gagal disalin ke bad
+static StegoError prepare_payload(const EncodeRequest &request, const StegoLogger &log, Prepared &prepared, std::string &bad) {
+    auto &files = prepared.files;
+    auto &packed = prepared.packed;
+    auto &payload = prepared.payload;
+
+    prepared.archive = !request.files.empty();
+    if (!map_inputs(request, files, bad))
+        return StegoError::OpenFile;
+
+    std::size_t size = 0;
+    for (auto &file : files)
+        size += file.size();
+    prepared.size = size;
+
+    if (prepared.archive) {
+        auto &entries = prepared.entries;
+        if (!pack_entries(request, files, entries, prepared.packed_entries, bad))
+            return StegoError::EntryName;
+
+        // Daftar isi di awal sematan, diikuti data setiap entri
+        write_directory(entries, {}, packed);
+
+        payload.add(packed.data(), packed.size());
+        for (std::size_t i = 0; i < entries.size(); i++)
+            payload.add(entries[i].compressed ? prepared.packed_entries[i].data() : files[i].data(), entries[i].stored_size);
+
+        std::size_t deflated = std::count_if(entries.begin(), entries.end(), [](const ArchiveEntry &e) { return e.compressed; });
+        note(log, "Arsip berisi ", entries.size(), " file, ", deflated, " dikompresi dengan deflate");
+        return StegoError::None;
+    }
+
+    auto &file = files[0];
+    std::uint32_t packed_hash = 0; // Tidak disimpan sejak versi 2, tag chunk menggantikannya
+    if (request.compress && !looks_compressed(file.data(), size)) {
+        packed.resize(8);
+        for (int i = 0; i < 8; i++)
+            packed[i] = std::uint64_t(size) >> (i * 8);
+
+        prepared.compressed = deflate_parallel(file.data(), size, packed, packed_hash) && packed.size() < size;
+    }
+
+    if (prepared.compressed)
+        payload.add(packed.data(), packed.size());
+    else
+        payload.add(file.data(), size);
+
+    return StegoError::None;
+}
+
+// Ukuran sematan setelah padding, setidaknya satu byte sampai kelipatan 16 byte
+static std::size_t padded_size(std::size_t size) {
+    return (size / 16 + 1) * 16;
+}
+
+// Ukuran sematan terenkripsi: setiap chunk diikuti tagnya
+static std::size_t encrypted_size(std::size_t padded) {
+    return padded + (padded + CHUNK_SIZE - 1) / CHUNK_SIZE * TAG_SIZE;
+}
+
+// Penerima potongan aliran terenkripsi beserta posisinya di dalam aliran
+using StreamSink = std::function<bool(std::uint64_t, const std::uint8_t *, std::size_t)>;
+
+// Proses setiap chunk per tile dalam satu lintasan: salin dari pemetaan file, beri
+// padding pada tile terakhir (#PKCS7), enkripsi di tempat, perbarui HMAC lalu serahkan
+// ke sink. Tag ditulis bersama tile terakhir dari chunknya. Hanya byte begin sampai
+// sebelum end dari aliran terenkripsi yang diserahkan, chunk di luar rentang dilewati
+static bool encrypt_payload(const Payload &payload, const std::uint8_t *key, const std::uint8_t *iv, std::uint64_t begin,
+                            std::uint64_t end, const StreamSink &sink) {
+    std::size_t payload_size = payload.size;
+    std::size_t padded = padded_size(payload_size);
+    std::size_t chunks = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    std::uint8_t mac[32];
+    mac_key(key, mac);
+
+    std::uint8_t left = padded - payload_size;
+    std::uint8_t tile[TILE_SIZE + TAG_SIZE];
+
+    for (std::size_t chunk = begin / CHUNK_STORED; chunk < chunks && std::uint64_t(chunk) * CHUNK_STORED < end; chunk++) {
+        std::size_t chunk_begin = chunk * CHUNK_SIZE;
+        std::size_t chunk_end   = std::min<std::size_t>(padded, chunk_begin + CHUNK_SIZE);
+
+        std::uint8_t chain[16];
+        chunk_iv(key, iv, chunk, chain);
+        AES aes(key, chain);
+        auto hmac = chunk_mac(mac, chunk, chunks);
+
+        for (std::size_t done = chunk_begin; done < chunk_end; done += TILE_SIZE) {
+            std::size_t n = std::min<std::size_t>(TILE_SIZE, chunk_end - done);
+            std::size_t m = done < payload_size ? std::min(n, payload_size - done) : 0;
+
+            if (m)
+                payload.copy(done, m, tile);
+            std::fill_n(tile + m, n - m, left);
+
+            aes.cbc_encrypt(tile, n, tile);
+            hmac.update(tile, n);
+
+            std::size_t stored = n;
+            if (done + n == chunk_end) {
+                std::uint8_t hash[32];
+                hmac.finish(hash);
+                std::copy_n(hash, TAG_SIZE, tile + n);
+                stored += TAG_SIZE;
+            }
+
+            std::uint64_t at   = done + chunk * TAG_SIZE;
+            std::uint64_t from = std::max(at, begin), to = std::min(at + stored, end);
+            if (from < to && !sink(from, tile + (from - at), to - from))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Enkripsi lalu sematkan langsung ke piksel gambar mulai dari sampel offset; begin harus
+// kelipatan TILE_ALIGN agar setiap potongan dimulai di awal sebuah sampel
+static bool embed_payload(Image &image, const Payload &payload, Image::EncodingLevel level, std::uint64_t offset,
+                          const std::uint8_t *key, const std::uint8_t *iv, std::uint64_t begin = 0,
+                          std::uint64_t end = UINT64_MAX) {
+    return encrypt_payload(payload, key, iv, begin, end, [&](std::uint64_t at, const std::uint8_t *data, std::size_t n) {
+        return image.encode(data, n, level, offset + image.encoded_size(at - begin, level));
+    });
+}
+
+// Enkripsi header dengan kunci dan IV, lalu encode IV dan header setelah Salt
+static bool write_header(Image &image, const Header &header, const std::uint8_t *key, const std::uint8_t *iv) {
+    AES header_aes(key, iv);
+    std::uint8_t encrypted_header[sizeof(Header)];
+    header_aes.cbc_encrypt(&header, sizeof(header), encrypted_header);
+
+    return image.encode(iv, 16, Image::EncodingLevel::Low, image.encoded_size(16, Image::EncodingLevel::Low)) &&
+           image.encode(encrypted_header, sizeof(Header), Image::EncodingLevel::Low, image.encoded_size(32, Image::EncodingLevel::Low));
+}
+
+// Bandingkan sampel yang diganti dengan nilai aslinya, hanya pada baris yang tersentuh
+static void measure_distortion(Image &image, const StegoLogger &log, StegoResult &result) {
+    if (!image.distortion(result.distortion))
+        return;
+
+    note(log, "Kualitas gambar: PSNR ", std::fixed, std::setprecision(2), result.distortion.psnr,
+         " dB, MSE ", std::setprecision(6), result.distortion.mse, ", SSIM ", result.distortion.ssim);
+    for (std::size_t c = 0; c < result.distortion.channels.size(); c++) {
+        auto &channel = result.distortion.channels[c];
+        note(log, "Kanal ", c, ": PSNR ", std::fixed, std::setprecision(2), channel.psnr, " dB, SSIM ",
+             std::setprecision(6), channel.ssim, ", ", channel.histogram_shift, " sampel berpindah bin histogram");
+    }
+}
+
+// Batasi memori gambar yang akan dimuat menurut band_size dari request
+static void limit_bands(Image &image, std::size_t band_size) {
+    if (band_size)
+        image.set_streaming(band_size, band_size);
+}
+
+// Salin sampul ke file baru "<nama>.<acak>.part<ekstensi>" di direktori output. File yang
+// sudah ada tidak pernah ditimpa, nama yang sudah dipakai dicoba lagi dengan angka acak lain.
+// Kosong jika gagal
+static std::string copy_cover(const std::string &cover, const std::string &output) {
+    fs::path path(output);
+    Random random;
+
+    for (int attempt = 0; attempt < 8; attempt++) {
+        std::uint32_t tag;
+        if (!random.get(&tag, sizeof(tag)))
+            break;
+
+        std::ostringstream name;
+        name << path.stem().string() << '.' << std::hex << std::setw(8) << std::setfill('0') << tag << ".part"
+             << path.extension().string();
+        auto copy = (path.parent_path() / name.str()).string();
+
+        std::error_code ec;
+        if (fs::copy_file(cover, copy, fs::copy_options::none, ec))
+            return copy;
+        if (ec != std::errc::file_exists)
+            break;
+    }
+
+    return std::string();
+}
+
+// Simpan gambar ke output. Salinan sampul dari open_cover() hanya ditulis kembali pada
+// halaman yang tersentuh, lalu menggantikan output
+static bool save_cover(Image &image, const std::string &output, const std::string &staging) {
+    if (staging.empty())
+        return image.save(output);
+
+    std::error_code ec;
+    if (!image.save(staging))
+        return false;
+    fs::rename(staging, output, ec);
+    return !ec;
+}
+
+// Salinan sampul dari open_cover() yang tersisa dibuang setelah encode selesai. Setelah
+// berhasil disimpan salinan sudah menjadi output, jadi hanya encode yang gagal meninggalkannya.
+// Harus dibuat sebelum gambarnya, agar salinan sudah tidak dipetakan saat dibuang
+struct CoverCopies {
+    std::vector<std::string> paths;
+
+    ~CoverCopies() {
+        std::error_code ec;
+        for (auto &path : paths)
+            if (!path.empty())
+                fs::remove(path, ec);
+    }
+};
+
+/*
+ * * Encode
+
+ * 1. Inisialisasi:
+ * - Memetakan file yang akan disisipkan ke memori (mmap) dan menghitung ukurannya setelah ditambah 'padding' agar sesuai dengan blok AES.
+ * - Memastikan ukuran data yang sudah di-'padding' tidak melebihi kapasitas gambar.
+
+ * * 2. Membuat Kunci Enkripsi:
+ * - Menghasilkan Salt dan Initialization Vector (IV) acak untuk enkripsi.
+ * - Membuat kunci enkripsi 256-bit yang kuat dari password pengguna menggunakan PBKDF2-HMAC-SHA-256.
+
+ * * 3. Membuat Payload:
+ * - Membentuk sebuah 'struct Header' yang berisi metadata seperti tanda tangan, versi, level encoding, offset data, ukuran, checksum, dan nama file.
+ * - Arsip: setiap file dikompresi sendiri, lalu daftar isi (nama, ukuran, offset, CRC32) diletakkan di awal sematan.
+
+ * * 4. Enkripsi:
+ * - Membagi data menjadi chunk 1 MiB. Setiap chunk diproses per tile dalam satu lintasan: memberi 'padding' pada
+ *   tile terakhir, mengenkripsi dengan AES-256-CBC (IV chunk = E(kunci, IV xor indeks)), menghitung tag HMAC-SHA-256
+ *   dan langsung menyisipkannya ke piksel gambar, diikuti tag chunk tersebut.
+ * - Mengenkripsi Header dengan kunci dan IV yang sudah dibuat.
+
+ * * 5. Penyisipan message yg ingin di-embed kedalam file:
+ * - Menyisipkan Salt, IV, Header terenkripsi, dan data terenkripsi ke dalam piksel gambar menggunakan encoding LSB.
+ * - Menggunakan offset acak untuk menyisipkan blok data utama guna meningkatkan keamanan.
+ * - Menyimpan gambar yang telah dimodifikasi ke lokasi output yang ditentukan.
+ */
+static StegoResult encode_image(Image &image, const EncodeRequest &request, const StegoLogger &log,
+                                std::future<DerivedKey> &pending_key, std::chrono::steady_clock::time_point start) {
+    StegoResult result;
+    result.level   = request.level;
+    result.version = VERSION;
+    result.name    = fs::path(request.input).filename().string();
+    result.output  = request.output;
+
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    auto level = request.level;
+
+    note(log, "Ukuran gambar: ", image.w(), "x", image.h(), " piksel");
+    note(log, "Format gambar: ", image.c(), " kanal, ", image.depth(), " bit");
+    note(log, "Tingkat encoding: ", level_to_str[static_cast<int>(level)]);
+
+    // Trellis memilih bit stego dari bit sampul dan tingkat Adaptive memilih blok dari
+    // tekstur sampul, jadi seluruh gambar harus ada di memori
+    if (Image::needs_memory(level) && image.streamed())
+        return fail(StegoError::Streamed);
+    image.set_stc_cost(request.cost);
+
+    auto process_start = std::chrono::steady_clock::now();
+
+    Prepared prepared;
+    if (auto error = prepare_payload(request, log, prepared, result.name); error != StegoError::None)
+        return fail(error);
+
+    const Payload &payload = prepared.payload;
+    bool archive = prepared.archive, compressed = prepared.compressed;
+    std::size_t size = prepared.size;
+
+    std::size_t payload_size = payload.size;
+
+    std::size_t padded = padded_size(payload_size);
+    std::size_t chunks = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::size_t stored_size = encrypted_size(padded);
+
+    // Temukan ukuran maksimum yang mungkin untuk file, yaitu sampel (atau slot pada
+    // tingkat Adaptive) yang tersisa setelah Salt, IV dan Header
+    std::size_t reserved = reserved_units(image, level), units = image.units(level);
+    std::size_t free_samples = units > reserved ? units - reserved : 0;
+    std::size_t max_size = capacity(image, level);
+
+    result.capacity       = max_size;
+    result.size           = size;
+    result.packed_size    = payload_size;
+    result.encrypted_size = stored_size;
+    result.compressed     = compressed;
+
+    note(log, "Ukuran sematan maks: ", data_size(max_size));
+    note(log, "Ukuran sematan: ", data_size(size));
+    if (compressed)
+        note(log, "Sematan dikompresi dengan deflate menjadi ", data_size(payload_size));
+    else if (archive)
+        note(log, "Ukuran arsip dengan daftar isinya: ", data_size(payload_size));
+    note(log, "Ukuran sematan terenkripsi: ", data_size(stored_size), " dalam ", chunks, " chunk");
+
+    // Pastikan itu tidak terlalu besar
+    if (stored_size > max_size)
+        return fail(StegoError::TooLarge);
+
+    // Pilih offset acak di dalam gambar untuk menyimpan data, sehingga seluruh
+    // data muat di antara akhir Header dan akhir gambar
+    std::uint64_t offset;
+    Random random;
+    if (!random.get(&offset, sizeof(offset)))
+        return fail(StegoError::Random);
+
+    offset = reserved + offset % (free_samples - image.encoded_size(stored_size, level) + 1);
+    result.offset = offset;
+
+    // Salin informasi header
+    Header header;
+    header.sig[0] = 'H'; header.sig[1] = 'I'; header.sig[2] = 'D'; header.sig[3] = 'E';
+    header.version = VERSION;
+    header.level  = static_cast<std::uint8_t>(level);
+    header.flags  = archive ? FLAG_ARCHIVE : compressed ? FLAG_DEFLATE : 0;
+    header.offset = offset;
+    header.size   = stored_size;
+    header.hash   = 0;
+
+    // Salin nama file ke header
+    auto name = result.name;
+    if (name.size() > sizeof(header.name))
+        return fail(StegoError::NameTooLong);
+    std::copy_n(name.data(), name.size(), header.name);
+    std::fill_n(&header.name[name.size()], sizeof(header.name) - name.size(), 0x00);
+    std::fill_n(header.reserved, sizeof(header.reserved), 0x00);
+
+    // Buat IV, Salt sudah dibuat bersama kunci
+    std::uint8_t iv[16];
+    if (!random.get(iv, sizeof iv))
+        return fail(StegoError::Random);
+
+    // Tunggu kunci dari PBKDF2 yang sudah dimulai sebelumnya
+    auto wait_start = std::chrono::steady_clock::now();
+    auto derived = pending_key.get();
+    double waited = elapsed(wait_start);
+
+    const std::uint8_t *key = derived.key;
+    const std::uint8_t *salt = derived.salt;
+    result.key_time = derived.time;
+
+    note(log, "Kunci enkripsi berhasil dibuat dengan PBKDF2-HMAC-SHA-256 (", KEY_ROUNDS, " putaran)");
+
+    // Simpan nilai asli sampel yang akan diganti untuk laporan kualitas
+    image.keep_originals(request.measure);
+
+    if (!embed_payload(image, payload, level, offset, key, iv))
+        return fail(StegoError::TooLarge);
+
+    note(log, "Sematan terenkripsi dengan AES-256-CBC");
+    note(log, "Tag HMAC-SHA-256 berhasil dibuat untuk ", chunks, " chunk");
+
+    // Enkripsi header, lalu encode Salt, IV dan header
+    if (!image.encode(salt, 16, Image::EncodingLevel::Low) || !write_header(image, header, key, iv))
+        return fail(StegoError::TooLarge);
+
+    // Waktu proses tidak termasuk menunggu PBKDF2
+    result.process_time = elapsed(process_start) - waited;
+
+    if (request.measure)
+        measure_distortion(image, log, result);
+    image.keep_originals(false);
+
+    note(log, "Berhasil menyematkan ", name, " ke dalam gambar");
+
+    // Simpan gambar yang telah di-encode
+    auto save_start = std::chrono::steady_clock::now();
+    if (!save_cover(image, request.output, request.staging))
+        return fail(StegoError::SaveImage);
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menulis ke ", request.output);
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+// Jika jalur output kosong, gunakan saja nama file yang disematkan. Di dalam
+// direktori hanya bagian nama filenya, agar tidak keluar dari direktori tersebut
+static std::string output_path(const DecodeRequest &request, const std::string &name) {
+    if (!request.output.empty())
+        return request.output;
+    return request.directory.empty() ? name : (fs::path(request.directory) / fs::path(name).filename()).string();
+}
+
+// Chunk di dalam gambar: ekstraksi, pemeriksaan tag dan dekripsi satu chunk.
+// Aliran chunk sematan biasa berada di satu gambar; pecahan dari beberapa gambar
+// dirangkai berurutan sesuai indeksnya
+struct ChunkReader {
+    // Bagian aliran chunk di dalam satu gambar, mulai dari sampel offset, atau di memori
+    // jika data diisi, misalnya pecahan yang dibangun ulang dari paritas
+    struct Part {
+        Image *image;
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint64_t begin = 0; // Posisi bagian ini di dalam aliran
+        const std::uint8_t *data = nullptr;
+    };
+
+    std::vector<Part> parts;
+    const std::uint8_t *key, *iv;
+    Image::EncodingLevel level;
+    std::uint64_t size = 0; // Ukuran aliran terenkripsi, termasuk tag
+    std::size_t chunks, last_stored;
+    std::uint8_t mac[32];
+
+    ChunkReader(Image &image, const Header &header, const std::uint8_t *key, const std::uint8_t *iv)
+        : ChunkReader({ Part{ &image, header.offset, header.size } }, static_cast<Image::EncodingLevel>(header.level), key, iv) {}
+
+    ChunkReader(std::vector<Part> list, Image::EncodingLevel level, const std::uint8_t *key, const std::uint8_t *iv)
+        : parts(std::move(list)), key(key), iv(iv), level(level) {
+        for (auto &part : parts) {
+            part.begin = size;
+            size += part.size;
+        }
+
+        chunks      = (size + CHUNK_STORED - 1) / CHUNK_STORED;
+        last_stored = size - (chunks - 1) * CHUNK_STORED;
+        mac_key(key, mac);
+    }
+
+    // Chunk terakhir harus memuat tag dan setidaknya satu blok
+    bool valid() const { return size && last_stored >= TAG_SIZE + 16; }
+
+    bool streamed() const {
+        return std::any_of(parts.begin(), parts.end(), [](const Part &part) { return !part.data && part.image->streamed(); });
+    }
+
+    std::size_t stored_size(std::size_t index) const {
+        return index + 1 < chunks ? CHUNK_STORED : last_stored;
+    }
+
+    // Ekstrak n byte aliran mulai dari posisi at, yang bisa melewati batas antar gambar
+    std::unique_ptr<std::uint8_t[]> read(std::uint64_t at, std::size_t n) const {
+        if (parts.size() == 1 && !parts[0].data)
+            return parts[0].image->decode(n, level, parts[0].offset + parts[0].image->encoded_size(at, level));
+
+        auto data = std::make_unique<std::uint8_t[]>(n);
+        for (auto &part : parts) {
+            std::uint64_t from = std::max(at, part.begin);
+            std::uint64_t to   = std::min(at + n, part.begin + part.size);
+            if (from >= to)
+                continue;
+
+            if (part.data) {
+                std::copy_n(part.data + (from - part.begin), to - from, data.get() + (from - at));
+                continue;
+            }
+
+            auto piece = part.image->decode(to - from, level, part.offset + part.image->encoded_size(from - part.begin, level));
+            if (!piece)
+                return nullptr;
+            std::copy_n(piece.get(), to - from, data.get() + (from - at));
+        }
+
+        return data;
+    }
+
+    std::unique_ptr<std::uint8_t[]> extract(std::size_t index) const {
+        return read(std::uint64_t(index) * CHUNK_STORED, stored_size(index));
+    }
+
+    // Periksa tag chunk yang sudah diekstrak
+    bool verify(std::size_t index, const std::uint8_t *data, std::size_t stored) const {
+        std::size_t size = stored - TAG_SIZE;
+
+        std::uint8_t hash[32];
+        auto hmac = chunk_mac(mac, index, chunks);
+        hmac.update(data, size);
+        hmac.finish(hash);
+
+        std::uint8_t diff = 0;
+        for (std::size_t i = 0; i < TAG_SIZE; i++)
+            diff |= hash[i] ^ data[size + i];
+        return !diff;
+    }
+
+    // Dekripsi blok first sampai sebelum end dari chunk ke out. Setiap blok CBC hanya
+    // bergantung pada blok terenkripsi sebelumnya, jadi dekripsi bisa dimulai di mana saja
+    void decrypt(std::size_t index, const std::uint8_t *data, std::size_t first, std::size_t end, std::uint8_t *out) const {
+        std::uint8_t chain[16];
+        if (first)
+            std::copy_n(data + (first - 1) * 16, 16, chain);
+        else
+            chunk_iv(key, iv, index, chain);
+
+        AES aes(key, chain);
+        aes.cbc_decrypt(data + first * 16, (end - first) * 16, out);
+    }
+
+    bool open(std::size_t index, const std::uint8_t *data, std::size_t stored, std::uint8_t *out) const {
+        if (!verify(index, data, stored))
+            return false;
+        decrypt(index, data, 0, (stored - TAG_SIZE) / 16, out);
+        return true;
+    }
+
+    // Ekstrak chunk first sampai sebelum last lalu panggil f(index, data, stored), yang
+    // mengembalikan false untuk berhenti. Gambar yang di-stream dibaca sekali secara
+    // berurutan, gambar lain per chunk dan, jika urutan tidak penting, di semua core.
+    // Mengembalikan indeks chunk pertama yang gagal, atau chunks jika tidak ada. bounds
+    // menandai bahwa chunk itu tidak dapat diekstrak dari gambar
+    std::size_t each(std::size_t first, std::size_t last, bool ordered,
+                     const std::function<bool(std::size_t, const std::uint8_t *, std::size_t)> &f, bool &bounds) {
+        std::atomic<std::size_t> bad(chunks), missing(SIZE_MAX);
+        auto fail_chunk = [&](std::size_t index) {
+            auto current = bad.load();
+            while (index < current && !bad.compare_exchange_weak(current, index))
+                ;
+        };
+
+        if (first >= last) {
+        } else if (streamed()) {
+            // Setiap gambar dibaca sekali secara berurutan. Chunk yang melewati batas antar
+            // gambar dirangkai lebih dulu, chunk lain diteruskan langsung
+            std::size_t index = first;
+            std::uint64_t from = std::uint64_t(first) * CHUNK_STORED;
+            std::uint64_t to   = std::min<std::uint64_t>(size, std::uint64_t(last) * CHUNK_STORED);
+            std::vector<std::uint8_t> joined;
+            bool extracted = true;
+
+            auto take = [&](const std::uint8_t *data, std::size_t n) {
+                while (n) {
+                    std::size_t want = stored_size(index) - joined.size();
+                    const std::uint8_t *chunk = data;
+
+                    if (!joined.empty() || n < want) {
+                        std::size_t m = std::min(n, want);
+                        joined.insert(joined.end(), data, data + m);
+                        data += m;
+                        n    -= m;
+                        if (joined.size() < stored_size(index))
+                            break;
+                        chunk = joined.data();
+                    } else {
+                        data += want;
+                        n    -= want;
+                    }
+
+                    if (!f(index, chunk, stored_size(index))) {
+                        fail_chunk(index);
+                        return false;
+                    }
+                    joined.clear();
+                    index++;
+                }
+                return true;
+            };
+
+            for (auto &part : parts) {
+                std::uint64_t a = std::max(from, part.begin), b = std::min(to, part.begin + part.size);
+                if (a >= b)
+                    continue;
+
+                if (part.data) {
+                    if (!take(part.data + (a - part.begin), b - a))
+                        break;
+                    continue;
+                }
+
+                extracted = part.image->decode(b - a, level, part.offset + part.image->encoded_size(a - part.begin, level),
+                                               CHUNK_STORED, take);
+                if (!extracted)
+                    break;
+            }
+
+            if (!extracted && bad.load() == chunks) {
+                missing = index;
+                fail_chunk(index);
+            }
+        } else if (ordered) {
+            for (std::size_t index = first; index < last; index++) {
+                auto data = extract(index);
+                if (!data)
+                    missing = index;
+                if (!data || !f(index, data.get(), stored_size(index))) {
+                    fail_chunk(index);
+                    break;
+                }
+            }
+        } else {
+            parallel_for(last - first, [&](std::size_t i) {
+                if (bad.load() != chunks)
+                    return;
+
+                auto data = extract(first + i);
+                if (!data)
+                    missing = first + i;
+                if (!data || !f(first + i, data.get(), stored_size(first + i)))
+                    fail_chunk(first + i);
+            });
+        }
+
+        bounds = bad.load() != chunks && bad.load() == missing.load();
+        return bad.load();
+    }
+};
+
+// Kesalahan untuk chunk yang gagal di ChunkReader::each()
+static StegoError chunk_error(const StegoLogger &log, std::size_t index, bool bounds) {
+    if (bounds)
+        return StegoError::OutOfBounds;
+
+    note(log, "Tag chunk ", index, " tidak cocok");
+    return StegoError::Corrupt;
+}
+
+// Buang padding PKCS7 dari chunk terakhir yang sudah didekripsi
+static bool strip_padding(std::vector<std::uint8_t> &last) {
+    std::uint8_t left = last.back();
+    if (!left || left > 16)
+        return false;
+
+    last.resize(last.size() - left);
+    return true;
+}
+
+// Dekripsi byte offset sampai sebelum end dari sematan tanpa kompresi. Hanya chunk yang
+// mencakup rentang yang diekstrak dan diperiksa tagnya, dan hanya blok AES di dalam rentang
+// yang didekripsi. Chunk terakhir hanya dibuka jika rentang mencapainya; end lalu dipotong
+// ke akhir sematan dan size diisi ukurannya, selain itu size tetap 0. Setelah end pasti,
+// prepare(end) dipanggil sekali, lalu sink(posisi, data, n) untuk setiap potongan rentang,
+// dari beberapa thread sekaligus
+using SpanSink = std::function<void(std::uint64_t, const std::uint8_t *, std::size_t)>;
+
+static StegoError read_span(ChunkReader &reader, const StegoLogger &log, std::uint64_t offset, std::uint64_t &end,
+                            std::uint64_t &size, const std::function<bool(std::uint64_t)> &prepare, const SpanSink &sink) {
+    std::size_t chunks = reader.chunks;
+    std::uint64_t last_begin = std::uint64_t(chunks - 1) * CHUNK_SIZE;
+    std::vector<std::uint8_t> last;
+    bool bounds;
+
+    size = 0;
+    if (end > last_begin) {
+        last.resize(reader.last_stored - TAG_SIZE);
+        std::size_t index = reader.each(chunks - 1, chunks, true, [&](std::size_t i, const std::uint8_t *data, std::size_t n) {
+            return reader.open(i, data, n, last.data());
+        }, bounds);
+
+        if (index != chunks)
+            return chunk_error(log, index, bounds);
+        if (!strip_padding(last))
+            return StegoError::Corrupt;
+
+        size = last_begin + last.size();
+        end  = std::min(end, size);
+    }
+
+    if (offset >= end)
+        return StegoError::Range;
+    if (!prepare(end))
+        return StegoError::SaveFile;
+
+    if (end > last_begin) {
+        std::uint64_t from = std::max(offset, last_begin);
+        sink(from, last.data() + (from - last_begin), end - from);
+    }
+
+    std::size_t first = offset / CHUNK_SIZE;
+    std::size_t final = std::min<std::size_t>((end - 1) / CHUNK_SIZE + 1, chunks - 1);
+
+    std::size_t index = reader.each(first, final, false, [&](std::size_t i, const std::uint8_t *data, std::size_t n) {
+        if (!reader.verify(i, data, n))
+            return false;
+
+        std::uint64_t begin = std::uint64_t(i) * CHUNK_SIZE;
+        std::size_t lo = std::max(offset, begin) - begin;
+        std::size_t hi = std::min<std::uint64_t>(end, begin + CHUNK_SIZE) - begin;
+
+        std::vector<std::uint8_t> plain((hi + 15) / 16 * 16 - lo / 16 * 16);
+        reader.decrypt(i, data, lo / 16, (hi + 15) / 16, plain.data());
+        sink(begin + lo, plain.data() + lo % 16, hi - lo);
+        return true;
+    }, bounds);
+
+    return index != chunks ? chunk_error(log, index, bounds) : StegoError::None;
+}
+
+// Decode versi 2. Chunk terakhir dibuka lebih dulu untuk mengetahui padding dan ukuran
+// file, lalu chunk lainnya diekstrak, diperiksa dan didekripsi secara terpisah di semua
+// core. Sematan terkompresi di-inflate ke file output chunk demi chunk menurut urutannya,
+// jadi hanya beberapa chunk yang ada di memori. Tidak ada chunk baru yang dimulai setelah
+// sebuah chunk gagal
+static StegoError decode_chunks(ChunkReader &reader, const DecodeRequest &request, const StegoLogger &log, const Header &header,
+                                StegoResult &result) {
+    auto process_start = std::chrono::steady_clock::now();
+    bool compressed = header.flags & FLAG_DEFLATE;
+
+    if (!reader.valid())
+        return StegoError::Corrupt;
+
+    std::size_t chunks = reader.chunks, last_stored = reader.last_stored;
+
+    // Chunk terakhir berisi padding
+    std::vector<std::uint8_t> last(last_stored - TAG_SIZE);
+    auto last_data = reader.extract(chunks - 1);
+    if (!last_data)
+        return StegoError::OutOfBounds;
+    if (!reader.open(chunks - 1, last_data.get(), last_stored, last.data())) {
+        note(log, "Tag chunk ", chunks - 1, " tidak cocok");
+        return StegoError::Corrupt;
+    }
+
+    std::uint8_t left = last.back();
+    if (!left || left > 16)
+        return StegoError::Corrupt;
+
+    std::size_t size = reader.size - chunks * TAG_SIZE - left;
+    std::size_t last_size = last.size() - left;
+    result.packed_size = size;
+
+    std::string output = output_path(request, result.name);
+    result.output = output;
+
+    MappedFile file;
+    bool created = false;
+    auto discard = [&]() {
+        if (created) {
+            file.close();
+            fs::remove(output);
+        }
+    };
+
+    bool bounds;
+    std::size_t bad;
+    std::size_t output_size = size;
+
+    if (!compressed) {
+        // Sematan tanpa kompresi didekripsi langsung ke file output
+        if (!file.create(output, size))
+            return StegoError::SaveFile;
+        created = true;
+
+        std::copy_n(last.data(), last_size, file.data() + (chunks - 1) * CHUNK_SIZE);
+
+        // Gambar yang di-stream dibaca sekali dari awal, satu chunk setiap kali
+        bad = reader.each(0, chunks - 1, false, [&](std::size_t index, const std::uint8_t *data, std::size_t n) {
+            return reader.open(index, data, n, file.data() + index * CHUNK_SIZE);
+        }, bounds);
+
+        if (bad != chunks) {
+            discard();
+            return chunk_error(log, bad, bounds);
+        }
+
+        note(log, "Tag HMAC-SHA-256 dari ", chunks, " chunk cocok");
+        note(log, "Sematan berhasil didekripsi");
+    } else {
+        // Sematan terkompresi diawali ukuran aslinya (8 byte), dan file output baru dibuat
+        // setelah ukuran itu diketahui. Deflate tidak bisa memampatkan lebih dari ~1032:1,
+        // jadi ukuran yang lebih besar pasti rusak
+        Inflater inflater;
+        std::uint64_t original = 0;
+        std::size_t fed = 0;
+        StegoError error = StegoError::None;
+
+        // Inflate potongan berikutnya dari data yang sudah didekripsi, sesuai urutannya
+        auto feed = [&](const std::uint8_t *data, std::size_t n) {
+            for (; fed < 8 && n; fed++, data++, n--) {
+                original |= std::uint64_t(*data) << (fed * 8);
+                if (fed < 7)
+                    continue;
+
+                if (original > SIZE_MAX || original / 1032 > size) {
+                    error = StegoError::Corrupt;
+                    return false;
+                }
+                output_size = original;
+
+                if (!file.create(output, output_size)) {
+                    error = StegoError::SaveFile;
+                    return false;
+                }
+                created = true;
+
+                if (!inflater.begin(file.data(), output_size)) {
+                    error = StegoError::Corrupt;
+                    return false;
+                }
+            }
+
+            if (n && !inflater.update(data, n)) {
+                error = StegoError::Corrupt;
+                return false;
+            }
+            return true;
+        };
+
+        if (reader.streamed()) {
+            // Gambar yang di-stream dibaca sekali dari awal, jadi chunk datang berurutan
+            std::vector<std::uint8_t> plain(CHUNK_SIZE);
+            bad = reader.each(0, chunks - 1, true, [&](std::size_t index, const std::uint8_t *data, std::size_t n) {
+                return reader.open(index, data, n, plain.data()) && feed(plain.data(), n - TAG_SIZE);
+            }, bounds);
+        } else {
+            // Tag dari jendela beberapa chunk diperiksa dan didekripsi di semua core, lalu
+            // chunk-chunk itu di-inflate berurutan sebelum jendela berikutnya
+            std::size_t window = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 8);
+            std::vector<std::uint8_t> plain(std::min(window, chunks - 1) * CHUNK_SIZE);
+
+            bad = chunks;
+            for (std::size_t first = 0; first + 1 < chunks && bad == chunks; first += window) {
+                std::size_t end = std::min(chunks - 1, first + window);
+                bad = reader.each(first, end, false, [&](std::size_t index, const std::uint8_t *data, std::size_t n) {
+                    return reader.open(index, data, n, plain.data() + (index - first) * CHUNK_SIZE);
+                }, bounds);
+
+                for (std::size_t index = first; index < end && bad == chunks; index++)
+                    if (!feed(plain.data() + (index - first) * CHUNK_SIZE, CHUNK_SIZE))
+                        bad = index;
+            }
+        }
+
+        // Chunk terakhir sudah didekripsi di awal
+        if (bad == chunks && error == StegoError::None) {
+            bool finished = feed(last.data(), last_size) && fed == 8 && inflater.finish();
+            if (!finished && error == StegoError::None)
+                error = StegoError::Corrupt;
+        }
+
+        if (error != StegoError::None || bad != chunks) {
+            discard();
+            return error != StegoError::None ? error : chunk_error(log, bad, bounds);
+        }
+
+        note(log, "Tag HMAC-SHA-256 dari ", chunks, " chunk cocok");
+        note(log, "Sematan berhasil didekripsi dan di-inflate");
+    }
+
+    result.size = output_size;
+    result.process_time = elapsed(process_start);
+
+    note(log, "Ukuran sematan yang didekripsi: ", data_size(output_size));
+
+    // Tulis data
+    auto save_start = std::chrono::steady_clock::now();
+    if (!file.flush(0, output_size))
+        return StegoError::SaveFile;
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menulis ke ", output);
+    return StegoError::None;
+}
+
+// Sematan yang headernya sudah didekripsi, beserta kunci dan IV-nya
+struct Embed {
+    Header header;
+    std::uint8_t key[32];
+    std::uint8_t iv[16];
+    std::uint8_t chain[16]; // Blok terakhir header terenkripsi, awal rantai CBC data versi 1
+};
+
+// Bagian awal decode: ekstrak Salt dan IV, buat kunci, lalu dekripsi dan periksa header
+static StegoError open_embed(Image &image, const DecodeRequest &request, const StegoLogger &log,
+                             std::future<DerivedKey> &pending_key, Embed &embed, StegoResult &result) {
+    note(log, "Ukuran gambar: ", image.w(), "x", image.h(), " piksel");
+    note(log, "Format gambar: ", image.c(), " kanal, ", image.depth(), " bit");
+
+    // Lewati gambar tanpa sematan sebelum PBKDF2, kecuali kunci sudah dimulai
+    if (request.probe && !pending_key.valid() && !probe(image).random)
+        return StegoError::NoEmbed;
+
+    // Ekstrak Salt dan IV
+    auto salt = image.decode(16, Image::EncodingLevel::Low);
+    auto iv   = image.decode(16, Image::EncodingLevel::Low, image.encoded_size(16, Image::EncodingLevel::Low));
+    if (!salt || !iv)
+        return StegoError::ImageTooSmall;
+
+    // Buat kunci, kecuali sudah dimulai dari Salt yang sama saat gambar dimuat
+    if (!pending_key.valid())
+        pending_key = derive_key(request.password, salt.get(), true);
+
+    auto derived = pending_key.get();
+    if (!std::equal(salt.get(), salt.get() + 16, derived.salt))
+        derived = derive_key(request.password, salt.get(), true).get();
+
+    std::copy_n(derived.key, 32, embed.key);
+    std::copy_n(iv.get(), 16, embed.iv);
+    const std::uint8_t *key = embed.key;
+    result.key_time = derived.time;
+
+    note(log, "Kunci dekripsi berhasil dibuat dengan PBKDF2-HMAC-SHA-256 (", KEY_ROUNDS, " putaran)");
+
+    // Ekstrak header
+    auto encrypted_header = image.decode(sizeof(Header), Image::EncodingLevel::Low, image.encoded_size(32, Image::EncodingLevel::Low));
+    if (!encrypted_header)
+        return StegoError::ImageTooSmall;
+
+    // Dekripsi header
+    AES aes(key, iv.get());
+    Header &header = embed.header;
+    aes.cbc_decrypt(encrypted_header.get(), sizeof(Header), &header);
+    std::copy_n(encrypted_header.get() + sizeof(Header) - 16, 16, embed.chain);
+
+    // Pastikan tanda tangan file cocok, yaitu dekripsi berhasil
+    if (header.sig[0] != 'H' || header.sig[1] != 'I' || header.sig[2] != 'D' || header.sig[3] != 'E')
+        return StegoError::InvalidKey;
+
+    // Pastikan versi sudah benar. Selain versi saat ini hanya versi 1 yang pernah ditulis
+    result.version = header.version;
+    if (header.version != 1 && header.version != VERSION)
+        return StegoError::Version;
+
+    // Header versi 1 diubah ke susunan versi 2
+    bool reserved_ok = true;
+    if (header.version == 1) {
+        HeaderV1 old;
+        std::memcpy(&old, &header, sizeof(old));
+
+        header.offset = old.offset;
+        header.size   = old.size;
+        header.hash   = old.hash;
+        std::copy_n(old.name, sizeof(old.name), header.name);
+
+        for (auto r : old.reserved)
+            reserved_ok = reserved_ok && !r;
+    } else if (header.flags & FLAG_SHARD) {
+        auto shard = shard_of(header);
+        reserved_ok = shard.index < shard.count && shard.data && shard.data <= shard.count && !header.reserved[3];
+    } else {
+        for (auto r : header.reserved)
+            reserved_ok = reserved_ok && !r;
+    }
+
+    // Pastikan semua data yang dicadangkan adalah nol dan isi header masuk akal
+    // Versi 1 belum mengenal bendera maupun tingkat STC dan Adaptive. Arsip tidak pernah
+    // dikompresi seluruhnya. Pecahan tidak perlu berakhir di batas chunk, tetapi selalu di
+    // kelipatan 16 byte
+    std::uint8_t flags = header.version == 1 ? 0 : FLAG_DEFLATE | FLAG_ARCHIVE | FLAG_SHARD;
+    std::uint8_t top_level = header.version == 1 ? 2 : 4;
+    if (!reserved_ok || header.level > top_level || (header.flags & ~flags) ||
+        (header.flags & (FLAG_DEFLATE | FLAG_ARCHIVE)) == (FLAG_DEFLATE | FLAG_ARCHIVE) ||
+        !header.size || header.size % 16 || header.size > SIZE_MAX)
+        return StegoError::InvalidKey;
+
+    auto level = static_cast<Image::EncodingLevel>(header.level);
+    bool compressed = header.flags & FLAG_DEFLATE;
+
+    result.level          = level;
+    result.offset         = header.offset;
+    result.encrypted_size = header.size;
+    result.compressed     = compressed;
+
+    note(log, "Header berhasil didekripsi");
+    note(log, "Tanda tangan file cocok");
+
+    // Salin nama, dengan mempertimbangkan bahwa mungkin tidak ada null-terminator
+    std::string name;
+    if (header.name[sizeof(header.name)-1])
+        name = std::string(reinterpret_cast<char*>(header.name), sizeof(header.name));
+    else
+        name = std::string(reinterpret_cast<char*>(header.name));
+    result.name = name;
+
+    note(log, "Terdeteksi sematan ", name);
+    note(log, "Tingkat encoding: ", level_to_str[header.level]);
+
+    // Blok tingkat Adaptive hanya bisa diukur jika seluruh gambar ada di memori
+    if (Image::needs_memory(level) && image.streamed())
+        return StegoError::Streamed;
+
+    // Pastikan sematan berada di dalam gambar
+    std::size_t units = image.units(level);
+    if (header.offset > units || image.encoded_size(header.size, level) > units - header.offset)
+        return StegoError::OutOfBounds;
+
+    note(log, "Ukuran sematan terenkripsi: ", data_size(header.size));
+
+    return StegoError::None;
+}
+
+// Baca dan uraikan daftar isi di awal sematan arsip, biasanya seluruhnya di dalam 64 KiB pertama
+static StegoError read_archive(ChunkReader &reader, const StegoLogger &log, std::vector<ArchiveEntry> &entries,
+                               std::vector<ArchiveSegment> &segments) {
+    std::vector<std::uint8_t> head;
+    std::uint64_t start = 0, end = 64 * 1024, size;
+    auto into_head = [&](std::uint64_t at, const std::uint8_t *data, std::size_t n) {
+        std::copy_n(data, n, head.data() + at);
+    };
+
+    auto error = read_span(reader, log, start, end, size, [&](std::uint64_t n) { head.resize(n); return true; }, into_head);
+    if (error == StegoError::None && head.size() >= 8 && directory_end(head.data()) > head.size()) {
+        start = head.size();
+        end   = directory_end(head.data());
+        if (end > reader.size)
+            return StegoError::Corrupt;
+
+        error = read_span(reader, log, start, end, size, [&](std::uint64_t n) { head.resize(n); return true; }, into_head);
+    }
+
+    if (error != StegoError::None)
+        return error == StegoError::Range ? StegoError::Corrupt : error;
+    if (head.size() < 8 || directory_end(head.data()) > head.size() ||
+        !read_directory(head.data(), directory_end(head.data()), entries, segments))
+        return StegoError::Corrupt;
+
+    return StegoError::None;
+}
+
+// Entri arsip yang diekstrak bersama: setiap kelompok memetakan file outputnya sekaligus
+static const std::size_t ARCHIVE_GROUP = 256;
+
+// Decode arsip: baca daftar isi dari awal sematan, lalu ekstrak entri yang diminta ke
+// direktori output. Chunk yang mencakup entri-entri itu dibuka sekali di semua core dan
+// isinya dibagikan ke file output masing-masing; chunk yang hanya berisi entri lain tidak
+// disentuh. Entri dari pembaruan sebelumnya dibaca dari segmennya dengan IV segmen itu.
+// Entri terkompresi lalu di-inflate dan CRC32 setiap entri diperiksa
+static StegoError decode_archive(ChunkReader &reader, const DecodeRequest &request, const StegoLogger &log, const Embed &embed,
+                                 StegoResult &result) {
+    auto process_start = std::chrono::steady_clock::now();
+
+    if (!reader.valid())
+        return StegoError::Corrupt;
+
+    std::vector<ArchiveSegment> segments;
+    auto error = read_archive(reader, log, result.entries, segments);
+    if (error != StegoError::None)
+        return error;
+
+    auto &entries = result.entries;
+    note(log, "Daftar isi arsip berhasil didekripsi: ", entries.size(), " entri");
+
+    if (request.list)
+        return StegoError::None;
+
+    // Pilih entri yang diminta, urut sesuai segmen dan letaknya di dalam sematan
+    std::vector<std::size_t> selected;
+    if (request.entries.empty()) {
+        for (std::size_t i = 0; i < entries.size(); i++)
+            selected.push_back(i);
+    } else {
+        for (auto &name : request.entries) {
+            auto found = std::find_if(entries.begin(), entries.end(), [&](const ArchiveEntry &e) { return e.name == name; });
+            if (found == entries.end()) {
+                result.name = name;
+                return StegoError::EntryName;
+            }
+            selected.push_back(found - entries.begin());
+        }
+        std::sort(selected.begin(), selected.end());
+        selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+    }
+
+    // Entri dari pembaruan sebelumnya berada di segmennya sendiri
+    std::stable_sort(selected.begin(), selected.end(), [&](std::size_t a, std::size_t b) {
+        return std::make_pair(entries[a].segment, entries[a].offset) < std::make_pair(entries[b].segment, entries[b].offset);
+    });
+
+    for (auto i : selected) {
+        if (!safe_entry_name(entries[i].name)) {
+            result.name = entries[i].name;
+            return StegoError::EntryName;
+        }
+    }
+
+    // Entri ditulis ke output sebagai direktori, atau ke direktori tujuan
+    fs::path base = !request.output.empty() ? fs::path(request.output) :
+                    !request.directory.empty() ? fs::path(request.directory) : fs::path(".");
+    result.output = base.string();
+
+    std::uint64_t total = 0;
+    std::size_t done = 0;
+
+    std::uint64_t size;
+
+    for (std::size_t group = 0, count; group < selected.size(); group += count) {
+        // Setiap kelompok berasal dari satu segmen, yang dibaca dengan IV dan letaknya sendiri
+        std::uint32_t segment = entries[selected[group]].segment;
+        for (count = 1; count < ARCHIVE_GROUP && group + count < selected.size(); count++) {
+            if (entries[selected[group + count]].segment != segment)
+                break;
+        }
+
+        // Segmen lain berasal dari pembaruan sebelumnya, yang hanya ada pada arsip di satu gambar
+        ChunkReader *part_reader = &reader;
+        std::unique_ptr<ChunkReader> segment_reader;
+        if (segment) {
+            if (reader.parts.size() != 1 || !reader.parts[0].image)
+                return StegoError::Corrupt;
+
+            Image &image = *reader.parts[0].image;
+            const auto &source = segments[segment - 1];
+            if (!source.size || source.size % 16 || source.size > SIZE_MAX)
+                return StegoError::Corrupt;
+            std::size_t units = image.units(reader.level);
+            if (source.offset > units || image.encoded_size(source.size, reader.level) > units - source.offset)
+                return StegoError::OutOfBounds;
+
+            std::vector<ChunkReader::Part> part = { { &image, source.offset, source.size } };
+            segment_reader = std::make_unique<ChunkReader>(part, reader.level, embed.key, source.iv);
+            if (!segment_reader->valid())
+                return StegoError::Corrupt;
+            part_reader = segment_reader.get();
+        }
+
+        std::vector<MappedFile> files(count);
+        std::vector<std::vector<std::uint8_t>> packed(count);
+        std::vector<fs::path> paths(count);
+
+        auto remove_group = [&]() {
+            std::error_code ec;
+            for (std::size_t i = 0; i < count; i++) {
+                files[i].close();
+                fs::remove(paths[i], ec);
+            }
+        };
+
+        for (std::size_t i = 0; i < count; i++) {
+            const auto &entry = entries[selected[group + i]];
+            paths[i] = base / fs::path(entry.name);
+
+            std::error_code ec;
+            fs::create_directories(paths[i].parent_path(), ec);
+            if (!files[i].create(paths[i].string(), entry.size)) {
+                result.output = paths[i].string();
+                remove_group();
+                return StegoError::SaveFile;
+            }
+            if (entry.compressed)
+                packed[i].resize(entry.stored_size);
+        }
+
+        // Bagikan data yang didekripsi ke entri yang mencakupnya
+        auto scatter = [&](std::uint64_t at, const std::uint8_t *data, std::size_t n) {
+            std::size_t i = std::upper_bound(selected.begin() + group, selected.begin() + group + count, at,
+                                             [&](std::uint64_t pos, std::size_t e) { return pos < entries[e].offset; }) -
+                            (selected.begin() + group);
+            i = i ? i - 1 : 0;
+
+            for (; i < count; i++) {
+                const auto &entry = entries[selected[group + i]];
+                if (entry.offset >= at + n)
+                    break;
+
+                std::uint64_t from = std::max(at, entry.offset);
+                std::uint64_t to   = std::min(at + n, entry.offset + entry.stored_size);
+                if (from >= to)
+                    continue;
+
+                std::uint8_t *target = entry.compressed ? packed[i].data() : files[i].data();
+                std::copy_n(data + (from - at), to - from, target + (from - entry.offset));
+            }
+        };
+
+        // Entri yang berdekatan dibaca sebagai satu rentang, kecuali di antaranya ada chunk utuh yang tidak dibutuhkan
+        for (std::size_t i = 0; i < count;) {
+            const auto &first = entries[selected[group + i]];
+            std::uint64_t span_start = first.offset, span_end = first.offset + first.stored_size;
+
+            std::size_t j = i + 1;
+            for (; j < count; j++) {
+                const auto &next = entries[selected[group + j]];
+                if (next.offset / CHUNK_SIZE > span_end / CHUNK_SIZE + 1)
+                    break;
+                span_end = next.offset + next.stored_size;
+            }
+            i = j;
+
+            if (span_start == span_end)
+                continue;
+
+            std::uint64_t span = span_end;
+            error = read_span(*part_reader, log, span_start, span, size, [](std::uint64_t) { return true; }, scatter);
+            if (error == StegoError::None && span != span_end)
+                error = StegoError::Corrupt;
+            if (error != StegoError::None) {
+                remove_group();
+                return error == StegoError::Range ? StegoError::Corrupt : error;
+            }
+        }
+
+        // Inflate entri terkompresi dan periksa CRC32 setiap entri
+        std::vector<char> bad(count, 0);
+        parallel_for(count, [&](std::size_t i) {
+            const auto &entry = entries[selected[group + i]];
+
+            if (entry.compressed) {
+                Inflater inflater;
+                if (!inflater.begin(files[i].data(), entry.size) || !inflater.update(packed[i].data(), packed[i].size()) ||
+                    !inflater.finish()) {
+                    bad[i] = 1;
+                    return;
+                }
+                std::vector<std::uint8_t>().swap(packed[i]);
+            }
+
+            CRC32 crc;
+            crc.update(files[i].data(), entry.size);
+            if (crc.get_hash() != entry.crc)
+                bad[i] = 1;
+            else if (!files[i].flush(0, entry.size))
+                bad[i] = 2;
+        });
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (bad[i]) {
+                note(log, "Entri ", entries[selected[group + i]].name, bad[i] == 1 ? " rusak" : " tidak dapat disimpan");
+                result.name   = entries[selected[group + i]].name;
+                result.output = paths[i].string();
+                remove_group();
+                return bad[i] == 1 ? StegoError::Corrupt : StegoError::SaveFile;
+            }
+            total += entries[selected[group + i]].size;
+        }
+
+        done += count;
+    }
+
+    result.size         = total;
+    result.process_time = elapsed(process_start);
+
+    note(log, "Tag HMAC-SHA-256 dan checksum CRC32 dari ", done, " entri cocok");
+    note(log, "Berhasil mengekstrak ", done, " entri (", data_size(total), ") ke ", base.string());
+    return StegoError::None;
+}
+
+// Rangkai pecahan yang headernya sudah didekripsi sesuai indeksnya, atau bangun ulang
+// pecahan data yang hilang dari paritas, lalu decode seperti sematan di satu gambar
+static StegoError decode_set(const std::vector<Image *> &images, const std::vector<Embed> &embeds,
+                             const std::vector<StegoResult> &opened, const std::vector<std::string> &paths,
+                             const DecodeRequest &request, const StegoLogger &log, StegoResult &result) {
+    std::size_t count = images.size();
+
+    // Susun pecahan sesuai indeksnya. Semua gambar harus berasal dari satu set, tanpa yang ganda,
+    // dan setidaknya sebanyak pecahan data; tanpa paritas berarti semua pecahan
+    const Header &first = embeds[0].header;
+    auto set = shard_of(first);
+    bool coded = set.data < set.count;
+    std::vector<std::size_t> order(set.count, SIZE_MAX);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const Header &header = embeds[i].header;
+        auto shard = shard_of(header);
+
+        if (!(header.flags & FLAG_SHARD) || shard.set != set.set || shard.count != set.count || shard.data != set.data ||
+            header.flags != first.flags || header.level != first.level || (coded && header.size != first.size)) {
+            note(log, "Gambar ", paths[i], " bukan pecahan dari set yang sama");
+            return StegoError::Shards;
+        }
+        if (order[shard.index] != SIZE_MAX) {
+            note(log, "Pecahan ", shard.index + 1, " ada di lebih dari satu gambar");
+            return StegoError::Shards;
+        }
+        order[shard.index] = i;
+    }
+
+    if (count < set.data) {
+        note(log, "Set ini memerlukan ", int(set.data), " dari ", int(set.count), " pecahan, tetapi hanya ada ", count, " gambar");
+        return StegoError::Shards;
+    }
+
+    // Nama dan tingkat dari pecahan pertama, atau dari gambar mana pun jika pecahan itu hilang
+    std::size_t head = order[0] != SIZE_MAX ? order[0] : 0;
+    Embed embed = embeds[head];
+    result = opened[head];
+
+    std::vector<ChunkReader::Part> parts;
+    std::vector<std::unique_ptr<std::uint8_t[]>> loaded;
+    std::vector<std::uint8_t> rebuilt;
+
+    if (!coded) {
+        for (auto i : order)
+            parts.push_back({ images[i], embeds[i].header.offset, embeds[i].header.size });
+    } else {
+        // Pecahan data yang ada dipakai lebih dulu, sisanya dari paritas
+        std::size_t data_count = set.data;
+        std::uint64_t block = first.size;
+        auto level = result.level;
+
+        std::vector<std::size_t> chosen, missing;
+        for (std::size_t d = 0; d < data_count; d++) {
+            if (order[d] != SIZE_MAX)
+                chosen.push_back(d);
+            else
+                missing.push_back(d);
+        }
+        for (std::size_t p = data_count; chosen.size() < data_count; p++) {
+            if (order[p] != SIZE_MAX)
+                chosen.push_back(p);
+        }
+
+        // Blok data di memori, atau null untuk yang dibaca langsung dari gambarnya
+        std::vector<const std::uint8_t *> data(data_count, nullptr);
+        const std::uint8_t *trailer;
+        std::unique_ptr<std::uint8_t[]> tail;
+
+        if (missing.empty()) {
+            const Header &last = embeds[order[data_count - 1]].header;
+            Image &image = *images[order[data_count - 1]];
+            tail = image.decode(TILE_ALIGN, level, last.offset + image.encoded_size(block - TILE_ALIGN, level));
+            if (!tail)
+                return StegoError::OutOfBounds;
+            trailer = tail.get() + TILE_ALIGN - TRAILER_SIZE;
+        } else {
+            // Baca blok yang dipilih di semua core, lalu bangun ulang blok data yang hilang per potongan
+            loaded.resize(data_count);
+            parallel_for(data_count, [&](std::size_t r) {
+                std::size_t i = order[chosen[r]];
+                loaded[r] = images[i]->decode(block, level, embeds[i].header.offset);
+            });
+            for (auto &b : loaded) {
+                if (!b)
+                    return StegoError::OutOfBounds;
+            }
+
+            ErasureCode code(data_count, set.count);
+            std::vector<std::uint8_t> inverse;
+            if (!code.solve(chosen, inverse))
+                return StegoError::Shards;
+
+            rebuilt.resize(missing.size() * block);
+            const std::size_t stripe = TILE_SIZE * 16;
+            std::size_t stripes = (block + stripe - 1) / stripe;
+            parallel_for(missing.size() * stripes, [&](std::size_t t) {
+                std::size_t m = t / stripes, from = t % stripes * stripe;
+                std::size_t n = std::min<std::size_t>(stripe, block - from);
+
+                std::vector<const std::uint8_t *> in(data_count);
+                for (std::size_t r = 0; r < data_count; r++)
+                    in[r] = loaded[r].get() + from;
+                code.rebuild(inverse, missing[m], in.data(), rebuilt.data() + m * block + from, n);
+            });
+
+            for (std::size_t r = 0; r < data_count; r++) {
+                if (chosen[r] < data_count)
+                    data[chosen[r]] = loaded[r].get();
+            }
+            for (std::size_t m = 0; m < missing.size(); m++)
+                data[missing[m]] = rebuilt.data() + m * block;
+
+            note(log, "Pecahan data yang hilang: ", missing.size(), ", dibangun ulang dari paritas");
+            trailer = data[data_count - 1] + block - TRAILER_SIZE;
+        }
+
+        // Kunci, IV dan ukuran aliran chunk dari trailer
+        auto derived = derive_key(request.password, trailer, true).get();
+        std::uint8_t size_block[16], expected[16];
+        AES(derived.key, trailer + 16).cbc_decrypt(trailer + 32, 16, size_block);
+
+        std::uint64_t stream_size = 0;
+        for (int i = 0; i < 8; i++)
+            stream_size |= std::uint64_t(size_block[i]) << (i * 8);
+        trailer_block(stream_size, expected);
+
+        if (!std::equal(size_block, size_block + 16, expected) || !stream_size || stream_size % 16 ||
+            stream_size > data_count * block - TRAILER_SIZE) {
+            note(log, "Trailer set pecahan tidak valid");
+            return StegoError::Corrupt;
+        }
+
+        std::copy_n(derived.key, 32, embed.key);
+        std::copy_n(trailer + 16, 16, embed.iv);
+
+        for (std::size_t d = 0; d < data_count; d++) {
+            std::uint64_t begin = d * block;
+            std::uint64_t size  = stream_size > begin ? std::min<std::uint64_t>(block, stream_size - begin) : 0;
+            if (data[d])
+                parts.push_back({ nullptr, 0, size, 0, data[d] });
+            else
+                parts.push_back({ images[order[d]], embeds[order[d]].header.offset, size });
+        }
+    }
+
+    ChunkReader reader(parts, result.level, embed.key, embed.iv);
+    result.encrypted_size = reader.size;
+
+    if (coded)
+        note(log, "Terdeteksi sematan ", result.name, " dalam ", count, " dari ", int(set.count), " pecahan");
+    else
+        note(log, "Terdeteksi sematan ", result.name, " dalam ", count, " pecahan");
+    note(log, "Tingkat encoding: ", level_to_str[embed.header.level]);
+    note(log, "Ukuran sematan terenkripsi: ", data_size(reader.size));
+
+    if (embed.header.flags & FLAG_ARCHIVE)
+        return decode_archive(reader, request, log, embed, result);
+    return decode_chunks(reader, request, log, embed.header, result);
+}
+
+/*
+ * * Decode
+ * 1. Ekstraksi Awal:
+ * - Mengekstrak Salt dan Initialization Vector (IV) dari posisi tetap di dalam gambar.
+ 
+ * * 2. Pembuatan Ulang Kunci:
+ * - Membuat ulang kunci dekripsi dari Salt yang diekstrak dan password pengguna menggunakan PBKDF2-HMAC-SHA-256.
+ 
+ * * 3. Dekripsi & Validasi Header:
+ * - Mengekstrak dan mendekripsi Header terenkripsi dari gambar.
+ * - Memvalidasi Header dengan memeriksa tanda tangan file ('HIDE'), nomor versi, dan field yang dicadangkan.
+ 
+ * * 4. Ekstraksi & Dekripsi Data:
+ * - Setiap chunk diekstrak, diperiksa tag HMAC-nya lalu didekripsi secara terpisah di semua core.
+ *   Decode berhenti pada chunk pertama yang rusak. Arsip membaca daftar isinya lebih dulu lalu hanya membuka
+ *   chunk dari entri yang diminta, di segmen masing-masing jika arsip sudah diperbarui. Versi 1:
+ * - Menggunakan metadata dari Header (ukuran, offset, level encoding) untuk mengekstrak blok data terenkripsi per tile.
+ * - Mendekripsi setiap tile menggunakan AES-256-CBC langsung ke file output dan menghitung 'checksum' CRC32-nya.
+ 
+ * * 5. Verifikasi Akhir (versi 1):
+ * - Membandingkan 'checksum' CRC32 dari data yang telah didekripsi dengan 'checksum' di dalam Header.
+ * - Jika tidak valid, file output dihapus kembali.
+ */
+static StegoResult decode_image(Image &image, const DecodeRequest &request, const StegoLogger &log,
+                                std::future<DerivedKey> &pending_key, std::chrono::steady_clock::time_point start) {
+    StegoResult result;
+
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    Embed embed;
+    auto error = open_embed(image, request, log, pending_key, embed, result);
+    if (error != StegoError::None)
+        return fail(error);
+
+    const Header &header = embed.header;
+    const std::uint8_t *key = embed.key;
+    auto level = result.level;
+    std::string name = result.name;
+
+    // Pecahan hanya bisa dibuka bersama pecahan lain dari setnya, lihat decode_shards(),
+    // kecuali setnya bisa dibangun ulang dari satu gambar mana pun
+    if (header.flags & FLAG_SHARD) {
+        auto shard = shard_of(header);
+        if (shard.data == 1)
+            return fail(decode_set({ &image }, { embed }, { result }, { result.name }, request, log, result));
+
+        note(log, "Sematan ini adalah pecahan ", shard.index + 1, " dari ", int(shard.count), ", decode setidaknya ",
+             int(shard.data), " gambarnya bersama");
+        return fail(StegoError::Shards);
+    }
+
+    if (header.version != 1) {
+        ChunkReader reader(image, header, key, embed.iv);
+        if (header.flags & FLAG_ARCHIVE)
+            error = decode_archive(reader, request, log, embed, result);
+        else
+            error = decode_chunks(reader, request, log, header, result);
+        if (error != StegoError::None)
+            return fail(error);
+
+        result.total_time = elapsed(start);
+        return result;
+    }
+
+    auto process_start = std::chrono::steady_clock::now();
+
+    // Ekstrak dan dekripsi dua blok terakhir lebih dulu untuk mengetahui panjang padding,
+    // sehingga file output bisa langsung dibuat dengan ukuran akhirnya. Ekstraksi dimulai
+    // dari batas TILE_ALIGN agar jatuh tepat di awal sebuah sampel. Rantai CBC data
+    // melanjutkan rantai header
+    std::size_t tail_start = header.size > 32 ? (header.size - 32) / TILE_ALIGN * TILE_ALIGN : 0;
+    std::size_t tail_size  = header.size - tail_start;
+    auto tail = image.decode(tail_size, level, header.offset + image.encoded_size(tail_start, level));
+
+    std::uint8_t last[16];
+    AES tail_aes(key, tail_size >= 32 ? tail.get() + tail_size - 32 : embed.chain);
+    tail_aes.cbc_decrypt(tail.get() + tail_size - 16, sizeof(last), last);
+
+    // Temukan berapa banyak padding yang harus dilepaskan
+    std::uint8_t left = last[15];
+    if (!left || left > 16)
+        return fail(StegoError::Corrupt);
+    std::size_t size = header.size - left;
+    result.packed_size = size;
+    result.size        = size;
+
+    // Jika jalur output kosong, gunakan saja nama file yang disematkan. Di dalam
+    // direktori hanya bagian nama filenya, agar tidak keluar dari direktori tersebut
+    std::string output = output_path(request, name);
+    result.output = output;
+
+    // Buat file output dengan ukuran akhirnya dan petakan ke memori
+    MappedFile file;
+    if (!file.create(output, size))
+        return fail(StegoError::SaveFile);
+
+    // Ekstrak data per tile, lalu dekripsi langsung ke dalam file output sambil
+    // menghitung CRC32. Blok terakhir hanya disalin sebagian, tanpa padding
+    AES aes_data(key, embed.chain);
+    CRC32 crc;
+    std::size_t written = 0;
+
+    bool extracted = image.decode(header.size, level, header.offset, TILE_SIZE, [&](const std::uint8_t *tile, std::size_t n) {
+        std::size_t blocks = std::min(n, (size - written) / 16 * 16);
+
+        aes_data.cbc_decrypt(tile, blocks, file.data() + written);
+        crc.update(file.data() + written, blocks);
+        written += blocks;
+
+        if (blocks < n) {
+            aes_data.cbc_decrypt(tile + blocks, sizeof(last), last);
+            std::copy_n(last, 16 - left, file.data() + written);
+            crc.update(last, 16 - left);
+            written += 16 - left;
+        }
+
+        return true;
+    });
+
+    if (!extracted) {
+        file.close();
+        fs::remove(output);
+        return fail(StegoError::OutOfBounds);
+    }
+
+    note(log, "Sematan berhasil didekripsi");
+    note(log, "Ukuran sematan yang didekripsi: ", data_size(size));
+
+    // Pastikan data cocok, jika tidak hapus file output
+    if (crc.get_hash() != header.hash) {
+        file.close();
+        fs::remove(output);
+        return fail(StegoError::Corrupt);
+    }
+
+    result.process_time = elapsed(process_start);
+
+    note(log, "Checksum CRC32 cocok");
+
+    // Tulis data
+    auto save_start = std::chrono::steady_clock::now();
+    if (!file.flush(0, size))
+        return fail(StegoError::SaveFile);
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menulis ke ", output);
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+// Decode sebagian dari sematan versi 2, lihat read_span(). Aliran deflate tidak bisa dimulai
+// di tengah, jadi sematan terkompresi dibuka dari chunk pertama sampai akhir rentang
+static StegoError decode_span(Image &image, const DecodeRequest &request, const StegoLogger &log, const Embed &embed,
+                              std::uint64_t offset, std::uint64_t length, StegoResult &result) {
+    auto process_start = std::chrono::steady_clock::now();
+    const Header &header = embed.header;
+    bool compressed = header.flags & FLAG_DEFLATE;
+
+    ChunkReader reader(image, header, embed.key, embed.iv);
+    if (!reader.valid())
+        return StegoError::Corrupt;
+
+    std::size_t chunks = reader.chunks;
+    std::uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+
+    MappedFile file;
+    std::string output;
+    std::uint64_t written = 0;
+
+    // Buat file output dengan ukuran rentang. Tanpa output, nama file yang disematkan diberi akhiran rentangnya
+    auto create = [&](std::uint64_t span_end) {
+        std::ostringstream name;
+        name << result.name << "." << offset << "-" << span_end;
+        output = output_path(request, name.str());
+        result.output = output;
+        written = span_end - offset;
+        return file.create(output, written);
+    };
+
+    if (!compressed) {
+        std::uint64_t size;
+        auto error = read_span(reader, log, offset, end, size, create, [&](std::uint64_t at, const std::uint8_t *data, std::size_t n) {
+            std::copy_n(data, n, file.data() + (at - offset));
+        });
+
+        // Ukuran pasti hanya diketahui jika chunk terakhir dibuka
+        if (size)
+            result.size = result.packed_size = size;
+
+        if (error != StegoError::None) {
+            if (!output.empty()) {
+                file.close();
+                fs::remove(output);
+            }
+            return error;
+        }
+
+        note(log, "Tag HMAC-SHA-256 dari ", (end - 1) / CHUNK_SIZE - offset / CHUNK_SIZE + 1, " chunk cocok");
+    } else {
+        // Sematan terkompresi diawali ukuran aslinya (8 byte), lalu di-inflate secara
+        // berurutan sampai akhir rentang
+        std::vector<std::uint8_t> plain, chunk(CHUNK_SIZE);
+        std::uint64_t size = header.size - chunks * TAG_SIZE, original = 0, target = 0;
+        Inflater inflater;
+        bool corrupt = false, range = false, full = false, bounds;
+
+        std::size_t index = reader.each(0, chunks, true, [&](std::size_t i, const std::uint8_t *data, std::size_t n) {
+            chunk.resize(n - TAG_SIZE);
+            if (!reader.open(i, data, n, chunk.data()))
+                return false;
+            if (i + 1 == chunks && !strip_padding(chunk)) {
+                corrupt = true;
+                return false;
+            }
+
+            std::size_t skip = 0;
+            if (i == 0) {
+                for (int b = 0; b < 8 && b < int(chunk.size()); b++)
+                    original |= std::uint64_t(chunk[b]) << (b * 8);
+
+                if (chunk.size() < 8 || original > SIZE_MAX || original / 1032 > size) {
+                    corrupt = true;
+                    return false;
+                }
+
+                result.size = original;
+                if (offset >= original) {
+                    range = true;
+                    return false;
+                }
+
+                target = std::min(end, original);
+                plain.resize(target);
+                if (!inflater.begin(plain.data(), target)) {
+                    corrupt = true;
+                    return false;
+                }
+                skip = 8;
+            }
+
+            // Output yang penuh berarti rentangnya sudah lengkap
+            if (!inflater.update(chunk.data() + skip, chunk.size() - skip) && inflater.size() != target) {
+                corrupt = true;
+                return false;
+            }
+
+            full = inflater.size() == target;
+            return !full;
+        }, bounds);
+
+        if (range)
+            return StegoError::Range;
+        if (corrupt || (index != chunks && !full))
+            return corrupt ? StegoError::Corrupt : chunk_error(log, index, bounds);
+        if (!full && !(inflater.finish() && target == original))
+            return StegoError::Corrupt;
+
+        note(log, "Tag HMAC-SHA-256 dari ", (full ? index + 1 : chunks), " chunk cocok");
+        note(log, "Sematan berhasil di-inflate sampai akhir rentang");
+
+        end = target;
+        if (!create(end))
+            return StegoError::SaveFile;
+        std::copy_n(plain.data() + offset, written, file.data());
+    }
+
+    note(log, "Rentang ", offset, "-", end, " berhasil didekripsi");
+    result.process_time = elapsed(process_start);
+
+    // Tulis data
+    auto save_start = std::chrono::steady_clock::now();
+    if (!file.flush(0, written))
+        return StegoError::SaveFile;
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menulis ", data_size(written), " ke ", output);
+    return StegoError::None;
+}
+
+static StegoResult decode_range_image(Image &image, const DecodeRequest &request, std::uint64_t offset, std::uint64_t length,
+                                      const StegoLogger &log, std::future<DerivedKey> &pending_key,
+                                      std::chrono::steady_clock::time_point start) {
+    StegoResult result;
+
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    Embed embed;
+    auto error = open_embed(image, request, log, pending_key, embed, result);
+    if (error != StegoError::None)
+        return fail(error);
+
+    // Versi 1 merantai seluruh data dalam satu CBC dengan satu CRC32
+    if (embed.header.version == 1) {
+        note(log, "Decode sebagian membutuhkan format versi 2");
+        return fail(StegoError::Version);
+    }
+    if (embed.header.flags & FLAG_SHARD)
+        return fail(StegoError::Shards);
+
+    error = decode_span(image, request, log, embed, offset, length, result);
+    if (error != StegoError::None)
+        return fail(error);
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+/*
+ * * Update
+ * 1. Membuka sematan yang ada seperti decode dan membaca daftar isi arsipnya. Sematan harus arsip versi 2.
+ * 2. Entri dengan nama yang sama diganti. Sematan lama menjadi segmen yang tetap berada di tempatnya; segmen yang
+ *    tidak lagi berisi entri dilepas sehingga ruangnya bisa dipakai lagi.
+ * 3. Hanya file baru yang dikompresi, dienkripsi dengan IV baru dan disematkan, bersama daftar isi baru dengan
+ *    tabel segmen, di offset acak pada ruang kosong di luar Salt, IV, Header dan semua segmen. Tingkat encoding
+ *    mengikuti sematan yang ada.
+ * 4. Terakhir IV dan Header ditulis ulang, jadi sampai saat itu gambar tetap berisi arsip lama yang utuh.
+ *    Biaya pembaruan mengikuti ukuran file baru, bukan ukuran arsip.
+ */
+static StegoResult update_image(Image &image, const EncodeRequest &request, const StegoLogger &log,
+                                std::future<DerivedKey> &pending_key, std::chrono::steady_clock::time_point start) {
+    StegoResult result;
+
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    // Buka sematan yang ada dengan kata sandi yang sama
+    DecodeRequest open_request;
+    open_request.password = request.password;
+
+    Embed embed;
+    auto error = open_embed(image, open_request, log, pending_key, embed, result);
+    result.output = request.output;
+    if (error != StegoError::None)
+        return fail(error);
+
+    const Header &current = embed.header;
+    if (!(current.flags & FLAG_ARCHIVE))
+        return fail(StegoError::NotArchive);
+
+    // Ruang kosong dan segmen hanya dicari di satu gambar
+    if (current.flags & FLAG_SHARD) {
+        note(log, "Arsip yang dipecah ke beberapa gambar tidak dapat diperbarui");
+        return fail(StegoError::Shards);
+    }
+
+    auto process_start = std::chrono::steady_clock::now();
+    auto level = result.level;
+    const std::uint8_t *key = embed.key;
+
+    if (Image::needs_memory(level) && image.streamed())
+        return fail(StegoError::Streamed);
+    image.set_stc_cost(request.cost);
+
+    ChunkReader reader(image, current, key, embed.iv);
+    if (!reader.valid())
+        return fail(StegoError::Corrupt);
+
+    std::vector<ArchiveEntry> entries;
+    std::vector<ArchiveSegment> segments;
+    error = read_archive(reader, log, entries, segments);
+    if (error != StegoError::None)
+        return fail(error);
+
+    note(log, "Daftar isi arsip berhasil didekripsi: ", entries.size(), " entri dalam ", segments.size() + 1, " segmen");
+
+    // Petakan dan kompres hanya file baru
+    std::vector<MappedFile> files;
+    if (!map_inputs(request, files, result.name))
+        return fail(StegoError::OpenFile);
+
+    std::vector<ArchiveEntry> added;
+    std::vector<std::vector<std::uint8_t>> packed_entries;
+    if (!pack_entries(request, files, added, packed_entries, result.name))
+        return fail(StegoError::EntryName);
+
+    // Entri lama dengan nama yang sama diganti
+    std::vector<std::string> names;
+    for (auto &entry : added)
+        names.push_back(entry.name);
+    std::sort(names.begin(), names.end());
+
+    std::vector<ArchiveEntry> kept;
+    for (auto &entry : entries) {
+        if (!std::binary_search(names.begin(), names.end(), entry.name))
+            kept.push_back(entry);
+    }
+    std::size_t replaced = entries.size() - kept.size();
+
+    // Sematan yang ada menjadi segmen. Hanya segmen yang masih berisi entri yang disimpan,
+    // dinomori ulang sesuai urutannya
+    std::vector<char> used(segments.size() + 1, 0);
+    for (auto &entry : kept)
+        used[entry.segment] = 1;
+
+    ArchiveSegment own;
+    own.offset = current.offset;
+    own.size   = current.size;
+    std::copy_n(embed.iv, 16, own.iv);
+
+    std::vector<ArchiveSegment> live;
+    std::vector<std::uint32_t> renumber(used.size(), 0);
+    for (std::size_t i = 0; i < used.size(); i++) {
+        if (!used[i])
+            continue;
+
+        const auto &segment = i ? segments[i - 1] : own;
+        if (segment.offset > image.units(level) || image.encoded_size(segment.size, level) > image.units(level) - segment.offset)
+            return fail(StegoError::OutOfBounds);
+
+        live.push_back(segment);
+        renumber[i] = std::uint32_t(live.size());
+    }
+    for (auto &entry : kept)
+        entry.segment = renumber[entry.segment];
+
+    entries = std::move(kept);
+    entries.insert(entries.end(), added.begin(), added.end());
+
+    // Daftar isi baru di awal sematan baru, diikuti data file baru
+    std::vector<std::uint8_t> directory;
+    if (!write_directory(entries, live, directory))
+        return fail(StegoError::TooLarge);
+
+    Payload payload;
+    payload.add(directory.data(), directory.size());
+
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < added.size(); i++) {
+        const auto &entry = entries[entries.size() - added.size() + i];
+        payload.add(entry.compressed ? packed_entries[i].data() : files[i].data(), entry.stored_size);
+        size += entry.size;
+    }
+
+    std::size_t payload_size = payload.size;
+    std::size_t padded = padded_size(payload_size);
+    std::size_t chunks = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::size_t stored_size = encrypted_size(padded);
+    std::uint64_t needed = image.encoded_size(stored_size, level);
+
+    result.size           = size;
+    result.packed_size    = payload_size;
+    result.encrypted_size = stored_size;
+
+    std::size_t deflated = std::count_if(added.begin(), added.end(), [](const ArchiveEntry &e) { return e.compressed; });
+    note(log, added.size(), " file ditambahkan, ", deflated, " dikompresi dengan deflate, ", replaced, " entri diganti");
+    note(log, "Ukuran sematan baru dengan daftar isinya: ", data_size(payload_size));
+    note(log, "Ukuran sematan terenkripsi: ", data_size(stored_size), " dalam ", chunks, " chunk");
+
+    // Ruang kosong adalah celah di antara Salt, IV dan Header serta segmen yang masih dipakai
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> taken;
+    taken.push_back({ 0, reserved_units(image, level) });
+    for (auto &segment : live)
+        taken.push_back({ segment.offset, segment.offset + image.encoded_size(segment.size, level) });
+    std::sort(taken.begin(), taken.end());
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> gaps;
+    std::uint64_t end = 0, largest = 0, positions = 0;
+    taken.push_back({ image.units(level), image.units(level) });
+    for (auto &range : taken) {
+        if (range.first > end) {
+            std::uint64_t length = range.first - end;
+            largest = std::max(largest, length);
+            if (length >= needed) {
+                gaps.push_back({ end, length });
+                positions += length - needed + 1;
+            }
+        }
+        end = std::max(end, range.second);
+    }
+
+    result.capacity = image.decoded_size(largest, level);
+    note(log, "Ruang kosong terbesar: ", data_size(result.capacity));
+
+    if (!positions)
+        return fail(StegoError::TooLarge);
+
+    // Pilih offset acak di antara semua letak yang muat, dengan peluang yang sama
+    std::uint64_t offset;
+    Random random;
+    if (!random.get(&offset, sizeof(offset)))
+        return fail(StegoError::Random);
+
+    offset %= positions;
+    for (auto &gap : gaps) {
+        if (offset <= gap.second - needed) {
+            offset += gap.first;
+            break;
+        }
+        offset -= gap.second - needed + 1;
+    }
+    result.offset = offset;
+
+    // IV baru untuk sematan baru, Salt dan kunci tetap sama
+    std::uint8_t iv[16];
+    if (!random.get(iv, sizeof iv))
+        return fail(StegoError::Random);
+
+    Header header = current;
+    header.version = VERSION;
+    header.offset  = offset;
+    header.size    = stored_size;
+
+    image.keep_originals(request.measure);
+
+    if (!embed_payload(image, payload, level, offset, key, iv) || !write_header(image, header, key, iv))
+        return fail(StegoError::TooLarge);
+
+    note(log, "Sematan terenkripsi dengan AES-256-CBC");
+    note(log, "Tag HMAC-SHA-256 berhasil dibuat untuk ", chunks, " chunk");
+
+    result.process_time = elapsed(process_start);
+
+    if (request.measure)
+        measure_distortion(image, log, result);
+    image.keep_originals(false);
+
+    result.entries = std::move(entries);
+    note(log, "Arsip berhasil diperbarui, sekarang berisi ", result.entries.size(), " entri dalam ", live.size() + 1, " segmen");
+
+    // Simpan gambar, gambar yang dipetakan hanya menulis halaman yang tersentuh
+    auto save_start = std::chrono::steady_clock::now();
+    if (!save_cover(image, request.output, request.staging))
+        return fail(StegoError::SaveImage);
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menulis ke ", request.output);
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+StegoResult encode(Image &image, const EncodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Salt tidak bergantung pada gambar, sehingga PBKDF2 bisa dimulai paling awal
+    std::uint8_t salt[16];
+    Random random;
+    if (!random.get(salt, sizeof(salt))) {
+        StegoResult result;
+        result.error = StegoError::Random;
+        return result;
+    }
+
+    // Salinan sampul dari open_cover() dibuang jika encode gagal
+    CoverCopies copies{ { request.staging } };
+    auto key = derive_key(request.password, salt, false);
+    return encode_image(image, request, log, key, start);
+}
+
+StegoResult decode(Image &image, const DecodeRequest &request, const StegoLogger &log) {
+    std::future<DerivedKey> key;
+    return decode_image(image, request, log, key, std::chrono::steady_clock::now());
+}
+
+StegoResult decode_range(Image &image, const DecodeRequest &request, std::uint64_t offset, std::uint64_t length,
+                         const StegoLogger &log) {
+    std::future<DerivedKey> key;
+    return decode_range_image(image, request, offset, length, log, key, std::chrono::steady_clock::now());
+}
+
+StegoResult update(Image &image, const EncodeRequest &request, const StegoLogger &log) {
+    CoverCopies copies{ { request.staging } };
+    std::future<DerivedKey> key;
+    return update_image(image, request, log, key, std::chrono::steady_clock::now());
+}
+
+ProbeResult probe(Image &image) {
+    auto prefix = image.decode(PREFIX_SIZE, Image::EncodingLevel::Low);
+    if (!prefix)
+        return ProbeResult{};
+
+    return probe_bits(prefix.get(), PREFIX_SIZE);
+}
+
+bool probe_file(const std::string &path, ProbeResult &result) {
+    Image image;
+    if (!image.load_head(path, PREFIX_SIZE * 8) && !image.load(path))
+        return false;
+
+    result = probe(image);
+    return true;
+}
+
+bool open_cover(Image &image, const std::string &cover, const std::string &output, std::string &staging) {
+    staging.clear();
+
+    if (Image::mappable(cover) && fs::path(output).extension() == fs::path(cover).extension()) {
+        auto copy = copy_cover(cover, output);
+        if (!copy.empty() && image.map(copy)) {
+            staging = copy;
+            return true;
+        }
+
+        std::error_code ec;
+        if (!copy.empty())
+            fs::remove(copy, ec);
+    }
+
+    return image.load(cover);
+}
+
+StegoResult encode_file(const std::string &cover, const EncodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::uint8_t salt[16];
+    Random random;
+    if (!random.get(salt, sizeof(salt))) {
+        StegoResult result;
+        result.error = StegoError::Random;
+        return result;
+    }
+
+    // PBKDF2 berjalan selama sampul dimuat
+    auto key = derive_key(request.password, salt, false);
+
+    EncodeRequest target = request;
+    CoverCopies copies{ { std::string() } };
+    Image image;
+    limit_bands(image, request.band_size);
+    if (!open_cover(image, cover, request.output, copies.paths[0])) {
+        StegoResult result;
+        result.error = StegoError::LoadImage;
+        return result;
+    }
+
+    target.staging = copies.paths[0];
+    return encode_image(image, target, log, key, start);
+}
+
+// Sampul dimuat, disematkan dan disimpan di semua core. Setiap gambar mendapat Salt dan IV
+// sendiri, sehingga gambar-gambar satu set tidak bisa dikaitkan dari LSB-nya; aliran chunk
+// dienkripsi dengan kunci dan IV pecahan pertama
+StegoResult encode_shards(const std::vector<std::string> &covers, const std::vector<std::string> &outputs,
+                          const EncodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    StegoResult result;
+    result.level   = request.level;
+    result.version = VERSION;
+    result.name    = fs::path(request.input).filename().string();
+
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    std::size_t count = covers.size();
+    if (!count || count != outputs.size() || count > ErasureCode::max_blocks || request.parity >= count)
+        return fail(StegoError::Shards);
+    result.output = outputs[0];
+
+    auto level = request.level;
+    std::size_t data_count = count - request.parity;
+    bool coded = request.parity;
+
+    Random random;
+    Shard shard;
+    std::vector<std::array<std::uint8_t, 16>> salts(count), ivs(count);
+    std::uint8_t stream_salt[16], stream_iv[16];
+    bool randomized = random.get(&shard.set, sizeof(shard.set)) && random.get(stream_salt, 16) && random.get(stream_iv, 16);
+    for (std::size_t i = 0; i < count; i++)
+        randomized = randomized && random.get(salts[i].data(), 16) && random.get(ivs[i].data(), 16);
+    if (!randomized)
+        return fail(StegoError::Random);
+
+    // Kunci aliran chunk set dengan paritas diturunkan selama sampul dimuat
+    std::future<DerivedKey> stream_key;
+    if (coded)
+        stream_key = derive_key(request.password, stream_salt, false);
+
+    // Muat sampul dan turunkan kunci setiap gambar di semua core
+    CoverCopies copies{ std::vector<std::string>(count) };
+    std::vector<Image> images(count);
+    std::vector<std::array<std::uint8_t, 32>> keys(count);
+    std::vector<char> loaded(count);
+
+    parallel_for(count, [&](std::size_t i) {
+        limit_bands(images[i], request.band_size);
+        loaded[i] = open_cover(images[i], covers[i], outputs[i], copies.paths[i]);
+
+        auto derived = derive_key(request.password, salts[i].data(), false).get();
+        std::copy_n(derived.key, 32, keys[i].data());
+        if (!i)
+            result.key_time = derived.time;
+    });
+
+    for (std::size_t i = 0; i < count; i++) {
+        if (!loaded[i]) {
+            result.output = covers[i];
+            return fail(StegoError::LoadImage);
+        }
+        if (Image::needs_memory(level) && images[i].streamed()) {
+            result.output = covers[i];
+            return fail(StegoError::Streamed);
+        }
+        images[i].set_stc_cost(request.cost);
+    }
+
+    note(log, "Jumlah gambar sampul: ", count);
+    if (coded)
+        note(log, "Pecahan paritas Reed-Solomon: ", request.parity, ", sematan bisa dibangun ulang dari ", data_count, " gambar mana pun");
+    note(log, "Tingkat encoding: ", level_to_str[static_cast<int>(level)]);
+    note(log, "Kunci enkripsi berhasil dibuat dengan PBKDF2-HMAC-SHA-256 (", KEY_ROUNDS, " putaran)");
+
+    auto process_start = std::chrono::steady_clock::now();
+
+    Prepared prepared;
+    if (auto error = prepare_payload(request, log, prepared, result.name); error != StegoError::None)
+        return fail(error);
+
+    std::size_t payload_size = prepared.payload.size;
+    std::size_t padded = padded_size(payload_size);
+    std::size_t chunks = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::size_t stored_size = encrypted_size(padded);
+
+    // Kapasitas setiap sampul dalam satuan TILE_ALIGN, agar setiap pecahan dimulai di awal sebuah sampel
+    std::vector<std::uint64_t> units(count), share(count);
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        units[i] = capacity(images[i], level) / TILE_ALIGN;
+        total += units[i];
+    }
+    std::uint64_t needed = (stored_size + TILE_ALIGN - 1) / TILE_ALIGN;
+
+    // Dengan paritas semua pecahan sama besar, sehingga sampul terkecil membatasi ukuran
+    // blok dan blok data ditambah trailer harus memuat seluruh aliran
+    std::uint64_t block_units = 0;
+    if (coded) {
+        std::uint64_t smallest = *std::min_element(units.begin(), units.end());
+        block_units = ((stored_size + TRAILER_SIZE + data_count - 1) / data_count + TILE_ALIGN - 1) / TILE_ALIGN;
+        needed = block_units * data_count;
+        total  = smallest * data_count;
+    }
+
+    result.capacity       = total * TILE_ALIGN;
+    result.size           = prepared.size;
+    result.packed_size    = payload_size;
+    result.encrypted_size = stored_size;
+    result.compressed     = prepared.compressed;
+
+    note(log, "Ukuran sematan maks: ", data_size(result.capacity));
+    note(log, "Ukuran sematan: ", data_size(prepared.size));
+    if (prepared.compressed)
+        note(log, "Sematan dikompresi dengan deflate menjadi ", data_size(payload_size));
+    note(log, "Ukuran sematan terenkripsi: ", data_size(stored_size), " dalam ", chunks, " chunk");
+
+    if (needed > total)
+        return fail(StegoError::TooLarge);
+    for (std::size_t i = 0; i < count; i++) {
+        if (!units[i]) {
+            result.output = covers[i];
+            return fail(StegoError::ImageTooSmall);
+        }
+    }
+    if (!coded && needed < count) {
+        note(log, "Sematan terlalu kecil untuk dibagi ke ", count, " gambar");
+        return fail(StegoError::Shards);
+    }
+
+    if (coded) {
+        std::fill(share.begin(), share.end(), block_units);
+    } else {
+        // Bagi sebanding kapasitas dengan setidaknya satu satuan per gambar, lalu ratakan sisa pembulatannya
+        std::uint64_t assigned = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            share[i] = std::clamp<std::uint64_t>(std::uint64_t(double(needed) * units[i] / total), 1, units[i]);
+            assigned += share[i];
+        }
+        for (std::size_t i = 0; assigned < needed; i = (i + 1) % count) {
+            if (share[i] < units[i]) {
+                share[i]++;
+                assigned++;
+            }
+        }
+        for (std::size_t i = 0; assigned > needed; i = (i + 1) % count) {
+            if (share[i] > 1) {
+                share[i]--;
+                assigned--;
+            }
+        }
+    }
+
+    // Header setiap pecahan dengan letak acak di dalam sampulnya
+    auto name = result.name;
+    if (name.size() > sizeof(Header::name))
+        return fail(StegoError::NameTooLong);
+
+    std::vector<Header> headers(count);
+    std::vector<std::uint64_t> begins(count), ends(count);
+    std::uint64_t at = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+        begins[i] = at;
+        ends[i]   = coded ? at + share[i] * TILE_ALIGN : std::min<std::uint64_t>(stored_size, at + share[i] * TILE_ALIGN);
+        at = ends[i];
+
+        std::uint64_t offset;
+        if (!random.get(&offset, sizeof(offset)))
+            return fail(StegoError::Random);
+
+        std::size_t reserved = reserved_units(images[i], level);
+        std::size_t free_samples = images[i].units(level) - reserved;
+        offset = reserved + offset % (free_samples - images[i].encoded_size(ends[i] - begins[i], level) + 1);
+
+        Header &header = headers[i];
+        header.sig[0] = 'H'; header.sig[1] = 'I'; header.sig[2] = 'D'; header.sig[3] = 'E';
+        header.version = VERSION;
+        header.level  = static_cast<std::uint8_t>(level);
+        header.flags  = (prepared.archive ? FLAG_ARCHIVE : prepared.compressed ? FLAG_DEFLATE : 0) | FLAG_SHARD;
+        header.offset = offset;
+        header.size   = ends[i] - begins[i];
+
+        std::copy_n(name.data(), name.size(), header.name);
+        std::fill_n(&header.name[name.size()], sizeof(header.name) - name.size(), 0x00);
+
+        shard.index = std::uint8_t(i);
+        shard.count = std::uint8_t(count);
+        shard.data  = std::uint8_t(data_count);
+        set_shard(headers[i], shard);
+    }
+    result.offset = headers[0].offset;
+
+    // Set dengan paritas: enkripsi aliran ke blok data di memori per chunk di semua core,
+    // isi sisa blok data dengan byte acak dan trailer, lalu hitung blok paritas per potongan
+    std::vector<std::uint8_t> blocks;
+    if (coded) {
+        std::uint64_t block = block_units * TILE_ALIGN;
+        blocks.resize(count * block);
+
+        auto derived = stream_key.get();
+        parallel_for(chunks, [&](std::size_t c) {
+            encrypt_payload(prepared.payload, derived.key, stream_iv, std::uint64_t(c) * CHUNK_STORED,
+                            std::uint64_t(c + 1) * CHUNK_STORED, [&](std::uint64_t at, const std::uint8_t *data, std::size_t n) {
+                std::copy_n(data, n, blocks.data() + at);
+                return true;
+            });
+        });
+
+        std::uint8_t *trailer = blocks.data() + data_count * block - TRAILER_SIZE;
+        if (!random.get(blocks.data() + stored_size, trailer - blocks.data() - stored_size))
+            return fail(StegoError::Random);
+
+        std::uint8_t size_block[16];
+        trailer_block(stored_size, size_block);
+        std::copy_n(stream_salt, 16, trailer);
+        std::copy_n(stream_iv, 16, trailer + 16);
+        AES(derived.key, stream_iv).cbc_encrypt(size_block, 16, trailer + 32);
+
+        ErasureCode code(data_count, count);
+        const std::size_t stripe = TILE_SIZE * 16;
+        parallel_for((block + stripe - 1) / stripe, [&](std::size_t i) {
+            std::size_t from = i * stripe, n = std::min<std::size_t>(stripe, block - from);
+            std::vector<const std::uint8_t *> in(data_count);
+            std::vector<std::uint8_t *> out(count - data_count);
+            for (std::size_t b = 0; b < count; b++) {
+                if (b < data_count)
+                    in[b] = blocks.data() + b * block + from;
+                else
+                    out[b - data_count] = blocks.data() + b * block + from;
+            }
+            code.encode(in.data(), out.data(), n);
+        });
+    }
+
+    // Sematkan setiap pecahan bersama Salt, IV dan Header gambarnya di semua core
+    std::vector<char> embedded(count);
+    parallel_for(count, [&](std::size_t i) {
+        bool stored = coded ? images[i].encode(blocks.data() + begins[i], ends[i] - begins[i], level, headers[i].offset)
+                            : embed_payload(images[i], prepared.payload, level, headers[i].offset, keys[0].data(), ivs[0].data(),
+                                            begins[i], ends[i]);
+        embedded[i] = stored && images[i].encode(salts[i].data(), 16, Image::EncodingLevel::Low) &&
+                      write_header(images[i], headers[i], keys[i].data(), ivs[i].data());
+    });
+
+    if (std::count(embedded.begin(), embedded.end(), 0))
+        return fail(StegoError::TooLarge);
+
+    note(log, "Sematan terenkripsi dengan AES-256-CBC");
+    note(log, "Tag HMAC-SHA-256 berhasil dibuat untuk ", chunks, " chunk");
+    for (std::size_t i = 0; i < count; i++)
+        note(log, i < data_count ? "Pecahan " : "Pecahan paritas ", i + 1, " dari ", count, ": ", data_size(ends[i] - begins[i]),
+             " di ", outputs[i]);
+
+    result.process_time = elapsed(process_start);
+
+    // Simpan semua gambar di semua core
+    auto save_start = std::chrono::steady_clock::now();
+    std::vector<char> saved(count);
+    parallel_for(count, [&](std::size_t i) {
+        saved[i] = save_cover(images[i], outputs[i], copies.paths[i]);
+    });
+
+    for (std::size_t i = 0; i < count; i++) {
+        if (!saved[i]) {
+            result.output = outputs[i];
+            return fail(StegoError::SaveImage);
+        }
+    }
+    result.save_time = elapsed(save_start);
+
+    note(log, "Berhasil menyematkan ", name, " ke dalam ", count, " gambar");
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+// Salt, IV dan Header berada di PREFIX_SIZE * 8 sampel pertama (8-bit, tingkat Low).
+// Baris PNG yang memuatnya di-inflate lebih dulu, lalu PBKDF2 berjalan selama sisa
+// gambar didekode. Gambar yang gagal probe dilewati tanpa didekode seluruhnya
+static StegoError load_embedded(const std::string &path, const DecodeRequest &request, Image &image, std::future<DerivedKey> &key) {
+    Image head;
+    if (head.load_head(path, PREFIX_SIZE * 8)) {
+        if (request.probe && !probe(head).random)
+            return StegoError::NoEmbed;
+
+        auto salt = head.decode(16, Image::EncodingLevel::Low);
+        if (salt)
+            key = derive_key(request.password, salt.get(), true);
+    }
+
+    limit_bands(image, request.band_size);
+    return image.load(path) ? StegoError::None : StegoError::LoadImage;
+}
+
+StegoResult decode_file(const std::string &path, const DecodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::future<DerivedKey> key;
+    Image image;
+    if (auto error = load_embedded(path, request, image, key); error != StegoError::None) {
+        StegoResult result;
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    }
+
+    return decode_image(image, request, log, key, start);
+}
+
+StegoResult decode_range_file(const std::string &path, const DecodeRequest &request, std::uint64_t offset, std::uint64_t length,
+                              const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::future<DerivedKey> key;
+    Image image;
+    if (auto error = load_embedded(path, request, image, key); error != StegoError::None) {
+        StegoResult result;
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    }
+
+    return decode_range_image(image, request, offset, length, log, key, start);
+}
+
+StegoResult update_file(const std::string &path, const EncodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Tanpa output gambar diperbarui di tempat. Gambar yang bisa dipetakan hanya ditambal
+    // pada halaman yang tersentuh; gambar lain, atau output lain, dimuat seperti sampul
+    EncodeRequest target = request;
+    if (target.output.empty())
+        target.output = path;
+
+    std::error_code ec;
+    bool in_place = fs::equivalent(path, target.output, ec);
+
+    std::future<DerivedKey> key;
+    CoverCopies copies{ { std::string() } };
+    Image image;
+    StegoError error = StegoError::None;
+    limit_bands(image, request.band_size);
+    if (!in_place) {
+        if (!open_cover(image, path, target.output, copies.paths[0]))
+            error = StegoError::LoadImage;
+        target.staging = copies.paths[0];
+    } else if (!Image::mappable(path) || !image.map(path)) {
+        DecodeRequest open_request;
+        open_request.password  = request.password;
+        open_request.band_size = request.band_size;
+        error = load_embedded(path, open_request, image, key);
+    }
+
+    if (error != StegoError::None) {
+        StegoResult result;
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    }
+
+    return update_image(image, target, log, key, start);
+}
+
+StegoResult decode_shards(const std::vector<std::string> &paths, const DecodeRequest &request, const StegoLogger &log) {
+    auto start = std::chrono::steady_clock::now();
+    std::size_t count = paths.size();
+
+    // Muat gambar, turunkan kunci dan dekripsi header setiap gambar di semua core
+    std::vector<Image> images(count);
+    std::vector<Embed> embeds(count);
+    std::vector<StegoResult> opened(count);
+    std::vector<StegoError> errors(count, StegoError::None);
+
+    parallel_for(count, [&](std::size_t i) {
+        std::future<DerivedKey> key;
+        errors[i] = load_embedded(paths[i], request, images[i], key);
+        if (errors[i] == StegoError::None)
+            errors[i] = open_embed(images[i], request, nullptr, key, embeds[i], opened[i]);
+    });
+
+    StegoResult result;
+    auto fail = [&](StegoError error) {
+        result.error      = error;
+        result.total_time = elapsed(start);
+        return result;
+    };
+
+    if (!count)
+        return fail(StegoError::Shards);
+
+    for (std::size_t i = 0; i < count; i++) {
+        if (errors[i] != StegoError::None) {
+            note(log, "Gambar ", paths[i], ": ", error_to_str(errors[i]));
+            result = opened[i];
+            result.output = paths[i];
+            return fail(errors[i]);
+        }
+    }
+
+    std::vector<Image *> pointers;
+    for (auto &image : images)
+        pointers.push_back(&image);
+
+    if (auto error = decode_set(pointers, embeds, opened, paths, request, log, result); error != StegoError::None)
+        return fail(error);
+
+    result.total_time = elapsed(start);
+    return result;
+}
+
+// Logger untuk bentuk lama, tanpa flush per baris
+static void print(const std::string &message) {
+    std::cout << "* " << message << '\n';
+}
+
+std::string describe_error(const StegoResult &result) {
+    std::ostringstream ss;
+
+    switch (result.error) {
+    case StegoError::OpenFile:
+    case StegoError::EntryName:
+        ss << error_to_str(result.error) << " '" << result.name << "'";
+        break;
+    case StegoError::NameTooLong:
+        ss << "Nama file '" << result.name << "' lebih dari 32 karakter";
+        break;
+    case StegoError::TooLarge:
+        ss << "File data terlalu besar, ukuran maksimum yang mungkin: " << (result.capacity / 1024) << " KiB";
+        break;
+    case StegoError::Version:
+        ss << error_to_str(result.error) << " " << result.version;
+        break;
+    case StegoError::Range:
+        ss << error_to_str(result.error) << ", ukuran sematan " << result.size << " byte";
+        break;
+    case StegoError::SaveImage:
+    case StegoError::SaveFile:
+        ss << error_to_str(result.error) << " '" << result.output << "'";
+        break;
+    default:
+        ss << error_to_str(result.error);
+        break;
+    }
+
+    return ss.str();
+}
+
+int encode(Image &image, const std::array<std::uint8_t, 32> &password, const std::string &input, const std::string &output,
+           Image::EncodingLevel level, const std::string &staging) {
+    EncodeRequest request;
+    request.password = password;
+    request.input    = input;
+    request.output   = output;
+    request.level    = level;
+    request.staging  = staging;
+    auto result = encode(image, request, print);
+    std::cout.flush();
+
+    if (!result) {
+        std::cerr << "ERROR: " << describe_error(result) << std::endl;
+        return -1;
+    }
+
+    return 1;
+}
+
+int decode(Image &image, const std::array<std::uint8_t, 32> &password, std::string output) {
+    DecodeRequest request;
+    request.password = password;
+    request.output   = output;
+    auto result = decode(image, request, print);
+    std::cout.flush();
+
+    if (!result) {
+        std::cerr << "ERROR: " << describe_error(result) << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
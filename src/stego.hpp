@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "archive.hpp"
+#include "distortion.hpp"
+#include "image.hpp"
+#include "lsb_probe.hpp"
+
+// Langkah encode dan decode yang dipakai bersama oleh GUI dan antarmuka baris perintah
+
+// Kode kesalahan dari encode dan decode
+enum class StegoError {
+    None = 0,
+    OpenFile,       // File sematan tidak dapat dibuka
+    LoadImage,      // Gambar tidak dapat dimuat
+    TooLarge,       // Sematan tidak muat di dalam gambar
+    NameTooLong,    // Nama file sematan lebih dari 32 karakter
+    Random,         // Tidak dapat membuat angka acak
+    SaveImage,      // Gambar output tidak dapat disimpan
+    ImageTooSmall,  // Gambar terlalu kecil untuk Salt, IV dan Header
+    InvalidKey,     // Dekripsi header gagal, kunci tidak valid atau tidak ada sematan
+    Version,        // Versi format tidak didukung
+    OutOfBounds,    // Sematan melewati batas gambar
+    Corrupt,        // Padding, data terkompresi atau CRC32 tidak cocok
+    SaveFile,       // File output tidak dapat disimpan
+    NoEmbed,        // LSB Salt, IV dan Header tidak tampak acak, gambar tidak berisi sematan
+    Range,          // Awal rentang decode_range() melewati akhir file yang disematkan
+    EntryName,      // Nama entri arsip tidak valid, atau entri yang diminta tidak ada di arsip
+    NotArchive,     // update() hanya bisa menambah file ke sematan arsip
+    Shards,         // Pecahan dari encode_shards() tidak lengkap, ganda atau berasal dari set lain
+    Streamed,       // Tingkat STC dan Adaptive tidak dapat dipakai pada gambar yang di-stream
+};
+
+// File di dalam arsip beserta nama entrinya, jalur relatif dengan pemisah '/'
+struct ArchiveFile {
+    std::string path;
+    std::string name;
+};
+
+struct EncodeRequest {
+    std::array<std::uint8_t, 32> password; // Hash kata sandi, lihat password_hash()
+    std::string input;                     // File yang akan disematkan, atau nama arsip jika files tidak kosong
+    std::string output;                    // Gambar output
+    Image::EncodingLevel level = Image::EncodingLevel::Low;
+    bool measure = false;                  // Hitung PSNR, SSIM dan pergeseran histogram, lihat Distortion
+    bool compress = true;                  // Deflate jika menguntungkan. Tanpa kompresi decode_range() bisa melompat ke rentangnya
+    std::vector<ArchiveFile> files;        // Sematkan file-file ini sebagai arsip, setiap entri dikompresi sendiri.
+                                           // Untuk update(), file yang ditambahkan atau diganti
+    std::size_t parity = 0;                // encode_shards(): jumlah sampul yang mendapat pecahan paritas
+    Image::StcCost cost = Image::StcCost::Texture; // Tingkat STC: biaya mengubah sampel, lihat Image::StcCost
+    std::string staging;                   // encode() dan update(): salinan sampul dari open_cover() yang dipetakan gambar
+    std::size_t band_size = 0;             // Fungsi *_file dan *_shards: PNG yang pikselnya melebihi band_size byte
+                                           // di-stream dalam pita sebesar itu, 0 memakai bawaan Image::set_streaming()
+};
+
+struct DecodeRequest {
+    std::array<std::uint8_t, 32> password; // Hash kata sandi, lihat password_hash()
+    std::string output;                    // File output, kosong berarti nama file yang disematkan
+    std::string directory;                 // Tempat nama file yang disematkan jika output kosong
+    bool probe = false;                    // Uji LSB awal sebelum PBKDF2, lihat probe()
+    std::vector<std::string> entries;      // Arsip: hanya entri ini yang diekstrak, kosong berarti semua
+    bool list = false;                     // Arsip: hanya baca daftar isinya ke StegoResult::entries
+    std::size_t band_size = 0;             // Seperti EncodeRequest::band_size
+};
+
+// Hasil encode atau decode. Ukuran dalam byte, waktu dalam milidetik
+struct StegoResult {
+    StegoError error = StegoError::None;
+
+    std::string name;                // Nama file yang disematkan
+    std::string output;              // Jalur yang ditulis
+    Image::EncodingLevel level = Image::EncodingLevel::Low;
+    unsigned int version   = 0;      // Versi format header
+
+    std::uint64_t offset   = 0;      // Sampel pertama dari data terenkripsi
+    std::size_t capacity   = 0;      // Ukuran sematan terenkripsi maksimum (hanya encode)
+    std::size_t size       = 0;      // Ukuran file asli
+    std::size_t packed_size    = 0;  // Ukuran setelah deflate, sama dengan size jika tidak dikompresi
+    std::size_t encrypted_size = 0;  // Ukuran setelah padding dan enkripsi
+    bool compressed = false;
+
+    Distortion distortion;           // Hanya encode dengan measure, dan bukan gambar yang di-stream
+    std::vector<ArchiveEntry> entries; // Daftar isi arsip (decode dan update)
+
+    double key_time     = 0;         // PBKDF2
+    double process_time = 0;         // Kompresi, enkripsi dan penyematan, atau kebalikannya
+    double save_time    = 0;         // Menyimpan gambar atau file output
+    double total_time   = 0;
+
+    explicit operator bool() const { return error == StegoError::None; }
+};
+
+// Menerima pesan kemajuan, satu baris per panggilan tanpa baris baru
+using StegoLogger = std::function<void(const std::string &)>;
+
+// Sematkan file input ke dalam gambar lalu simpan gambar ke output
+StegoResult encode(Image &image, const EncodeRequest &request, const StegoLogger &log = nullptr);
+// Ekstrak sematan dari gambar ke file output
+StegoResult decode(Image &image, const DecodeRequest &request, const StegoLogger &log = nullptr);
+
+// Seperti di atas, tetapi gambar dimuat sendiri sementara PBKDF2 berjalan di thread lain.
+// encode_file menyalin sampul yang bisa dipetakan ke output lalu menambalnya lewat mmap;
+// decode_file menurunkan kunci begitu baris pertama PNG yang memuat Salt selesai di-inflate
+StegoResult encode_file(const std::string &cover, const EncodeRequest &request, const StegoLogger &log = nullptr);
+StegoResult decode_file(const std::string &path, const DecodeRequest &request, const StegoLogger &log = nullptr);
+
+// Ekstrak hanya byte offset sampai offset + length dari file yang disematkan (format versi 2).
+// Hanya chunk yang mencakup rentang yang diekstrak dan diperiksa tagnya, sehingga biayanya
+// mengikuti panjang rentang; sematan terkompresi harus di-inflate dari awal sampai akhir
+// rentang. Rentang yang melewati akhir file dipotong. Tanpa output, file ditulis dengan
+// nama file yang disematkan ditambah akhiran ".awal-akhir"
+StegoResult decode_range(Image &image, const DecodeRequest &request, std::uint64_t offset, std::uint64_t length,
+                         const StegoLogger &log = nullptr);
+StegoResult decode_range_file(const std::string &path, const DecodeRequest &request, std::uint64_t offset, std::uint64_t length,
+                              const StegoLogger &log = nullptr);
+
+// Tambahkan atau ganti file di arsip yang sudah disematkan. Hanya file baru dan daftar isi
+// baru yang dienkripsi dan disematkan di ruang kosong gambar, lalu IV dan Header ditulis
+// ulang; entri lama tetap di tempatnya. Tingkat encoding mengikuti sematan yang ada.
+// update_file tanpa output memperbarui gambar di tempat, dan gambar yang bisa dipetakan
+// hanya ditulis pada halaman yang tersentuh
+StegoResult update(Image &image, const EncodeRequest &request, const StegoLogger &log = nullptr);
+StegoResult update_file(const std::string &path, const EncodeRequest &request, const StegoLogger &log = nullptr);
+
+// Bagi sematan ke beberapa gambar, misalnya jika tidak muat di satu sampul. Aliran chunk
+// terenkripsi dipotong sebanding kapasitas setiap sampul, dan setiap gambar mendapat
+// Header dengan id set, indeks dan jumlah pecahan. outputs berpasangan dengan covers,
+// EncodeRequest::output diabaikan. decode_shards merangkai kembali pecahan dari gambar
+// dalam urutan apa pun; kedua arah memproses semua gambar di semua core.
+//
+// Dengan EncodeRequest::parity, aliran dipotong sama besar ke covers.size() - parity
+// gambar dan sisanya mendapat pecahan paritas Reed-Solomon, lihat erasure.hpp. Gambar
+// mana pun yang hilang, selama yang tersisa sebanyak pecahan data, decode_shards
+// membangun ulang sematan dari gambar-gambar itu. Set terdiri dari paling banyak 255 gambar
+StegoResult encode_shards(const std::vector<std::string> &covers, const std::vector<std::string> &outputs,
+                          const EncodeRequest &request, const StegoLogger &log = nullptr);
+StegoResult decode_shards(const std::vector<std::string> &paths, const DecodeRequest &request, const StegoLogger &log = nullptr);
+
+// Uji keacakan LSB yang memuat Salt, IV dan Header. Data terenkripsi selalu lolos, jadi
+// gambar yang gagal pasti tidak berisi sematan dan tidak perlu melalui PBKDF2. Jendela
+// piksel lain tidak diuji: letak dan panjang data baru diketahui dari header, sehingga
+// jendela yang tidak acak tidak membuktikan apa pun. Uji 768 bit ini juga tidak memakai
+// SIMD, biayanya adalah dekode baris PNG pertama
+ProbeResult probe(Image &image);
+// Seperti di atas, tetapi hanya baris PNG pertama yang didekode. False jika gambar tidak dapat dimuat
+bool probe_file(const std::string &path, ProbeResult &result);
+
+// Muat gambar sampul untuk encode ke output. Gambar tanpa kompresi disalin ke file baru
+// "<nama>.<acak>.part<ekstensi>" di samping output, yang tidak menimpa file apa pun, dan
+// salinannya dipetakan; jalurnya dikembalikan di staging. Gambar lain dimuat ke memori dan
+// staging kosong. Dengan EncodeRequest::staging, encode() mengganti output dengan salinan
+// itu hanya setelah berhasil disimpan, dan membuangnya jika gagal
+bool open_cover(Image &image, const std::string &cover, const std::string &output, std::string &staging);
+
+// Bentuk lama yang mencetak kemajuan ke stdout dan kesalahan ke stderr.
+// Keduanya mengembalikan nilai negatif jika gagal. staging seperti EncodeRequest::staging
+int encode(Image &image, const std::array<std::uint8_t, 32> &password, const std::string &input, const std::string &output,
+           Image::EncodingLevel level, const std::string &staging = std::string());
+int decode(Image &image, const std::array<std::uint8_t, 32> &password, std::string output);
+
+// Pesan kesalahan yang dapat dibaca manusia
+const char *error_to_str(StegoError error);
+// Pesan kesalahan dengan detail dari hasil, seperti ukuran maksimum atau jalur
+std::string describe_error(const StegoResult &result);
+
+// Hash SHA256 dari kata sandi, yang menjadi masukan PBKDF2
+std::array<std::uint8_t, 32> password_hash(const std::string &password);
+
+// Ukuran sematan maksimum (setelah padding) pada tingkat encoding tersebut
+std::size_t capacity(const Image &image, Image::EncodingLevel level);
+
+// Representasi string dari tingkat encoding
+extern const char *level_to_str[5];
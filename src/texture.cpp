@@ -0,0 +1,48 @@
+#include "texture.hpp"
+#include "simd.hpp"
+
+#include <cstdlib>
+
+static void gradient_scalar(const std::uint8_t *row, const std::uint8_t *left, const std::uint8_t *up, std::size_t n,
+                            std::uint32_t *groups) {
+    for (std::size_t i = 0; i < n; i++)
+        groups[i / 8] += std::abs(row[i] - left[i]) + std::abs(row[i] - up[i]);
+}
+
+#ifdef SIMD_X86
+
+// Saturating differences both ways give the absolute difference, which stays below 256
+// for the sum of two. sad_epu8 then adds up each eight bytes into a 64-bit lane
+TARGET("avx2") static void gradient_avx2(const std::uint8_t *row, const std::uint8_t *left, const std::uint8_t *up,
+                                         std::size_t n, std::uint32_t *groups) {
+    const __m256i zero = _mm256_setzero_si256();
+    std::size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + i));
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(up + i));
+
+        __m256i dl = _mm256_or_si256(_mm256_subs_epu8(c, l), _mm256_subs_epu8(l, c));
+        __m256i du = _mm256_or_si256(_mm256_subs_epu8(c, u), _mm256_subs_epu8(u, c));
+        __m256i sums = _mm256_sad_epu8(_mm256_add_epi8(dl, du), zero);
+
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sums);
+        for (std::size_t k = 0; k < 4; k++)
+            groups[i / 8 + k] += std::uint32_t(lanes[k]);
+    }
+
+    gradient_scalar(row + i, left + i, up + i, n - i, groups + i / 8);
+}
+
+#endif
+
+void gradient_sums(const std::uint8_t *row, const std::uint8_t *left, const std::uint8_t *up, std::size_t n,
+                   std::uint32_t *groups) {
+#ifdef SIMD_X86
+    if (cpu_isa() == Isa::AVX2)
+        return gradient_avx2(row, left, up, n, groups);
+#endif
+    gradient_scalar(row, left, up, n, groups);
+}
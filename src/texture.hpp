@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Adds |row[i] - left[i]| + |row[i] - up[i]| of the n samples of a row to groups[i / 8],
+// so that every group holds the gradient of eight consecutive samples. Samples are 8-bit
+// values below 128, left and up hold the neighbour every sample is compared with
+void gradient_sums(const std::uint8_t *row, const std::uint8_t *left, const std::uint8_t *up, std::size_t n,
+                   std::uint32_t *groups);
@@ -0,0 +1,141 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local std::size_t current_index = 0;
+
+ThreadPool::ThreadPool(std::size_t threads) : queued(0), pending(0), next(0), stopping(false) {
+    if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < threads; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (std::size_t i = 0; i < threads; i++)
+        workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers)
+        worker.join();
+}
+
+ThreadPool *ThreadPool::current() {
+    return current_pool;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    std::size_t index = current_pool == this ? current_index : next++ % queues.size();
+
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return pending == 0; });
+}
+
+bool ThreadPool::pop(std::size_t index, std::function<void()> &task) {
+    // Own deque from the back, the others from the front
+    for (std::size_t i = 0; i < queues.size(); i++) {
+        auto &queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty())
+            continue;
+
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::run(std::size_t index) {
+    current_pool  = this;
+    current_index = index;
+
+    for (;;) {
+        std::function<void()> task;
+
+        if (pop(index, task)) {
+            task();
+
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+void parallel_for(std::size_t count, const std::function<void(std::size_t)> &fn) {
+    // Helpers that only start after all indices are taken must not touch fn or
+    // the caller's stack, so the shared counters outlive this call
+    struct State {
+        std::atomic<std::size_t> next{0}, done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<State>();
+    auto work = [state, count, &fn]() {
+        for (std::size_t i; (i = state->next++) < count;) {
+            fn(i);
+
+            if (++state->done == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    auto pool = ThreadPool::current();
+    std::size_t n = std::min<std::size_t>(count, pool ? pool->size() : std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < n; i++) {
+        if (pool)
+            pool->submit(work);
+        else
+            threads.emplace_back(work);
+    }
+
+    work();
+
+    for (auto &thread : threads)
+        thread.join();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == count; });
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool. Every worker owns a deque, runs its newest task first
+// and steals the oldest task of another worker once its own deque is empty. Tasks
+// submitted from inside a worker go to that worker's deque
+class ThreadPool
+{
+public:
+    // 0 threads means one per core
+    explicit ThreadPool(std::size_t threads = 0);
+    // Finishes all submitted tasks before returning
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task has finished. Not for use inside a task
+    void wait();
+
+    std::size_t size() const { return workers.size(); }
+
+    // Pool that runs the calling thread, null outside of a worker
+    static ThreadPool *current();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(std::size_t index);
+    bool pop(std::size_t index, std::function<void()> &task);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex mutex; // Guards sleeping and waiting
+    std::condition_variable wake, idle;
+    std::atomic<std::size_t> queued, pending, next;
+    bool stopping;
+};
+
+// Calls fn(0) .. fn(count - 1) on one thread per core, the calling thread included.
+// Inside a pool worker the helpers are tasks of that pool instead of new threads,
+// so nested work only uses workers that would otherwise be idle
+void parallel_for(std::size_t count, const std::function<void(std::size_t)> &fn);
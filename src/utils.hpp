@@ -7,7 +7,9 @@
 inline std::string data_size(std::size_t size) {
     std::stringstream ss;
 
-    if (size >= 1024*1024)
+    if (size >= 1024*1024*1024)
+        ss << std::fixed << std::setprecision(2) << size / float(1024*1024*1024) << " GiB";
+    else if (size >= 1024*1024)
         ss << std::fixed << std::setprecision(2) << size / float(1024*1024) << " MiB";
     else if (size >= 1024)
         ss << std::fixed << std::setprecision(2) << size / float(1024) << " KiB";
@@ -0,0 +1,182 @@
+#include "support.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+struct TestFile {
+    std::string name;
+    std::vector<std::uint8_t> data;
+};
+
+static std::vector<TestFile> sample_files() {
+    return { { "a.txt", text(5000) }, { "dir/b.bin", noise(3000, 21) }, { "dir/sub/c.txt", text(10) } };
+}
+
+// Writes the files to the scratch directory and adds them to the request
+static bool add_files(EncodeRequest &request, const std::string &prefix, const std::vector<TestFile> &files) {
+    for (const auto &file : files) {
+        auto path = temp_path(prefix + "_" + std::to_string(request.files.size()));
+        if (!write_file(path, file.data))
+            return false;
+        request.files.push_back({ path, file.name });
+    }
+    return true;
+}
+
+static StegoResult archive_embed(const std::string &name, const std::vector<TestFile> &files) {
+    EncodeRequest request;
+    request.password = test_password();
+    request.input    = "bundle";
+    request.output   = temp_path(name + "_out.png");
+
+    StegoResult result;
+    result.error = StegoError::OpenFile;
+
+    auto cover = png_cover(name, 256, 256, 3, 31);
+    if (!cover.empty() && add_files(request, name, files))
+        result = encode_file(cover, request);
+    return result;
+}
+
+static StegoResult extract(const std::string &path, const std::string &directory,
+                           const std::vector<std::string> &entries = {}, bool list = false) {
+    DecodeRequest request;
+    request.password = test_password();
+    request.output   = directory;
+    request.entries  = entries;
+    request.list     = list;
+    return decode_file(path, request);
+}
+
+static std::vector<std::string> names(const StegoResult &result) {
+    std::vector<std::string> names;
+    for (const auto &entry : result.entries)
+        names.push_back(entry.name);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static bool extracted(const std::string &directory, const std::vector<TestFile> &files) {
+    for (const auto &file : files) {
+        if (!CHECK(read_file((fs::path(directory) / file.name).string()) == file.data))
+            return false;
+    }
+    return true;
+}
+
+TEST(archive_roundtrip) {
+    auto files = sample_files();
+    auto result = archive_embed("archive", files);
+    REQUIRE(result);
+
+    auto directory = temp_path("archive_all");
+    auto decoded = extract(result.output, directory);
+    REQUIRE(decoded);
+    CHECK(names(decoded) == std::vector<std::string>({ "a.txt", "dir/b.bin", "dir/sub/c.txt" }));
+    CHECK(extracted(directory, files));
+}
+
+TEST(archive_list) {
+    auto result = archive_embed("list", sample_files());
+    REQUIRE(result);
+
+    auto directory = temp_path("list_none");
+    auto decoded = extract(result.output, directory, {}, true);
+    REQUIRE(decoded);
+    CHECK(names(decoded).size() == 3);
+    CHECK(!fs::exists(directory));
+}
+
+TEST(archive_entries) {
+    auto files = sample_files();
+    auto result = archive_embed("entries", files);
+    REQUIRE(result);
+
+    auto directory = temp_path("entries_one");
+    REQUIRE(extract(result.output, directory, { "dir/b.bin" }));
+    CHECK(extracted(directory, { files[1] }));
+    CHECK(!fs::exists(fs::path(directory) / "a.txt"));
+
+    auto missing = extract(result.output, temp_path("entries_missing"), { "c.txt" });
+    CHECK(missing.error == StegoError::EntryName);
+}
+
+TEST(archive_unsafe_name) {
+    EncodeRequest request;
+    request.password = test_password();
+    request.input    = "bundle";
+    request.output   = temp_path("unsafe_out.png");
+
+    auto cover = png_cover("unsafe", 64, 64, 3, 32);
+    REQUIRE(!cover.empty());
+    REQUIRE(add_files(request, "unsafe", { { "../escape.txt", text(10) } }));
+    CHECK(encode_file(cover, request).error == StegoError::EntryName);
+}
+
+static StegoResult update_archive(const std::string &path, const std::string &output, const std::vector<TestFile> &files) {
+    EncodeRequest request;
+    request.password = test_password();
+    request.output   = output;
+
+    StegoResult result;
+    result.error = StegoError::OpenFile;
+    if (add_files(request, fs::path(path).stem().string() + "_update", files))
+        result = update_file(path, request);
+    return result;
+}
+
+TEST(update_add_and_replace) {
+    auto files = sample_files();
+    auto result = archive_embed("update", files);
+    REQUIRE(result);
+
+    // Replaces a.txt and adds a new entry, the others stay in the first payload
+    std::vector<TestFile> changes = { { "a.txt", noise(700, 41) }, { "new/d.txt", text(2500) } };
+    auto updated = temp_path("update_new.png");
+    REQUIRE(update_archive(result.output, updated, changes));
+
+    auto directory = temp_path("update_all");
+    auto decoded = extract(updated, directory);
+    REQUIRE(decoded);
+    CHECK(names(decoded) == std::vector<std::string>({ "a.txt", "dir/b.bin", "dir/sub/c.txt", "new/d.txt" }));
+    CHECK(extracted(directory, { changes[0], files[1], files[2], changes[1] }));
+
+    // The image that was updated from is left as it was
+    auto original = temp_path("update_old");
+    REQUIRE(extract(result.output, original));
+    CHECK(extracted(original, files));
+}
+
+TEST(update_in_place) {
+    auto files = sample_files();
+    auto result = archive_embed("in_place", files);
+    REQUIRE(result);
+
+    std::vector<TestFile> first = { { "e.bin", noise(400, 42) } }, second = { { "e.bin", text(900) } };
+    REQUIRE(update_archive(result.output, "", first));
+    REQUIRE(update_archive(result.output, "", second));
+
+    auto directory = temp_path("in_place_all");
+    auto decoded = extract(result.output, directory);
+    REQUIRE(decoded);
+    CHECK(decoded.entries.size() == 4);
+    CHECK(extracted(directory, { files[0], files[1], files[2], second[0] }));
+}
+
+TEST(update_not_archive) {
+    auto cover = png_cover("single", 128, 128, 3, 43);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("single.txt");
+    REQUIRE(write_file(input, text(1000)));
+
+    auto output = temp_path("single_out.png");
+    REQUIRE(embed(cover, input, output, Image::EncodingLevel::Low));
+
+    auto updated = temp_path("single_new.png");
+    CHECK(update_archive(output, updated, { { "a.txt", text(10) } }).error == StegoError::NotArchive);
+    CHECK(!fs::exists(updated));
+    CHECK(extracts(output, text(1000)));
+}
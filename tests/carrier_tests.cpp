@@ -0,0 +1,119 @@
+#include "support.hpp"
+
+#include "carrier.hpp"
+
+struct CarrierCase {
+    const char *extension;
+    std::vector<std::uint8_t> file;
+    unsigned int channels, depth;
+    std::size_t padding = 0;    // Row padding at the end of the file, which may be missing
+};
+
+// Odd widths so that BMP rows are padded and TIFF files hold several strips
+static std::vector<CarrierCase> carriers(unsigned int width, unsigned int height) {
+    return {
+        { ".bmp", make_bmp(width, height, 24, 91), 3, 8, (4 - width * 3 % 4) % 4 },
+        { ".bmp", make_bmp(width, height, 32, 92), 4, 8 },
+        { ".ppm", make_pnm(width, height, 3, 8, 93), 3, 8 },
+        { ".pgm", make_pnm(width, height, 1, 16, 94), 1, 16 },
+        { ".tga", make_tga(width, height, 24, 95), 3, 8 },
+        { ".tga", make_tga(width, height, 32, 96), 4, 8 },
+        { ".tga", make_tga(width, height, 8, 97), 1, 8 },
+        { ".tif", make_tiff(width, height, 3, 8, false, 98), 3, 8 },
+        { ".tiff", make_tiff(width, height, 1, 16, true, 99), 1, 16 },
+        { ".tif", make_tiff(width, height, 4, 8, true, 100), 4, 8 },
+    };
+}
+
+TEST(carrier_parse) {
+    for (const auto &carrier : carriers(9, 35)) {
+        CarrierLayout layout;
+        REQUIRE(parse_carrier(carrier.file.data(), carrier.file.size(), layout));
+        CHECK(layout.width == 9);
+        CHECK(layout.height == 35);
+        CHECK(layout.channels == carrier.channels);
+        CHECK(layout.depth == carrier.depth);
+    }
+}
+
+TEST(carrier_truncated) {
+    // Every prefix lacks part of the header or of the pixels. The copy has exactly the
+    // prefix length so that reads past it are caught by sanitizers
+    for (const auto &carrier : carriers(9, 35)) {
+        for (std::size_t size = 0; size < carrier.file.size() - carrier.padding; size++) {
+            std::vector<std::uint8_t> prefix(carrier.file.begin(), carrier.file.begin() + size);
+            CarrierLayout layout;
+            if (!CHECK(!parse_carrier(prefix.data(), prefix.size(), layout)))
+                break;
+        }
+    }
+}
+
+TEST(carrier_truncated_map) {
+    int index = 0;
+    for (const auto &carrier : carriers(9, 35)) {
+        std::size_t end = carrier.file.size() - carrier.padding;
+        for (std::size_t size : { std::size_t(2), std::size_t(17), std::size_t(60), end / 2, end - 1 }) {
+            auto path = temp_path("truncated_" + std::to_string(index++) + carrier.extension);
+            REQUIRE(write_file(path, std::vector<std::uint8_t>(carrier.file.begin(), carrier.file.begin() + size)));
+
+            Image image;
+            CHECK(!image.map(path));
+        }
+    }
+}
+
+TEST(carrier_bad_fields) {
+    auto bmp = make_bmp(9, 35, 24, 101);
+    auto pnm = make_pnm(9, 35, 3, 8, 102);
+    auto tga = make_tga(9, 35, 24, 103);
+
+    auto rejects = [](std::vector<std::uint8_t> file, std::size_t at, std::uint8_t value) {
+        file[at] = value;
+        CarrierLayout layout;
+        return !parse_carrier(file.data(), file.size(), layout);
+    };
+
+    CHECK(rejects(bmp, 28, 8));     // Palette
+    CHECK(rejects(bmp, 30, 1));     // RLE compression
+    CHECK(rejects(bmp, 19, 0x40));  // Wider than the file
+    CHECK(rejects(bmp, 10, 0xff));  // Pixels past the end
+    CHECK(rejects(tga, 2, 10));     // RLE
+    CHECK(rejects(tga, 1, 1));      // Colour map
+    CHECK(rejects(tga, 17, 0x10));  // Right-to-left
+    CHECK(rejects(tga, 13, 0x7f));  // Wider than the file
+
+    // Maximum value 0, and a header running straight into the pixels
+    std::string zero = "P6\n9 35\n0\n";
+    std::vector<std::uint8_t> file(zero.begin(), zero.end());
+    file.resize(file.size() + 9 * 35 * 3);
+    CarrierLayout layout;
+    CHECK(!parse_carrier(file.data(), file.size(), layout));
+
+    std::string joined = "P6\n9 35\n255";
+    CHECK(!parse_carrier(reinterpret_cast<const std::uint8_t *>(joined.data()), joined.size(), layout));
+    CHECK(parse_carrier(pnm.data(), pnm.size(), layout));
+}
+
+TEST(carrier_roundtrip) {
+    auto input = temp_path("carrier.bin");
+    auto payload = noise(300, 104);
+    REQUIRE(write_file(input, payload));
+
+    int index = 0;
+    for (const auto &carrier : carriers(61, 97)) {
+        auto name = "carrier_" + std::to_string(index++);
+        auto cover = temp_path(name + carrier.extension), output = temp_path(name + "_out" + carrier.extension);
+        REQUIRE(write_file(cover, carrier.file));
+
+        // The output is a patched copy of the cover, of the same size and layout
+        REQUIRE(embed(cover, input, output, Image::EncodingLevel::Low));
+        CHECK(extracts(output, payload));
+
+        auto stego = read_file(output);
+        CarrierLayout layout;
+        CHECK(stego.size() == carrier.file.size());
+        CHECK(parse_carrier(stego.data(), stego.size(), layout));
+        CHECK(read_file(cover) == carrier.file);
+    }
+}
@@ -0,0 +1,221 @@
+#include "support.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+TEST(level_roundtrip) {
+    auto cover = png_cover("level", 256, 256, 3, 1);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("level.txt");
+    auto payload = text(20000);
+    REQUIRE(write_file(input, payload));
+
+    for (auto level : { Image::EncodingLevel::Low, Image::EncodingLevel::Med, Image::EncodingLevel::High }) {
+        for (bool compress : { true, false }) {
+            auto output = temp_path(std::string("level_") + level_to_str[int(level)] + (compress ? "_z" : "") + ".png");
+
+            auto result = embed(cover, input, output, level, compress);
+            REQUIRE(result);
+            CHECK(result.level == level);
+            CHECK(result.compressed == compress);
+            CHECK(result.size == payload.size());
+            CHECK(extracts(output, payload));
+        }
+    }
+}
+
+TEST(level_incompressible) {
+    auto cover = png_cover("noise", 128, 128, 3, 2);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("noise.bin");
+    auto payload = noise(3000, 5);
+    REQUIRE(write_file(input, payload));
+
+    auto output = temp_path("noise_out.png");
+    auto result = embed(cover, input, output, Image::EncodingLevel::Low);
+    REQUIRE(result);
+    CHECK(!result.compressed);
+    CHECK(extracts(output, payload));
+}
+
+TEST(level_too_large) {
+    auto cover = png_cover("small", 32, 32, 3, 3);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("large.bin");
+    REQUIRE(write_file(input, noise(4000, 6)));
+
+    auto output = temp_path("small_out.png");
+    CHECK(embed(cover, input, output, Image::EncodingLevel::Low).error == StegoError::TooLarge);
+    CHECK(!fs::exists(output));
+}
+
+TEST(chunk_roundtrip) {
+    std::vector<std::uint8_t> payload;
+    auto output = temp_path("chunked_out.bmp");
+    auto result = chunked_embed(output, payload);
+    REQUIRE(result);
+    CHECK(result.encrypted_size > chunk_stored);
+    CHECK(extracts(output, payload));
+}
+
+TEST(chunk_wrong_password) {
+    std::vector<std::uint8_t> payload;
+    auto output = temp_path("password.bmp");
+    REQUIRE(chunked_embed(output, payload));
+
+    DecodeRequest request;
+    request.password = password_hash("kata sandi lain");
+    request.output   = output + ".out";
+    CHECK(decode_file(output, request).error == StegoError::InvalidKey);
+}
+
+TEST(chunk_corrupt_data) {
+    std::vector<std::uint8_t> payload;
+    auto output = temp_path("data.bmp");
+    auto result = chunked_embed(output, payload);
+    REQUIRE(result);
+
+    auto first = temp_path("data_first.bmp"), second = temp_path("data_second.bmp");
+    REQUIRE(tamper(output, result, 1000, 4, first));
+    REQUIRE(tamper(output, result, chunk_stored + 1000, 1, second));
+    CHECK(decode_error(first) == StegoError::Corrupt);
+    CHECK(decode_error(second) == StegoError::Corrupt);
+}
+
+TEST(chunk_corrupt_tag) {
+    std::vector<std::uint8_t> payload;
+    auto output = temp_path("tag.bmp");
+    auto result = chunked_embed(output, payload);
+    REQUIRE(result);
+
+    auto first = temp_path("tag_first.bmp"), last = temp_path("tag_last.bmp");
+    REQUIRE(tamper(output, result, chunk_stored - tag_size, tag_size, first));
+    REQUIRE(tamper(output, result, result.encrypted_size - 1, 1, last));
+    CHECK(decode_error(first) == StegoError::Corrupt);
+    CHECK(decode_error(last) == StegoError::Corrupt);
+}
+
+TEST(v1_baseline) {
+    // Image written by the first format version, with the password "1234"
+    DecodeRequest request;
+    request.password = password_hash("1234");
+    request.output   = temp_path("original_embedded.zip");
+
+    auto result = decode_file(STEGO_TEST_DATA "/original_embedded.png", request);
+    REQUIRE(result);
+    CHECK(result.version == 1);
+    CHECK(read_file(request.output) == read_file(STEGO_TEST_DATA "/original_embedded_decoded.zip"));
+}
+
+static StegoResult stc_embed(const std::string &cover, const std::string &input, const std::string &output,
+                             Image::EncodingLevel level, Image::StcCost cost, std::size_t band_size = 0) {
+    EncodeRequest request;
+    request.password  = test_password();
+    request.input     = input;
+    request.output    = output;
+    request.level     = level;
+    request.cost      = cost;
+    request.measure   = true;
+    request.band_size = band_size;
+    return encode_file(cover, request);
+}
+
+TEST(stc_roundtrip) {
+    auto cover = png_cover("stc", 192, 192, 3, 71);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("stc.bin");
+    auto payload = noise(900, 72);
+    REQUIRE(write_file(input, payload));
+
+    auto low = stc_embed(cover, input, temp_path("stc_low.png"), Image::EncodingLevel::Low, Image::StcCost::Flat);
+    REQUIRE(low);
+
+    for (auto cost : { Image::StcCost::Flat, Image::StcCost::Texture }) {
+        auto output = temp_path(cost == Image::StcCost::Flat ? "stc_flat.png" : "stc_texture.png");
+        auto result = stc_embed(cover, input, output, Image::EncodingLevel::Stc, cost);
+        REQUIRE(result);
+        CHECK(result.level == Image::EncodingLevel::Stc);
+        CHECK(extracts(output, payload));
+
+        // The trellis changes fewer samples than writing the bits directly
+        if (cost == Image::StcCost::Flat)
+            CHECK(result.distortion.mse < low.distortion.mse);
+    }
+}
+
+TEST(stc_streamed) {
+    auto cover = png_cover("stc_streamed", 128, 128, 3, 73);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("stc_streamed.bin");
+    REQUIRE(write_file(input, noise(100, 74)));
+
+    // Bands of 4 KiB stream the cover, which the trellis can not work on
+    auto output = temp_path("stc_streamed_out.png");
+    auto result = stc_embed(cover, input, output, Image::EncodingLevel::Stc, Image::StcCost::Texture, 4096);
+    CHECK(result.error == StegoError::Streamed);
+    CHECK(!fs::exists(output));
+}
+
+TEST(adaptive_roundtrip) {
+    auto input = temp_path("adaptive.bin");
+    auto payload = noise(1500, 81);
+    REQUIRE(write_file(input, payload));
+
+    // 8-bit colour, 16-bit grey and a mapped cover
+    auto grey = temp_path("adaptive_grey.pgm"), bmp = temp_path("adaptive.bmp");
+    REQUIRE(write_file(grey, make_pnm(128, 128, 1, 16, 82)));
+    REQUIRE(write_file(bmp, make_bmp(96, 96, 24, 83)));
+
+    std::pair<std::string, std::string> cases[] = {
+        { png_cover("adaptive", 96, 96, 3, 84), temp_path("adaptive_out.png") },
+        { grey, temp_path("adaptive_grey_out.png") },
+        { bmp, temp_path("adaptive_out.bmp") },
+    };
+
+    for (const auto &test : cases) {
+        REQUIRE(!test.first.empty());
+        auto result = embed(test.first, input, test.second, Image::EncodingLevel::Adaptive);
+        REQUIRE(result);
+        CHECK(result.level == Image::EncodingLevel::Adaptive);
+        CHECK(extracts(test.second, payload));
+    }
+}
+
+TEST(adaptive_flat_blocks) {
+    // The top half is a single colour, whose blocks get no data
+    const unsigned int width = 128, height = 128;
+    auto pixels = make_pnm(width, height, 3, 8, 85);
+    std::size_t header = pixels.size() - std::size_t(width) * height * 3;
+    std::fill(pixels.begin() + header, pixels.begin() + header + std::size_t(width) * height / 2 * 3, 0x80);
+
+    auto cover = temp_path("flat.ppm"), textured = temp_path("textured.ppm");
+    REQUIRE(write_file(cover, pixels));
+    REQUIRE(write_file(textured, make_pnm(width, height, 3, 8, 85)));
+
+    auto input = temp_path("flat.bin");
+    auto payload = noise(1000, 86);
+    REQUIRE(write_file(input, payload));
+
+    auto output = temp_path("flat_out.ppm");
+    auto result = embed(cover, input, output, Image::EncodingLevel::Adaptive);
+    REQUIRE(result);
+    CHECK(extracts(output, payload));
+
+    auto full = embed(textured, input, temp_path("textured_out.ppm"), Image::EncodingLevel::Adaptive);
+    REQUIRE(full);
+    CHECK(result.capacity < full.capacity);
+
+    // Salt, IV and Header take the low bits of the first 768 samples, the rest of the flat half stays as it was
+    auto stego = read_file(output);
+    REQUIRE(stego.size() == pixels.size());
+    std::size_t begin = header + 768, end = header + std::size_t(width) * height / 2 * 3;
+    CHECK(std::equal(pixels.begin() + begin, pixels.begin() + end, stego.begin() + begin));
+    CHECK(!std::equal(pixels.begin() + end, pixels.end(), stego.begin() + end));
+}
@@ -0,0 +1,79 @@
+#include "support.hpp"
+
+struct FormatCase {
+    std::string name;
+    std::vector<std::uint8_t> file;
+    const char *extension;
+    unsigned int channels, depth;
+};
+
+// PNG covers of every channel count and depth, converted from uncompressed sources
+static std::vector<FormatCase> formats() {
+    return {
+        { "grey", make_pnm(80, 80, 1, 8, 111), ".pgm", 1, 8 },
+        { "grey_alpha", make_tiff(80, 80, 2, 8, false, 112), ".tif", 2, 8 },
+        { "rgba", make_tga(80, 80, 32, 113), ".tga", 4, 8 },
+        { "grey16", make_pnm(80, 80, 1, 16, 114), ".pgm", 1, 16 },
+        { "rgb16", make_pnm(80, 80, 3, 16, 115), ".ppm", 3, 16 },
+    };
+}
+
+TEST(format_native) {
+    auto input = temp_path("format.txt");
+    auto payload = text(2000);
+    REQUIRE(write_file(input, payload));
+
+    for (const auto &format : formats()) {
+        auto source = temp_path("format_" + format.name + format.extension);
+        auto cover  = temp_path("format_" + format.name + ".png");
+        REQUIRE(write_file(source, format.file));
+        REQUIRE(convert(source, cover));
+
+        for (auto level : { Image::EncodingLevel::Low, Image::EncodingLevel::Med, Image::EncodingLevel::High }) {
+            auto output = temp_path("format_" + format.name + "_" + level_to_str[int(level)] + ".png");
+            REQUIRE(embed(cover, input, output, level));
+            CHECK(extracts(output, payload));
+
+            // The stego image keeps the layout of the cover
+            Image image;
+            REQUIRE(image.load(output));
+            CHECK(image.c() == format.channels);
+            CHECK(image.depth() == format.depth);
+        }
+    }
+}
+
+TEST(qoi_roundtrip) {
+    auto input = temp_path("qoi.txt");
+    auto payload = text(3000);
+    REQUIRE(write_file(input, payload));
+
+    for (auto source : { make_pnm(90, 70, 3, 8, 116), make_tga(90, 70, 32, 117) }) {
+        auto raw   = temp_path(source[0] == 'P' ? "qoi_rgb.ppm" : "qoi_rgba.tga");
+        auto cover = raw.substr(0, raw.size() - 4) + ".qoi";
+        REQUIRE(write_file(raw, source));
+        REQUIRE(convert(raw, cover));
+
+        // QOI in and out, and QOI converted to PNG
+        for (const char *extension : { ".qoi", ".png" }) {
+            auto output = cover.substr(0, cover.size() - 4) + "_out" + extension;
+            REQUIRE(embed(cover, input, output, Image::EncodingLevel::Med));
+            CHECK(extracts(output, payload));
+        }
+    }
+}
+
+TEST(qoi_truncated) {
+    auto raw = temp_path("qoi_cut.ppm"), cover = temp_path("qoi_cut.qoi");
+    REQUIRE(write_file(raw, make_pnm(40, 40, 3, 8, 118)));
+    REQUIRE(convert(raw, cover));
+
+    auto file = read_file(cover);
+    for (std::size_t size : { std::size_t(4), std::size_t(14), file.size() / 2 }) {
+        auto path = temp_path("qoi_cut_" + std::to_string(size) + ".qoi");
+        REQUIRE(write_file(path, std::vector<std::uint8_t>(file.begin(), file.begin() + size)));
+
+        Image image;
+        CHECK(!image.load(path));
+    }
+}
@@ -0,0 +1,103 @@
+#include "support.hpp"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Plaintext bytes in a chunk
+static const std::size_t chunk_size = chunk_stored - tag_size;
+
+static StegoResult extract_range(const std::string &path, std::uint64_t offset, std::uint64_t length,
+                                 std::vector<std::uint8_t> &data) {
+    DecodeRequest request;
+    request.password = test_password();
+    request.output   = path + ".range";
+
+    std::error_code ec;
+    fs::remove(request.output, ec);
+
+    auto result = decode_range_file(path, request, offset, length);
+    data = read_file(request.output);
+    return result;
+}
+
+static std::vector<std::uint8_t> slice(const std::vector<std::uint8_t> &data, std::size_t offset, std::size_t length) {
+    return std::vector<std::uint8_t>(data.begin() + offset, data.begin() + std::min(data.size(), offset + length));
+}
+
+TEST(range_edges) {
+    std::vector<std::uint8_t> payload, data;
+    auto output = temp_path("range.bmp");
+    REQUIRE(chunked_embed(output, payload));
+
+    // Start, a single byte on either side of the chunk boundary, across it and the end
+    std::pair<std::size_t, std::size_t> ranges[] = {
+        { 0, 100 }, { chunk_size - 1, 1 }, { chunk_size, 1 }, { chunk_size - 50, 100 },
+        { payload.size() - 1, 1 }, { 0, payload.size() },
+    };
+
+    for (auto range : ranges) {
+        REQUIRE(extract_range(output, range.first, range.second, data));
+        CHECK(data == slice(payload, range.first, range.second));
+    }
+}
+
+TEST(range_past_end) {
+    std::vector<std::uint8_t> payload, data;
+    auto output = temp_path("range_end.bmp");
+    REQUIRE(chunked_embed(output, payload));
+
+    // Lengths running past the end are cut, starts at or after it are rejected
+    REQUIRE(extract_range(output, payload.size() - 10, 1000, data));
+    CHECK(data == slice(payload, payload.size() - 10, 10));
+    REQUIRE(extract_range(output, 5, UINT64_MAX, data));
+    CHECK(data == slice(payload, 5, payload.size()));
+
+    CHECK(extract_range(output, payload.size(), 1, data).error == StegoError::Range);
+    CHECK(extract_range(output, payload.size() + 1000, 1, data).error == StegoError::Range);
+    CHECK(data.empty());
+}
+
+TEST(range_compressed) {
+    auto cover = png_cover("range_z", 256, 256, 3, 11);
+    REQUIRE(!cover.empty());
+
+    auto input = temp_path("range_z.txt");
+    auto payload = text(30000);
+    REQUIRE(write_file(input, payload));
+
+    auto output = temp_path("range_z_out.png");
+    auto result = embed(cover, input, output, Image::EncodingLevel::Low);
+    REQUIRE(result);
+    REQUIRE(result.compressed);
+
+    std::vector<std::uint8_t> data;
+    REQUIRE(extract_range(output, 12345, 6789, data));
+    CHECK(data == slice(payload, 12345, 6789));
+    CHECK(extract_range(output, payload.size(), 1, data).error == StegoError::Range);
+}
+
+TEST(range_checks_only_its_chunks) {
+    std::vector<std::uint8_t> payload, data;
+    auto output = temp_path("range_tamper.bmp");
+    auto result = chunked_embed(output, payload);
+    REQUIRE(result);
+
+    auto tampered = temp_path("range_tampered.bmp");
+    REQUIRE(tamper(output, result, 1000, 1, tampered));
+
+    // The final chunk is always opened for the size, the first one only when it is in the range
+    REQUIRE(extract_range(tampered, chunk_size + 10, 100, data));
+    CHECK(data == slice(payload, chunk_size + 10, 100));
+    CHECK(extract_range(tampered, 0, 100, data).error == StegoError::Corrupt);
+    CHECK(data.empty());
+}
+
+TEST(range_v1) {
+    DecodeRequest request;
+    request.password = password_hash("1234");
+    request.output   = temp_path("original.range");
+
+    auto result = decode_range_file(STEGO_TEST_DATA "/original_embedded.png", request, 0, 10);
+    CHECK(result.error == StegoError::Version);
+}
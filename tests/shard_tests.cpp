@@ -0,0 +1,130 @@
+#include "support.hpp"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Splits payload over count PNG covers, of which parity get parity shards
+static StegoResult shard_embed(const std::string &name, const std::vector<std::uint8_t> &payload, std::size_t count,
+                               std::size_t parity, std::vector<std::string> &outputs) {
+    EncodeRequest request;
+    request.password = test_password();
+    request.input    = temp_path(name + ".bin");
+    request.parity   = parity;
+
+    StegoResult result;
+    result.error = StegoError::OpenFile;
+    if (!write_file(request.input, payload))
+        return result;
+
+    std::vector<std::string> covers;
+    outputs.clear();
+    for (std::size_t i = 0; i < count; i++) {
+        covers.push_back(png_cover(name + "_" + std::to_string(i), 96, 96, 3, 51 + i));
+        outputs.push_back(temp_path(name + "_" + std::to_string(i) + "_out.png"));
+        if (covers.back().empty())
+            return result;
+    }
+
+    return encode_shards(covers, outputs, request);
+}
+
+static StegoResult shard_decode(const std::vector<std::string> &paths, std::vector<std::uint8_t> &data) {
+    DecodeRequest request;
+    request.password = test_password();
+    request.output   = temp_path("shards.out");
+
+    std::error_code ec;
+    fs::remove(request.output, ec);
+
+    auto result = decode_shards(paths, request);
+    data = read_file(request.output);
+    return result;
+}
+
+TEST(shard_roundtrip) {
+    auto payload = noise(8000, 61);
+    std::vector<std::string> outputs;
+    REQUIRE(shard_embed("shard", payload, 3, 0, outputs));
+
+    // Any order
+    std::vector<std::uint8_t> data;
+    REQUIRE(shard_decode({ outputs[2], outputs[0], outputs[1] }, data));
+    CHECK(data == payload);
+}
+
+TEST(shard_missing) {
+    std::vector<std::string> outputs;
+    REQUIRE(shard_embed("missing", noise(8000, 62), 3, 0, outputs));
+
+    std::vector<std::uint8_t> data;
+    CHECK(shard_decode({ outputs[0], outputs[2] }, data).error == StegoError::Shards);
+    CHECK(data.empty());
+}
+
+TEST(shard_duplicate) {
+    std::vector<std::string> outputs;
+    REQUIRE(shard_embed("duplicate", noise(8000, 63), 3, 0, outputs));
+
+    std::vector<std::uint8_t> data;
+    CHECK(shard_decode({ outputs[0], outputs[1], outputs[0] }, data).error == StegoError::Shards);
+    CHECK(shard_decode({ outputs[0], outputs[1], outputs[2], outputs[1] }, data).error == StegoError::Shards);
+    CHECK(data.empty());
+}
+
+TEST(shard_other_set) {
+    std::vector<std::string> first, second;
+    REQUIRE(shard_embed("set_a", noise(8000, 64), 3, 0, first));
+    REQUIRE(shard_embed("set_b", noise(8000, 64), 3, 0, second));
+
+    std::vector<std::uint8_t> data;
+    CHECK(shard_decode({ first[0], second[1], first[2] }, data).error == StegoError::Shards);
+}
+
+TEST(shard_single_image) {
+    std::vector<std::string> outputs;
+    REQUIRE(shard_embed("single_shard", noise(8000, 65), 3, 0, outputs));
+    CHECK(decode_error(outputs[0]) == StegoError::Shards);
+}
+
+TEST(parity_rebuild) {
+    // Three data and two parity shards: every subset of at least three images rebuilds the
+    // payload, and every smaller one is rejected
+    auto payload = noise(7000, 66);
+    std::vector<std::string> outputs;
+    auto result = shard_embed("parity", payload, 5, 2, outputs);
+    REQUIRE(result);
+
+    for (unsigned int mask = 1; mask < 32; mask++) {
+        std::vector<std::string> paths;
+        for (std::size_t i = 0; i < 5; i++) {
+            if (mask & (1u << i))
+                paths.push_back(outputs[i]);
+        }
+
+        std::vector<std::uint8_t> data;
+        auto decoded = shard_decode(paths, data);
+        if (paths.size() >= 3) {
+            CHECK(decoded);
+            CHECK(data == payload);
+        } else {
+            CHECK(decoded.error == StegoError::Shards);
+        }
+    }
+}
+
+TEST(parity_duplicate) {
+    // A repeated image does not count twice towards the data shards
+    std::vector<std::string> outputs;
+    REQUIRE(shard_embed("parity_dup", noise(7000, 67), 5, 2, outputs));
+
+    std::vector<std::uint8_t> data;
+    CHECK(shard_decode({ outputs[0], outputs[3], outputs[3] }, data).error == StegoError::Shards);
+}
+
+TEST(parity_too_many) {
+    // At least one data shard is needed
+    std::vector<std::string> outputs;
+    CHECK(shard_embed("parity_all", noise(100, 68), 2, 2, outputs).error == StegoError::Shards);
+    CHECK(!fs::exists(outputs[0]));
+}
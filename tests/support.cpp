@@ -0,0 +1,298 @@
+#include "support.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+static std::vector<TestCase> &test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+static int failures = 0;
+static fs::path scratch;
+
+TestRegistrar::TestRegistrar(const char *name, void (*run)()) {
+    test_cases().push_back({ name, run });
+}
+
+bool check(bool passed, const char *expression, const char *file, int line) {
+    if (!passed) {
+        std::cerr << file << ':' << line << ": CHECK(" << expression << ") failed" << std::endl;
+        failures++;
+    }
+    return passed;
+}
+
+std::string temp_path(const std::string &name) {
+    return (scratch / name).string();
+}
+
+std::vector<std::uint8_t> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool write_file(const std::string &path, const std::vector<std::uint8_t> &data) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    return bool(file);
+}
+
+std::vector<std::uint8_t> noise(std::size_t size, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<std::uint8_t> data(size);
+    for (auto &byte : data)
+        byte = random() >> 24;
+    return data;
+}
+
+std::vector<std::uint8_t> text(std::size_t size) {
+    static const char line[] = "Pesan rahasia yang disematkan di dalam gambar. ";
+
+    std::vector<std::uint8_t> data(size);
+    for (std::size_t i = 0; i < size; i++)
+        data[i] = line[i % (sizeof(line) - 1)] + (i / 997 % 3);
+    return data;
+}
+
+static void put16(std::uint8_t *p, std::uint32_t value, bool be = false) {
+    p[be ? 1 : 0] = value & 0xff;
+    p[be ? 0 : 1] = value >> 8;
+}
+
+static void put32(std::uint8_t *p, std::uint32_t value, bool be = false) {
+    for (int i = 0; i < 4; i++)
+        p[be ? 3 - i : i] = value >> (8 * i);
+}
+
+std::vector<std::uint8_t> make_pnm(unsigned int width, unsigned int height, unsigned int channels, unsigned int depth,
+                                   std::uint32_t seed) {
+    std::ostringstream header;
+    header << (channels == 3 ? "P6" : "P5") << "\n# test\n" << width << ' ' << height << '\n'
+           << (depth == 16 ? 65535 : 255) << '\n';
+
+    auto head = header.str();
+    auto pixels = noise(std::size_t(width) * height * channels * (depth / 8), seed);
+
+    std::vector<std::uint8_t> file(head.begin(), head.end());
+    file.insert(file.end(), pixels.begin(), pixels.end());
+    return file;
+}
+
+std::vector<std::uint8_t> make_bmp(unsigned int width, unsigned int height, unsigned int bpp, std::uint32_t seed) {
+    std::size_t row = (std::size_t(width) * bpp + 31) / 32 * 4;
+    std::vector<std::uint8_t> file(54 + row * height);
+
+    file[0] = 'B';
+    file[1] = 'M';
+    put32(&file[2], file.size());
+    put32(&file[10], 54);
+    put32(&file[14], 40);
+    put32(&file[18], width);
+    put32(&file[22], height);
+    put16(&file[26], 1);
+    put16(&file[28], bpp);
+    put32(&file[34], row * height);
+
+    auto pixels = noise(row * height, seed);
+    std::copy(pixels.begin(), pixels.end(), file.begin() + 54);
+    return file;
+}
+
+std::vector<std::uint8_t> make_tga(unsigned int width, unsigned int height, unsigned int bpp, std::uint32_t seed) {
+    std::vector<std::uint8_t> file(18);
+
+    file[2] = bpp == 8 ? 3 : 2;
+    put16(&file[12], width);
+    put16(&file[14], height);
+    file[16] = bpp;
+    file[17] = bpp == 32 ? 8 : 0;
+
+    auto pixels = noise(std::size_t(width) * height * (bpp / 8), seed);
+    file.insert(file.end(), pixels.begin(), pixels.end());
+    return file;
+}
+
+std::vector<std::uint8_t> make_tiff(unsigned int width, unsigned int height, unsigned int samples, unsigned int depth,
+                                    bool big_endian, std::uint32_t seed) {
+    std::size_t row = std::size_t(width) * samples * (depth / 8);
+    std::size_t pixels = row * height;
+
+    // Several strips of up to 16 rows, whose offset and size arrays follow the IFD
+    std::uint32_t rows_per_strip = 16;
+    std::uint32_t strips = (height + rows_per_strip - 1) / rows_per_strip;
+
+    const std::size_t entries = 10;
+    std::size_t ifd     = 8 + (pixels + 1) / 2 * 2;
+    std::size_t bits    = ifd + 2 + entries * 12 + 4;
+    std::size_t offsets = bits + samples * 2;
+    std::size_t counts  = offsets + strips * 4;
+
+    std::vector<std::uint8_t> file(counts + strips * 4);
+    file[0] = file[1] = big_endian ? 'M' : 'I';
+    put16(&file[2], 42, big_endian);
+    put32(&file[4], ifd, big_endian);
+
+    auto data = noise(pixels, seed);
+    std::copy(data.begin(), data.end(), file.begin() + 8);
+
+    put16(&file[ifd], entries, big_endian);
+    auto entry = &file[ifd + 2];
+
+    // Values of up to 4 bytes are stored inline, longer arrays at the given offset
+    auto add = [&](std::uint32_t tag, std::uint32_t type, std::uint32_t count, std::uint32_t value) {
+        put16(entry, tag, big_endian);
+        put16(entry + 2, type, big_endian);
+        put32(entry + 4, count, big_endian);
+        if (type == 3 && count <= 2) {
+            put16(entry + 8, value, big_endian);
+            put16(entry + 10, count == 2 ? value : 0, big_endian);
+        } else
+            put32(entry + 8, value, big_endian);
+        entry += 12;
+    };
+
+    add(256, 4, 1, width);
+    add(257, 4, 1, height);
+    add(258, 3, samples, samples > 2 ? bits : depth);
+    add(259, 3, 1, 1);
+    add(262, 3, 1, samples >= 3 ? 2 : 1);
+    add(273, 4, strips, strips > 1 ? offsets : 8);
+    add(277, 3, 1, samples);
+    add(278, 4, 1, rows_per_strip);
+    add(279, 4, strips, strips > 1 ? counts : pixels);
+    add(284, 3, 1, 1);
+
+    for (std::size_t i = 0; i < samples && samples > 2; i++)
+        put16(&file[bits + i * 2], depth, big_endian);
+
+    for (std::uint32_t i = 0; i < strips && strips > 1; i++) {
+        std::size_t begin = std::size_t(i) * rows_per_strip * row;
+        put32(&file[offsets + i * 4], 8 + begin, big_endian);
+        put32(&file[counts + i * 4], std::min(pixels - begin, rows_per_strip * row), big_endian);
+    }
+
+    return file;
+}
+
+bool convert(const std::string &source, const std::string &path) {
+    Image image;
+    return image.load(source) && image.save(path);
+}
+
+std::string png_cover(const std::string &name, unsigned int width, unsigned int height, unsigned int channels,
+                      std::uint32_t seed) {
+    auto source = temp_path(name + ".ppm");
+    auto path   = temp_path(name + ".png");
+    if (!write_file(source, make_pnm(width, height, channels, 8, seed)) || !convert(source, path))
+        return std::string();
+    return path;
+}
+
+std::array<std::uint8_t, 32> test_password() {
+    return password_hash("kata sandi uji");
+}
+
+StegoResult embed(const std::string &cover, const std::string &input, const std::string &output,
+                  Image::EncodingLevel level, bool compress) {
+    EncodeRequest request;
+    request.password = test_password();
+    request.input    = input;
+    request.output   = output;
+    request.level    = level;
+    request.compress = compress;
+
+    return encode_file(cover, request);
+}
+
+StegoResult chunked_embed(const std::string &output, std::vector<std::uint8_t> &payload) {
+    auto cover = temp_path("chunked.bmp");
+    auto input = temp_path("chunked.bin");
+    payload = noise(chunk_stored + chunk_stored / 4, 7);
+
+    StegoResult result;
+    result.error = StegoError::OpenFile;
+    if (write_file(cover, make_bmp(1100, 1000, 24, 3)) && write_file(input, payload))
+        result = embed(cover, input, output, Image::EncodingLevel::High, false);
+    return result;
+}
+
+bool extracts(const std::string &path, const std::vector<std::uint8_t> &expected) {
+    DecodeRequest request;
+    request.password = test_password();
+    request.output   = path + ".out";
+
+    auto result = decode_file(path, request);
+    if (!CHECK(result) || !CHECK(read_file(request.output) == expected))
+        return false;
+
+    std::error_code ec;
+    fs::remove(request.output, ec);
+    return true;
+}
+
+StegoError decode_error(const std::string &path) {
+    DecodeRequest request;
+    request.password = test_password();
+    request.output   = path + ".out";
+    return decode_file(path, request).error;
+}
+
+bool tamper(const std::string &path, const StegoResult &embedded, std::size_t at, std::size_t size,
+            const std::string &output) {
+    Image image;
+    if (!image.load(path))
+        return false;
+
+    std::size_t offset = embedded.offset + image.encoded_size(at, embedded.level);
+    auto data = image.decode(size, embedded.level, offset);
+    if (!data)
+        return false;
+
+    for (std::size_t i = 0; i < size; i++)
+        data[i] ^= 0x5a;
+
+    return image.encode(data.get(), size, embedded.level, offset) && image.save(output);
+}
+
+int main(int argc, char **argv) {
+    std::string prefix = argc > 1 ? argv[1] : "";
+
+    std::random_device device;
+    std::ostringstream name;
+    name << "stego_tests_" << std::hex << device();
+    scratch = fs::temp_directory_path() / name.str();
+    fs::create_directories(scratch);
+
+    int ran = 0;
+    for (const auto &test : test_cases()) {
+        if (std::string(test.name).compare(0, prefix.size(), prefix) != 0)
+            continue;
+
+        int before = failures;
+        std::cout << "[ RUN  ] " << test.name << std::endl;
+        test.run();
+        std::cout << (failures == before ? "[  OK  ] " : "[ FAIL ] ") << test.name << std::endl;
+        ran++;
+    }
+
+    std::error_code ec;
+    fs::remove_all(scratch, ec);
+
+    if (!ran) {
+        std::cerr << "No test matches \"" << prefix << '"' << std::endl;
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "stego.hpp"
+
+// Minimal test harness. TEST(name) registers a test, the runner executes every test whose
+// name starts with the prefix given on the command line. CHECK records a failure and
+// carries on, REQUIRE also leaves the test
+struct TestRegistrar {
+    TestRegistrar(const char *name, void (*run)());
+};
+
+bool check(bool passed, const char *expression, const char *file, int line);
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(expression) check(bool(expression), #expression, __FILE__, __LINE__)
+#define REQUIRE(expression) do { if (!CHECK(expression)) return; } while (0)
+
+// Path inside the scratch directory of this run, which is removed when the tests end
+std::string temp_path(const std::string &name);
+
+std::vector<std::uint8_t> read_file(const std::string &path);
+bool write_file(const std::string &path, const std::vector<std::uint8_t> &data);
+
+// Incompressible bytes, and text that deflate shrinks well
+std::vector<std::uint8_t> noise(std::size_t size, std::uint32_t seed);
+std::vector<std::uint8_t> text(std::size_t size);
+
+// Uncompressed carriers filled with noise, built by hand since Image only writes PNG and QOI
+std::vector<std::uint8_t> make_pnm(unsigned int width, unsigned int height, unsigned int channels, unsigned int depth,
+                                   std::uint32_t seed);
+std::vector<std::uint8_t> make_bmp(unsigned int width, unsigned int height, unsigned int bpp, std::uint32_t seed);
+std::vector<std::uint8_t> make_tga(unsigned int width, unsigned int height, unsigned int bpp, std::uint32_t seed);
+std::vector<std::uint8_t> make_tiff(unsigned int width, unsigned int height, unsigned int samples, unsigned int depth,
+                                    bool big_endian, std::uint32_t seed);
+
+// Loads source and saves it as PNG or QOI, depending on the extension of path
+bool convert(const std::string &source, const std::string &path);
+// 8-bit PNG cover of noise in the scratch directory, empty if it could not be written
+std::string png_cover(const std::string &name, unsigned int width, unsigned int height, unsigned int channels,
+                      std::uint32_t seed);
+
+// Chunk with its HMAC tag in the encrypted stream, CHUNK_STORED in stego.cpp
+const std::size_t chunk_stored = 240 * 4369;
+const std::size_t tag_size     = 16;
+
+std::array<std::uint8_t, 32> test_password();
+
+// Embeds the file at input into cover, writing output
+StegoResult embed(const std::string &cover, const std::string &input, const std::string &output,
+                  Image::EncodingLevel level, bool compress = true);
+// Two chunks of noise at level High in a mapped BMP, without compression so that the
+// stream offsets are fixed
+StegoResult chunked_embed(const std::string &output, std::vector<std::uint8_t> &payload);
+// Extracts the embed of path to output and compares it with expected
+bool extracts(const std::string &path, const std::vector<std::uint8_t> &expected);
+// Error of decoding path with the test password
+StegoError decode_error(const std::string &path);
+
+// XORs size bytes of the encrypted stream of an embed, starting at byte at, and saves the
+// result to output. Only for levels storing whole bytes in whole samples
+bool tamper(const std::string &path, const StegoResult &embedded, std::size_t at, std::size_t size,
+            const std::string &output);